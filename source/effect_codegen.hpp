@@ -17,6 +17,7 @@ namespace reshadefx
 	class codegen
 	{
 		friend class parser;
+		friend class codegen_optimizer;
 
 	public:
 		/// <summary>
@@ -28,6 +29,7 @@ namespace reshadefx
 		/// Gets the module describing the generated code.
 		/// </summary>
 		effect_module &module() { return _module; }
+		const effect_module &module() const { return _module; }
 
 		/// <summary>
 		/// Finalizes and returns the generated code for the entire module (all entry points).
@@ -35,6 +37,7 @@ namespace reshadefx
 		virtual std::string finalize_code() const = 0;
 		/// <summary>
 		/// Finalizes and assembles the generated code for the specified entry point (and no other entry points).
+		/// This only reads from the code generator, so it may be called for different entry points on multiple threads at the same time.
 		/// </summary>
 		/// <param name="entry_point_name">Name of the entry point function to generate code for.</param>
 		/// <param name="binary">Output binary code.</param>
@@ -198,7 +201,7 @@ namespace reshadefx
 		/// <param name="res_type">Data type of the call result.</param>
 		/// <param name="args">List of SSA IDs representing the call arguments.</param>
 		/// <returns>New SSA ID with the result of the function call.</returns>
-		virtual id emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) = 0;
+		virtual id emit_call(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) = 0;
 		/// <summary>
 		/// Adds an intrinsic function call to the output.
 		/// </summary>
@@ -207,14 +210,14 @@ namespace reshadefx
 		/// <param name="res_type">Data type of the call result.</param>
 		/// <param name="args">List of SSA IDs representing the call arguments.</param>
 		/// <returns>New SSA ID with the result of the function call.</returns>
-		virtual id emit_call_intrinsic(const location &loc, id function, const type &res_type, const std::vector<expression> &args) = 0;
+		virtual id emit_call_intrinsic(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) = 0;
 		/// <summary>
 		/// Adds a type constructor call to the output.
 		/// </summary>
 		/// <param name="type">Data type to construct.</param>
 		/// <param name="args">List of SSA IDs representing the scalar constructor arguments.</param>
 		/// <returns>New SSA ID with the constructed value.</returns>
-		virtual id emit_construct(const location &loc, const type &type, const std::vector<expression> &args) = 0;
+		virtual id emit_construct(const location &loc, const type &type, const std::pmr::vector<expression> &args) = 0;
 
 		/// <summary>
 		/// Adds a structured branch control flow to the output.
@@ -313,6 +316,10 @@ namespace reshadefx
 		/// Calculates sampler and storage bindings to take as little binding space as possible for each entry point.
 		/// </summary>
 		virtual void optimize_bindings();
+		/// <summary>
+		/// Rearranges uniform variables in the global uniform buffer to waste as little space on padding as possible, if the back-end was created with uniform packing enabled.
+		/// </summary>
+		virtual void optimize_uniform_layout() {}
 
 		/// <summary>
 		/// Looks up an existing struct type.
@@ -382,6 +389,20 @@ namespace reshadefx
 
 		id make_id() { return _next_id++; }
 
+		/// <summary>
+		/// Finds the offset at which to place a new uniform variable in the global uniform buffer and grows the buffer accordingly.
+		/// </summary>
+		/// <param name="size">Size of the uniform variable in bytes.</param>
+		/// <param name="alignment">Alignment of the uniform variable in bytes.</param>
+		/// <param name="pack">Place the uniform variable into padding left behind by earlier ones if it fits there, instead of always appending it to the end.</param>
+		/// <returns>Offset of the uniform variable in bytes.</returns>
+		uint32_t allocate_uniform(uint32_t size, uint32_t alignment, bool pack);
+		/// <summary>
+		/// Lays out all uniform variables in the global uniform buffer again, starting with those with the largest alignment, so that smaller ones can fill the padding left between them.
+		/// </summary>
+		/// <param name="uniform_alignment">Function that returns the alignment of a uniform variable in bytes.</param>
+		void pack_uniforms(uint32_t(*uniform_alignment)(const uniform &info));
+
 		effect_module _module;
 		std::vector<struct_type> _structs;
 		std::vector<std::unique_ptr<function>> _functions;
@@ -390,6 +411,9 @@ namespace reshadefx
 		id _last_block = 0;
 		id _current_block = 0;
 		function *_current_function = nullptr;
+
+		// Padding between uniform variables in the global uniform buffer that is not occupied yet, as pairs of offset and size
+		std::vector<std::pair<uint32_t, uint32_t>> _uniform_padding;
 	};
 
 	/// <summary>
@@ -400,16 +424,18 @@ namespace reshadefx
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	/// <param name="enable_16bit_types">Use real 16-bit types for the minimum precision types "min16int", "min16uint" and "min16float".</param>
 	/// <param name="flip_vert_y">Insert code to flip the Y component of the output position in vertex shaders.</param>
-	codegen *create_codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false);
+	/// <param name="pack_uniforms">Reorder uniform variables so that as little space as possible is wasted on padding, instead of laying them out in declaration order.</param>
+	codegen *create_codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false, bool pack_uniforms = false);
 	/// <summary>
 	/// Creates a back-end implementation for HLSL code generation.
 	/// </summary>
 	/// <param name="shader_model">The HLSL shader model version (e.g. 30, 41, 50, 60, ...)</param>
 	/// <param name="debug_info">Whether to append debug information like line directives to the generated code.</param>
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
-	codegen *create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants);
-	codegen *create_codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level);
-	codegen *create_codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level);
+	/// <param name="pack_uniforms">Reorder uniform variables so that as little space as possible is wasted on padding, instead of laying them out in declaration order (only applies to shader model 4 and up).</param>
+	codegen *create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool pack_uniforms = false);
+	codegen *create_codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms = false);
+	codegen *create_codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms = false);
 	/// <summary>
 	/// Creates a back-end implementation for SPIR-V code generation.
 	/// </summary>
@@ -418,5 +444,20 @@ namespace reshadefx
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	/// <param name="enable_16bit_types">Use real 16-bit types for the minimum precision types "min16int", "min16uint" and "min16float".</param>
 	/// <param name="flip_vert_y">Insert code to flip the Y component of the output position in vertex shaders.</param>
-	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false);
+	/// <param name="optimization_level">Optimization passes to run on the assembled code: Zero or less to disable optimization, one to remove unused functions, types, constants and variables, two or more to also forward local loads and stores and merge trivial blocks.</param>
+	/// <param name="pack_uniforms">Reorder uniform variables so that as little space as possible is wasted on padding, instead of laying them out in declaration order.</param>
+	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types = false, bool flip_vert_y = false, int optimization_level = 0, bool pack_uniforms = false);
+	/// <summary>
+	/// Checks that a SPIR-V module generated by the SPIR-V back-end is well-formed: It only consists of instructions the back-end emits, ids are defined exactly once and before the id bound, all referenced ids are defined and every block is terminated.
+	/// </summary>
+	/// <param name="code">The SPIR-V module, as returned by <see cref="codegen::assemble_code_for_entry_point"/>.</param>
+	/// <param name="errors">Receives a description of the first problem found.</param>
+	/// <returns><see langword="true"/> if the module is well-formed, <see langword="false"/> otherwise.</returns>
+	bool validate_spirv_module(const std::string &code, std::string &errors);
+	/// <summary>
+	/// Creates a code generation layer which removes common subexpressions, copies and unused values from each function before passing it on to the specified back-end.
+	/// The layer takes over the state of the back-end while it exists, so destroy it again before using the back-end directly.
+	/// </summary>
+	/// <param name="backend">The back-end implementation to generate the optimized code with.</param>
+	codegen *create_codegen_optimizer(codegen *backend);
 }
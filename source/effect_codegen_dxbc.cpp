@@ -14,8 +14,8 @@ using namespace reshadefx;
 class codegen_dxbc final : public codegen_hlsl
 {
 public:
-	codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level) :
-		codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants),
+	codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms) :
+		codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants, pack_uniforms),
 		_optimization_level(optimization_level)
 	{
 	}
@@ -124,8 +124,8 @@ private:
 };
 
 #ifndef RESHADEFX_CODEGEN_DXBC_INLINE
-codegen *reshadefx::create_codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level)
+codegen *reshadefx::create_codegen_dxbc(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms)
 {
-	return new codegen_dxbc(shader_model, debug_info, uniforms_to_spec_constants, optimization_level);
+	return new codegen_dxbc(shader_model, debug_info, uniforms_to_spec_constants, optimization_level, pack_uniforms);
 }
 #endif
@@ -18,8 +18,8 @@ using namespace reshadefx;
 class codegen_dxil final : public codegen_hlsl
 {
 public:
-	codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level) :
-		codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants),
+	codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms) :
+		codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants, pack_uniforms),
 		_optimization_level(optimization_level)
 	{
 	}
@@ -116,11 +116,11 @@ private:
 };
 
 #ifndef RESHADEFX_CODEGEN_DXIL_INLINE
-codegen *reshadefx::create_codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level)
+codegen *reshadefx::create_codegen_dxil(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, int optimization_level, bool pack_uniforms)
 {
 	if (shader_model < 60)
 		return nullptr;
 
-	return new codegen_dxil(shader_model, debug_info, uniforms_to_spec_constants, optimization_level);
+	return new codegen_dxil(shader_model, debug_info, uniforms_to_spec_constants, optimization_level, pack_uniforms);
 }
 #endif
@@ -9,7 +9,8 @@
 #include <cassert>
 #include <cstring> // std::memcmp
 #include <charconv> // std::from_chars, std::to_chars
-#include <algorithm> // std::find, std::find_if, std::max
+#include <numeric> // std::iota
+#include <algorithm> // std::find, std::find_if, std::max, std::stable_sort
 #include <unordered_set>
 
 using namespace reshadefx;
@@ -26,18 +27,121 @@ inline uint32_t align_up(uint32_t size, uint32_t alignment)
 	return ((size + alignment) & ~alignment);
 }
 
+/// <summary>
+/// Code of a basic block, which references the code of blocks nested into it instead of copying it, so that nested control flow is only joined into a single string once at the end.
+/// </summary>
+struct code_block
+{
+	struct segment
+	{
+		std::string code;
+		std::shared_ptr<const code_block> block;
+		unsigned int indentation_level;
+	};
+
+	// Code followed by a nested block, in order, and the code at the end of this block, which new code is appended to
+	std::vector<segment> segments;
+	std::string code;
+
+	bool empty() const { return segments.empty() && code.empty(); }
+
+	/// <summary>
+	/// Append another block to the end of this one, indented by the specified number of levels.
+	/// </summary>
+	void append(code_block &block, unsigned int indentation_level = 0)
+	{
+		// Move the code into a shared block and leave a reference to it behind, in case the block is appended again somewhere else
+		std::shared_ptr<const code_block> shared_block = std::make_shared<const code_block>(std::move(block));
+		block = code_block();
+		block.segments.push_back({ std::string(), shared_block, 0 });
+		append(std::move(shared_block), indentation_level);
+	}
+	void append(std::shared_ptr<const code_block> block, unsigned int indentation_level = 0)
+	{
+		code.shrink_to_fit();
+		segments.push_back({ std::move(code), std::move(block), indentation_level });
+		code.clear();
+	}
+
+	/// <summary>
+	/// Write the code of this block and all blocks nested into it to a string.
+	/// </summary>
+	void write(std::string &output, unsigned int indentation_level = 0) const
+	{
+		writer(output).write(*this, indentation_level);
+	}
+	std::string to_string(unsigned int indentation_level = 0) const
+	{
+		std::string output;
+		write(output, indentation_level);
+		return output;
+	}
+
+private:
+	// Indents the same way as applying 'increase_indentation_level' to every nested block, which indents the first line and all lines that start with a tab
+	struct writer
+	{
+		explicit writer(std::string &target) : output(target) {}
+
+		void write(const code_block &block, unsigned int indentation_level)
+		{
+			const size_t offset = output.size();
+			total_indentation_level += indentation_level;
+			pending_indentation_level += indentation_level;
+
+			for (const segment &nested : block.segments)
+			{
+				write(nested.code);
+				write(*nested.block, nested.indentation_level);
+			}
+			write(block.code);
+
+			// Empty blocks are not indented
+			if (output.size() == offset)
+				pending_indentation_level -= indentation_level;
+			total_indentation_level -= indentation_level;
+		}
+		void write(const std::string &code)
+		{
+			for (size_t line_offset = 0, line_end; line_offset < code.size(); line_offset = line_end)
+			{
+				if (pending_indentation_level != 0)
+				{
+					output.append(pending_indentation_level + (at_line_start ? total_indentation_level - pending_indentation_level : 0), '\t');
+					pending_indentation_level = 0;
+				}
+				else if (at_line_start && code[line_offset] == '\t')
+				{
+					output.append(total_indentation_level, '\t');
+				}
+
+				line_end = code.find('\n', line_offset);
+				line_end = (line_end != std::string::npos) ? line_end + 1 : code.size();
+				output.append(code, line_offset, line_end - line_offset);
+				at_line_start = code[line_end - 1] == '\n';
+			}
+		}
+
+		std::string &output;
+		unsigned int total_indentation_level = 0;
+		unsigned int pending_indentation_level = 0;
+		bool at_line_start = true;
+	};
+};
+
 class codegen_glsl : public codegen
 {
 public:
-	codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y) :
+	codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool pack_uniforms) :
 		_debug_info(debug_info),
 		_vulkan_semantics(vulkan_semantics),
 		_uniforms_to_spec_constants(uniforms_to_spec_constants),
 		_enable_16bit_types(enable_16bit_types),
-		_flip_vert_y(flip_vert_y)
+		_flip_vert_y(flip_vert_y),
+		_pack_uniforms(pack_uniforms)
 	{
 		// Create default block and reserve a memory block to avoid frequent reallocations
-		std::string &block = _blocks.emplace(0, std::string()).first->second;
+		std::string &block = _blocks.emplace(0, code_block()).first->second.code;
 		block.reserve(8192);
 	}
 
@@ -59,6 +163,7 @@ protected:
 	bool _uniforms_to_spec_constants = false;
 	bool _enable_16bit_types = false;
 	bool _flip_vert_y = false;
+	bool _pack_uniforms = false;
 
 	// Only write compatibility intrinsics to result if they are actually in use
 	bool _uses_fmod = false;
@@ -69,8 +174,13 @@ protected:
 	bool _uses_derivative_control = false;
 
 	std::unordered_map<id, std::string> _names;
-	std::unordered_map<id, std::string> _blocks;
-	std::string _ubo_block;
+	// All names in '_names', so that 'define_name' can check for collisions without searching through them
+	std::unordered_multiset<std::string> _taken_names;
+	std::unordered_map<id, code_block> _blocks;
+	// Shared code of loop continue blocks, which is inserted at every "continue" statement once the loop is complete
+	std::unordered_map<id, std::shared_ptr<code_block>> _continue_blocks;
+	// Declarations of the members of the global uniform block, in the same order as the uniform variables in the module
+	std::vector<std::string> _ubo_block;
 	std::string _compute_block;
 	std::string _current_function_declaration;
 
@@ -172,7 +282,16 @@ protected:
 
 			// Read matrices in column major layout, even though they are actually row major, to avoid transposing them on every access (since GLSL uses column matrices)
 			// TODO: This technically only works with square matrices
-			preamble += "layout(std140, column_major, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
+			// Block members are laid out in the order they are declared in, which after packing no longer is the order the uniform variables were defined in
+			std::vector<size_t> member_order(_ubo_block.size());
+			std::iota(member_order.begin(), member_order.end(), 0);
+			std::stable_sort(member_order.begin(), member_order.end(),
+				[this](size_t lhs, size_t rhs) { return _module.uniforms[lhs].offset < _module.uniforms[rhs].offset; });
+
+			preamble += "layout(std140, column_major, binding = 0) uniform _Globals {\n";
+			for (const size_t i : member_order)
+				preamble += _ubo_block[i];
+			preamble += "};\n";
 		}
 
 		return preamble;
@@ -184,14 +303,14 @@ protected:
 
 		// Add sampler definitions
 		for (const sampler &info : _module.samplers)
-			code += _blocks.at(info.id);
+			_blocks.at(info.id).write(code);
 
 		// Add storage definitions
 		for (const storage &info : _module.storages)
-			code += _blocks.at(info.id);
+			_blocks.at(info.id).write(code);
 
 		// Add global definitions (struct types, global variables, ...)
-		code += _blocks.at(0);
+		_blocks.at(0).write(code);
 
 		// Add function definitions
 		for (const std::unique_ptr<function> &func : _functions)
@@ -201,7 +320,7 @@ protected:
 			if (is_entry_point)
 				code += "#ifdef " + func->unique_name + '\n';
 
-			code += _blocks.at(func->id);
+			_blocks.at(func->id).write(code);
 
 			if (is_entry_point)
 				code += "#endif\n";
@@ -256,7 +375,7 @@ protected:
 			if (entry_point->referenced_samplers[binding] == 0)
 				continue;
 
-			std::string block_code = _blocks.at(entry_point->referenced_samplers[binding]);
+			std::string block_code = _blocks.at(entry_point->referenced_samplers[binding]).to_string();
 			replace_binding(block_code, binding);
 			code += block_code;
 		}
@@ -267,13 +386,13 @@ protected:
 			if (entry_point->referenced_storages[binding] == 0)
 				continue;
 
-			std::string block_code = _blocks.at(entry_point->referenced_storages[binding]);
+			std::string block_code = _blocks.at(entry_point->referenced_storages[binding]).to_string();
 			replace_binding(block_code, binding);
 			code += block_code;
 		}
 
 		// Add global definitions (struct types, global variables, ...)
-		code += _blocks.at(0);
+		_blocks.at(0).write(code);
 
 		// Add referenced function definitions
 		for (const std::unique_ptr<function> &func : _functions)
@@ -282,7 +401,7 @@ protected:
 				std::find(entry_point->referenced_functions.begin(), entry_point->referenced_functions.end(), func->id) == entry_point->referenced_functions.end())
 				continue;
 
-			code += _blocks.at(func->id);
+			_blocks.at(func->id).write(code);
 		}
 
 		return true;
@@ -649,10 +768,14 @@ protected:
 		if constexpr (naming_type != naming::reserved)
 			name = escape_name(std::move(name));
 		if constexpr (naming_type == naming::general)
-			if (std::find_if(_names.begin(), _names.end(),
-					[&name](const auto &names_it) { return names_it.second == name; }) != _names.end())
+			if (_taken_names.find(name) != _taken_names.end())
 				name += '_' + std::to_string(id); // Append a numbered suffix if the name already exists
-		_names[id] = std::move(name);
+
+		std::string &id_name = _names[id];
+		if (!id_name.empty())
+			_taken_names.erase(_taken_names.find(id_name));
+		_taken_names.insert(name);
+		id_name = std::move(name);
 	}
 
 	uint32_t semantic_to_location(const std::string &semantic, uint32_t max_attributes = 1)
@@ -783,7 +906,7 @@ protected:
 
 		_structs.push_back(info);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -820,7 +943,7 @@ protected:
 		const id res = info.id = create_block();
 		define_name<naming::unique>(res, info.unique_name);
 
-		std::string &code = _blocks.at(res);
+		std::string &code = _blocks.at(res).code;
 
 		write_location(code, loc);
 
@@ -841,7 +964,7 @@ protected:
 		const id res = info.id = create_block();
 		define_name<naming::unique>(res, info.unique_name);
 
-		std::string &code = _blocks.at(res);
+		std::string &code = _blocks.at(res).code;
 
 		write_location(code, loc);
 
@@ -858,6 +981,21 @@ protected:
 
 		return res;
 	}
+	static uint32_t uniform_alignment(const uniform &info)
+	{
+		// GLSL specification on std140 layout:
+		// 1. If the member is a scalar consuming N basic machine units, the base alignment is N.
+		// 2. If the member is a two- or four-component vector with components consuming N basic machine units, the base alignment is 2N or 4N, respectively.
+		// 3. If the member is a three-component vector with components consuming N basic machine units, the base alignment is 4N.
+		// 4. If the member is an array of scalars or vectors, the base alignment and array stride are set to match the base alignment of a single array element,
+		//    according to rules (1), (2), and (3), and rounded up to the base alignment of a four-component vector.
+		// 7. If the member is a row-major matrix with C columns and R rows, the matrix is stored identically to an array of R row vectors with C components each, according to rule (4).
+		// 8. If the member is an array of S row-major matrices with C columns and R rows, the matrix is stored identically to a row of S*R row vectors with C components each, according to rule (4).
+		if (info.type.is_matrix() || info.type.is_array())
+			return 16 /* (4) */;
+		return (info.type.rows == 3 ? 4 /* (3) */ : info.type.rows /* (2) */) * 4 /* (1) */;
+	}
+
 	id   define_uniform(const location &loc, uniform &info) override
 	{
 		const id res = make_id();
@@ -869,7 +1007,7 @@ protected:
 			if (info.type.is_array())
 				info.size *= info.type.array_length;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			write_location(code, loc);
 
@@ -886,50 +1024,43 @@ protected:
 		}
 		else
 		{
-			// GLSL specification on std140 layout:
-			// 1. If the member is a scalar consuming N basic machine units, the base alignment is N.
-			// 2. If the member is a two- or four-component vector with components consuming N basic machine units, the base alignment is 2N or 4N, respectively.
-			// 3. If the member is a three-component vector with components consuming N basic machine units, the base alignment is 4N.
-			// 4. If the member is an array of scalars or vectors, the base alignment and array stride are set to match the base alignment of a single array element,
-			//    according to rules (1), (2), and (3), and rounded up to the base alignment of a four-component vector.
-			// 7. If the member is a row-major matrix with C columns and R rows, the matrix is stored identically to an array of R row vectors with C components each, according to rule (4).
-			// 8. If the member is an array of S row-major matrices with C columns and R rows, the matrix is stored identically to a row of S*R row vectors with C components each, according to rule (4).
-			uint32_t alignment = (info.type.rows == 3 ? 4 /* (3) */ : info.type.rows /* (2) */) * 4 /* (1) */;
+			const uint32_t alignment = uniform_alignment(info);
 			info.size = info.type.rows * 4;
 
 			if (info.type.is_matrix())
-			{
-				alignment = 16 /* (4) */;
 				info.size = info.type.rows * alignment /* (7), (8) */;
-			}
 			if (info.type.is_array())
-			{
-				alignment = 16 /* (4) */;
 				info.size = align_up(info.size, alignment) * info.type.array_length;
-			}
 
-			// Adjust offset according to alignment rules from above
-			info.offset = _module.total_uniform_size;
-			info.offset = align_up(info.offset, alignment);
-			_module.total_uniform_size = info.offset + info.size;
+			// Adjust offset according to alignment rules
+			info.offset = allocate_uniform(info.size, alignment, false);
 
-			write_location(_ubo_block, loc);
+			std::string &member = _ubo_block.emplace_back();
 
-			_ubo_block += '\t';
+			write_location(member, loc);
+
+			member += '\t';
 			// Note: All matrices are floating-point, even if the uniform type says different!!
-			write_type(_ubo_block, info.type);
-			_ubo_block += ' ' + id_to_name(res);
+			write_type(member, info.type);
+			member += ' ' + id_to_name(res);
 
 			if (info.type.is_array())
-				_ubo_block += '[' + std::to_string(info.type.array_length) + ']';
+				member += '[' + std::to_string(info.type.array_length) + ']';
 
-			_ubo_block += ";\n";
+			member += ";\n";
 
 			_module.uniforms.push_back(info);
 		}
 
 		return res;
 	}
+	void optimize_uniform_layout() override
+	{
+		if (!_pack_uniforms)
+			return;
+
+		pack_uniforms(&uniform_alignment);
+	}
 	id   define_variable(const location &loc, const type &type, std::string name, bool global, id initializer_value) override
 	{
 		// Constant variables with a constant initializer can just point to the initializer SSA variable, since they cannot be modified anyway, thus saving an unnecessary assignment
@@ -952,7 +1083,7 @@ protected:
 		if (!name.empty())
 			define_name<naming::general>(res, name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1153,7 +1284,7 @@ protected:
 		define_function({}, entry_point);
 		enter_block(create_block());
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		// Handle input parameters
 		for (const member_type &param : func.parameter_list)
@@ -1575,7 +1706,7 @@ protected:
 		if (force_new_id)
 		{
 			// Need to store value in a new variable to comply with request for a new ID
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			code += '\t';
 			write_type(code, exp.type);
@@ -1599,7 +1730,7 @@ protected:
 			return;
 		}
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, exp.location);
 
@@ -1679,7 +1810,7 @@ protected:
 				_constant_lookup.push_back({ data_type, data, res });
 
 			// Put constant variable into global scope, so that it can be reused in different blocks
-			std::string &code = _blocks.at(0);
+			std::string &code = _blocks.at(0).code;
 
 			// GLSL requires constants to be initialized, but struct initialization is not supported right now
 			if (!data_type.is_struct())
@@ -1713,7 +1844,7 @@ protected:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1747,7 +1878,7 @@ protected:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1878,7 +2009,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1899,7 +2030,7 @@ protected:
 
 		return res;
 	}
-	id   emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1908,7 +2039,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1941,7 +2072,7 @@ protected:
 
 		return res;
 	}
-	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1950,7 +2081,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1980,7 +2111,7 @@ protected:
 
 		return res;
 	}
-	id   emit_construct(const location &loc, const type &res_type, const std::vector<expression> &args) override
+	id   emit_construct(const location &loc, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1989,7 +2120,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -2028,15 +2159,13 @@ protected:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_statement_block != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		code_block &true_statement_data = _blocks.at(true_statement_block);
+		code_block &false_statement_data = _blocks.at(false_statement_block);
 
-		code += _blocks.at(condition_block);
+		block.append(_blocks.at(condition_block));
 
 		write_location(code, loc);
 
@@ -2056,13 +2185,13 @@ protected:
 
 		code += '\t';
 		code += "if (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += true_statement_data;
+		block.append(true_statement_data, 1);
 		code += "\t}\n";
 
 		if (!false_statement_data.empty())
 		{
 			code += "\telse\n\t{\n";
-			code += false_statement_data;
+			block.append(false_statement_data, 1);
 			code += "\t}\n";
 		}
 
@@ -2075,17 +2204,16 @@ protected:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_value != 0 && true_statement_block != 0 && false_value != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
-
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		code_block &true_statement_data = _blocks.at(true_statement_block);
+		code_block &false_statement_data = _blocks.at(false_statement_block);
 
 		const id res = make_id();
 
-		code += _blocks.at(condition_block);
+		// The condition block is indented like the statement blocks if it is the same as one of them
+		block.append(_blocks.at(condition_block), (true_statement_block == condition_block ? 1 : 0) + (false_statement_block == condition_block ? 1 : 0));
 
 		code += '\t';
 		write_type(code, res_type);
@@ -2094,10 +2222,12 @@ protected:
 		write_location(code, loc);
 
 		code += "\tif (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += (true_statement_block != condition_block ? true_statement_data : std::string());
+		if (true_statement_block != condition_block)
+			block.append(true_statement_data, 1);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(true_value) + ";\n";
 		code += "\t}\n\telse\n\t{\n";
-		code += (false_statement_block != condition_block ? false_statement_data : std::string());
+		if (false_statement_block != condition_block)
+			block.append(false_statement_data, 1);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(false_value) + ";\n";
 		code += "\t}\n";
 
@@ -2112,16 +2242,13 @@ protected:
 	{
 		assert(prev_block != 0 && header_block != 0 && loop_block != 0 && continue_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &loop_data = _blocks.at(loop_block);
-		std::string &continue_data = _blocks.at(continue_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		increase_indentation_level(loop_data);
-		increase_indentation_level(loop_data);
-		increase_indentation_level(continue_data);
+		code_block &loop_data = _blocks.at(loop_block);
+		std::string continue_data = _blocks.at(continue_block).to_string(1);
 
-		code += _blocks.at(prev_block);
+		block.append(_blocks.at(prev_block));
 
 		std::string attributes;
 		if (flags != 0)
@@ -2149,9 +2276,7 @@ protected:
 			continue_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 
 			// We need to add the continue block to all "continue" statements as well
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data);
+			set_continue_code(continue_block, continue_data);
 
 			code += "\tbool " + condition_name + ";\n";
 
@@ -2160,14 +2285,14 @@ protected:
 			code += attributes;
 			code += '\t';
 			code += "do\n\t{\n\t\t{\n";
-			code += loop_data; // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
+			block.append(loop_data, 2); // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
 			code += "\t\t}\n";
 			code += continue_data;
 			code += "\t}\n\twhile (" + condition_name + ");\n";
 		}
 		else
 		{
-			std::string &condition_data = _blocks.at(condition_block);
+			std::string condition_data = _blocks.at(condition_block).to_string();
 
 			// If the condition data is just a single line, then it is a simple expression, which we can just put into the loop condition as-is
 			if (std::count(condition_data.begin(), condition_data.end(), '\n') == 1)
@@ -2193,14 +2318,12 @@ protected:
 				condition_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 			}
 
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data + condition_data);
+			set_continue_code(continue_block, continue_data + condition_data);
 
 			code += attributes;
 			code += '\t';
 			code += "while (" + condition_name + ")\n\t{\n\t\t{\n";
-			code += loop_data;
+			block.append(loop_data, 2);
 			code += "\t\t}\n";
 			code += continue_data;
 			code += condition_data;
@@ -2220,9 +2343,10 @@ protected:
 		assert(selector_value != 0 && selector_block != 0 && default_label != 0 && default_block != 0);
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		code += _blocks.at(selector_block);
+		block.append(_blocks.at(selector_block));
 
 		write_location(code, loc);
 
@@ -2254,24 +2378,20 @@ protected:
 			}
 
 			assert(case_blocks[i / 2] != 0);
-			std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-			increase_indentation_level(case_data);
+			code_block &case_data = _blocks.at(case_blocks[i / 2]);
 
 			code += "{\n";
-			code += case_data;
+			block.append(case_data, 1);
 			code += "\t}\n";
 		}
 
 
 		if (default_label != 0 && default_block != _current_block)
 		{
-			std::string &default_data = _blocks.at(default_block);
-
-			increase_indentation_level(default_data);
+			code_block &default_data = _blocks.at(default_block);
 
 			code += "\tdefault: {\n";
-			code += default_data;
+			block.append(default_data, 1);
 			code += "\t}\n";
 
 			_blocks.erase(default_block);
@@ -2289,11 +2409,29 @@ protected:
 	{
 	}
 
+	std::shared_ptr<code_block> get_continue_block(id continue_block)
+	{
+		std::shared_ptr<code_block> &block = _continue_blocks[continue_block];
+		if (block == nullptr)
+			block = std::make_shared<code_block>();
+		return block;
+	}
+	void set_continue_code(id continue_block, std::string code)
+	{
+		// Fill in the code at all "continue" statements that were added to the loop body
+		if (const auto it = _continue_blocks.find(continue_block);
+			it != _continue_blocks.end())
+		{
+			it->second->code = std::move(code);
+			_continue_blocks.erase(it);
+		}
+	}
+
 	id   create_block() override
 	{
 		const id res = make_id();
 
-		std::string &block = _blocks.emplace(res, std::string()).first->second;
+		std::string &block = _blocks.emplace(res, code_block()).first->second.code;
 		// Reserve a decently big enough memory block to avoid frequent reallocations
 		block.reserve(4096);
 
@@ -2315,7 +2453,7 @@ protected:
 		if (!is_in_block())
 			return 0;
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\tdiscard;\n";
 
@@ -2343,7 +2481,7 @@ protected:
 		if (!_current_function->return_type.is_void() && value == 0)
 			return set_block(0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\treturn";
 
@@ -2366,7 +2504,8 @@ protected:
 		if (!is_in_block())
 			return _last_block;
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
 		switch (loop_flow)
 		{
@@ -2374,7 +2513,8 @@ protected:
 			code += "\tbreak;\n";
 			break;
 		case 2: // Keep track of continue target block, so we can insert its code here later
-			code += "__CONTINUE__" + std::to_string(target) + "\tcontinue;\n";
+			block.append(get_continue_block(target));
+			code += "\tcontinue;\n";
 			break;
 		}
 
@@ -2391,7 +2531,10 @@ protected:
 	{
 		assert(_current_function != nullptr && _last_block != 0);
 
-		_blocks.emplace(_current_function->id, _current_function_declaration + "{\n" + _blocks.at(_last_block) + "}\n");
+		code_block &function_data = _blocks.emplace(_current_function->id, code_block()).first->second;
+		function_data.code = _current_function_declaration + "{\n";
+		function_data.append(_blocks.at(_last_block));
+		function_data.code += "}\n";
 
 		_current_function = nullptr;
 		_current_function_declaration.clear();
@@ -2399,8 +2542,8 @@ protected:
 };
 
 #ifndef RESHADEFX_CODEGEN_GLSL_INLINE
-codegen *reshadefx::create_codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+codegen *reshadefx::create_codegen_glsl(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, bool pack_uniforms)
 {
-	return new codegen_glsl(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y);
+	return new codegen_glsl(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y, pack_uniforms);
 }
 #endif
@@ -11,6 +11,7 @@
 #include <cstring> // stricmp, std::memcmp
 #include <charconv> // std::from_chars, std::to_chars
 #include <algorithm> // std::equal, std::find, std::find_if, std::max
+#include <unordered_set>
 
 using namespace reshadefx;
 
@@ -26,16 +27,119 @@ inline uint32_t align_up(uint32_t size, uint32_t alignment, uint32_t elements)
 	return ((size + alignment) & ~alignment) * (elements - 1) + size;
 }
 
+/// <summary>
+/// Code of a basic block, which references the code of blocks nested into it instead of copying it, so that nested control flow is only joined into a single string once at the end.
+/// </summary>
+struct code_block
+{
+	struct segment
+	{
+		std::string code;
+		std::shared_ptr<const code_block> block;
+		unsigned int indentation_level;
+	};
+
+	// Code followed by a nested block, in order, and the code at the end of this block, which new code is appended to
+	std::vector<segment> segments;
+	std::string code;
+
+	bool empty() const { return segments.empty() && code.empty(); }
+
+	/// <summary>
+	/// Append another block to the end of this one, indented by the specified number of levels.
+	/// </summary>
+	void append(code_block &block, unsigned int indentation_level = 0)
+	{
+		// Move the code into a shared block and leave a reference to it behind, in case the block is appended again somewhere else
+		std::shared_ptr<const code_block> shared_block = std::make_shared<const code_block>(std::move(block));
+		block = code_block();
+		block.segments.push_back({ std::string(), shared_block, 0 });
+		append(std::move(shared_block), indentation_level);
+	}
+	void append(std::shared_ptr<const code_block> block, unsigned int indentation_level = 0)
+	{
+		code.shrink_to_fit();
+		segments.push_back({ std::move(code), std::move(block), indentation_level });
+		code.clear();
+	}
+
+	/// <summary>
+	/// Write the code of this block and all blocks nested into it to a string.
+	/// </summary>
+	void write(std::string &output, unsigned int indentation_level = 0) const
+	{
+		writer(output).write(*this, indentation_level);
+	}
+	std::string to_string(unsigned int indentation_level = 0) const
+	{
+		std::string output;
+		write(output, indentation_level);
+		return output;
+	}
+
+private:
+	// Indents the same way as applying 'increase_indentation_level' to every nested block, which indents the first line and all lines that start with a tab
+	struct writer
+	{
+		explicit writer(std::string &target) : output(target) {}
+
+		void write(const code_block &block, unsigned int indentation_level)
+		{
+			const size_t offset = output.size();
+			total_indentation_level += indentation_level;
+			pending_indentation_level += indentation_level;
+
+			for (const segment &nested : block.segments)
+			{
+				write(nested.code);
+				write(*nested.block, nested.indentation_level);
+			}
+			write(block.code);
+
+			// Empty blocks are not indented
+			if (output.size() == offset)
+				pending_indentation_level -= indentation_level;
+			total_indentation_level -= indentation_level;
+		}
+		void write(const std::string &code)
+		{
+			for (size_t line_offset = 0, line_end; line_offset < code.size(); line_offset = line_end)
+			{
+				if (pending_indentation_level != 0)
+				{
+					output.append(pending_indentation_level + (at_line_start ? total_indentation_level - pending_indentation_level : 0), '\t');
+					pending_indentation_level = 0;
+				}
+				else if (at_line_start && code[line_offset] == '\t')
+				{
+					output.append(total_indentation_level, '\t');
+				}
+
+				line_end = code.find('\n', line_offset);
+				line_end = (line_end != std::string::npos) ? line_end + 1 : code.size();
+				output.append(code, line_offset, line_end - line_offset);
+				at_line_start = code[line_end - 1] == '\n';
+			}
+		}
+
+		std::string &output;
+		unsigned int total_indentation_level = 0;
+		unsigned int pending_indentation_level = 0;
+		bool at_line_start = true;
+	};
+};
+
 class codegen_hlsl : public codegen
 {
 public:
-	codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants) :
+	codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool pack_uniforms) :
 		_shader_model(shader_model),
 		_debug_info(debug_info),
-		_uniforms_to_spec_constants(uniforms_to_spec_constants)
+		_uniforms_to_spec_constants(uniforms_to_spec_constants),
+		_pack_uniforms(pack_uniforms)
 	{
 		// Create default block and reserve a memory block to avoid frequent reallocations
-		std::string &block = _blocks.emplace(0, std::string()).first->second;
+		std::string &block = _blocks.emplace(0, code_block()).first->second.code;
 		block.reserve(8192);
 	}
 
@@ -53,14 +157,20 @@ protected:
 	unsigned int _shader_model = 0;
 	bool _debug_info = false;
 	bool _uniforms_to_spec_constants = false;
+	bool _pack_uniforms = false;
 
 	// Only write compatibility intrinsics to result if they are actually in use
 	bool _uses_bitwise_cast = false;
 	bool _uses_bitwise_intrinsics = false;
 
 	std::unordered_map<id, std::string> _names;
-	std::unordered_map<id, std::string> _blocks;
-	std::string _cbuffer_block;
+	// All names in '_names', so that 'define_name' can check for collisions without searching through them
+	std::unordered_multiset<std::string> _taken_names;
+	std::unordered_map<id, code_block> _blocks;
+	// Shared code of loop continue blocks, which is inserted at every "continue" statement once the loop is complete
+	std::unordered_map<id, std::shared_ptr<code_block>> _continue_blocks;
+	// Declarations of the members of the global constant buffer, in the same order as the uniform variables in the module
+	std::vector<std::string> _cbuffer_block;
 	std::string _current_location;
 	std::string _current_function_declaration;
 
@@ -317,12 +427,35 @@ protected:
 				if (_shader_model >= 60)
 					preamble += "[[vk::binding(0, 0)]] "; // Descriptor set 0
 
-				preamble += "cbuffer _Globals {\n" + _cbuffer_block + "};\n";
+				preamble += "cbuffer _Globals {\n";
 			}
-			else
+
+			for (size_t i = 0; i < _cbuffer_block.size(); ++i)
 			{
-				preamble += _cbuffer_block;
+				const uniform &info = _module.uniforms[i];
+
+				preamble += _cbuffer_block[i];
+
+				if (_shader_model < 40)
+				{
+					// Every constant register is 16 bytes wide, so divide memory offset by 16 to get the constant register index
+					// Note: All uniforms are floating-point in shader model 3, even if the uniform type says different!!
+					preamble += " : register(c" + std::to_string(info.offset / 16) + ')';
+				}
+				else if (_pack_uniforms)
+				{
+					// Declaration order does not match the layout after packing, so specify the offset explicitly
+					preamble += " : packoffset(c" + std::to_string(info.offset / 16);
+					if ((info.offset & 15) != 0)
+						preamble += std::string(".") + "xyzw"[(info.offset & 15) / 4];
+					preamble += ')';
+				}
+
+				preamble += ";\n";
 			}
+
+			if (_shader_model >= 40)
+				preamble += "};\n";
 		}
 
 		return preamble;
@@ -333,19 +466,19 @@ protected:
 		std::string code = finalize_preamble();
 
 		// Add global definitions (struct types, global variables, sampler state declarations, ...)
-		code += _blocks.at(0);
+		_blocks.at(0).write(code);
 
 		// Add texture and sampler definitions
 		for (const sampler &info : _module.samplers)
-			code += _blocks.at(info.id);
+			_blocks.at(info.id).write(code);
 
 		// Add storage definitions
 		for (const storage &info : _module.storages)
-			code += _blocks.at(info.id);
+			_blocks.at(info.id).write(code);
 
 		// Add function definitions
 		for (const std::unique_ptr<function> &func : _functions)
-			code += _blocks.at(func->id);
+			_blocks.at(func->id).write(code);
 
 		return code;
 	}
@@ -362,7 +495,7 @@ protected:
 			code += "#define POSITION VPOS\n";
 
 		// Add global definitions (struct types, global variables, sampler state declarations, ...)
-		code += _blocks.at(0);
+		_blocks.at(0).write(code);
 
 		const auto replace_binding =
 			[](std::string &code, uint32_t binding) {
@@ -377,7 +510,7 @@ protected:
 			if (entry_point->referenced_samplers[binding] == 0)
 				continue;
 
-			std::string block_code = _blocks.at(entry_point->referenced_samplers[binding]);
+			std::string block_code = _blocks.at(entry_point->referenced_samplers[binding]).to_string();
 			replace_binding(block_code, binding);
 			code += block_code;
 		}
@@ -388,7 +521,7 @@ protected:
 			if (entry_point->referenced_storages[binding] == 0)
 				continue;
 
-			std::string block_code = _blocks.at(entry_point->referenced_storages[binding]);
+			std::string block_code = _blocks.at(entry_point->referenced_storages[binding]).to_string();
 			replace_binding(block_code, binding);
 			code += block_code;
 		}
@@ -400,7 +533,7 @@ protected:
 				std::find(entry_point->referenced_functions.begin(), entry_point->referenced_functions.end(), func->id) == entry_point->referenced_functions.end())
 				continue;
 
-			code += _blocks.at(func->id);
+			_blocks.at(func->id).write(code);
 		}
 
 		return true;
@@ -738,10 +871,14 @@ protected:
 				return; // Filter out names that may clash with automatic ones
 		name = escape_name(std::move(name));
 		if constexpr (naming_type == naming::general)
-			if (std::find_if(_names.begin(), _names.end(),
-					[&name](const auto &names_it) { return names_it.second == name; }) != _names.end())
+			if (_taken_names.find(name) != _taken_names.end())
 				name += '_' + std::to_string(id); // Append a numbered suffix if the name already exists
-		_names[id] = std::move(name);
+
+		std::string &id_name = _names[id];
+		if (!id_name.empty())
+			_taken_names.erase(_taken_names.find(id_name));
+		_taken_names.insert(name);
+		id_name = std::move(name);
 	}
 
 	std::string convert_semantic(const std::string &semantic, uint32_t max_attributes = 1)
@@ -848,7 +985,7 @@ protected:
 
 		_structs.push_back(info);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -884,8 +1021,8 @@ protected:
 			info.semantic_binding = 224 - (1 + _texture_semantic_index++);
 			assert((_module.total_uniform_size / 16) <= info.semantic_binding);
 
-			if (_blocks.at(0).find(pixel_size_variable_name) == std::string::npos)
-				_blocks.at(0) += "uniform float2 " + pixel_size_variable_name + " : register(c" + std::to_string(info.semantic_binding) + ");\n";
+			if (_blocks.at(0).code.find(pixel_size_variable_name) == std::string::npos)
+				_blocks.at(0).code += "uniform float2 " + pixel_size_variable_name + " : register(c" + std::to_string(info.semantic_binding) + ");\n";
 		}
 
 		_module.textures.push_back(info);
@@ -897,7 +1034,7 @@ protected:
 		const id res = info.id = create_block();
 		define_name<naming::unique>(res, info.unique_name);
 
-		std::string &code = _blocks.at(res);
+		std::string &code = _blocks.at(res).code;
 
 		// Default to a register index equivalent to the entry in the sampler list (this is later overwritten in 'finalize_code_for_entry_point' to a more optimal placement)
 		const uint32_t default_binding = static_cast<uint32_t>(_module.samplers.size());
@@ -932,9 +1069,9 @@ protected:
 				_sampler_lookup.push_back(std::move(s));
 
 				if (_shader_model >= 60)
-					_blocks.at(0) += "[[vk::binding(" + std::to_string(sampler_state_binding) + ", 1)]] "; // Descriptor set 1
+					_blocks.at(0).code += "[[vk::binding(" + std::to_string(sampler_state_binding) + ", 1)]] "; // Descriptor set 1
 
-				_blocks.at(0) += "SamplerState __s" + std::to_string(sampler_state_binding) + " : register(s" + std::to_string(sampler_state_binding) + ");\n";
+				_blocks.at(0).code += "SamplerState __s" + std::to_string(sampler_state_binding) + " : register(s" + std::to_string(sampler_state_binding) + ");\n";
 			}
 
 			if (_shader_model >= 60)
@@ -997,7 +1134,7 @@ protected:
 
 		if (_shader_model >= 50)
 		{
-			std::string &code = _blocks.at(res);
+			std::string &code = _blocks.at(res).code;
 
 			write_location(code, loc);
 
@@ -1012,6 +1149,14 @@ protected:
 
 		return res;
 	}
+	static uint32_t uniform_alignment(const uniform &info)
+	{
+		// Arrays and matrices always start on a new 16-byte boundary (even when they are smaller than that), everything else is only prevented from crossing one
+		if (info.type.is_matrix() || info.type.is_array())
+			return 16;
+		return 4;
+	}
+
 	id   define_uniform(const location &loc, uniform &info) override
 	{
 		const id res = make_id();
@@ -1023,7 +1168,7 @@ protected:
 			if (info.type.is_array())
 				info.size *= info.type.array_length;
 
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			write_location(code, loc);
 
@@ -1053,19 +1198,17 @@ protected:
 
 			// Data is packed into 4-byte boundaries (see https://docs.microsoft.com/windows/win32/direct3dhlsl/dx-graphics-hlsl-packing-rules)
 			// This is already guaranteed, since all types are at least 4-byte in size
-			info.offset = _module.total_uniform_size;
 			// Additionally, HLSL packs data so that it does not cross a 16-byte boundary
-			const uint32_t remaining = 16 - (info.offset & 15);
-			if (remaining != 16 && info.size > remaining)
-				info.offset += remaining;
-			_module.total_uniform_size = info.offset + info.size;
+			info.offset = allocate_uniform(info.size, uniform_alignment(info), false);
+
+			std::string &member = _cbuffer_block.emplace_back();
 
-			write_location<true>(_cbuffer_block, loc);
+			write_location<true>(member, loc);
 
 			if (_shader_model >= 40)
-				_cbuffer_block += '\t';
+				member += '\t';
 			if (info.type.is_matrix()) // Force row major matrices
-				_cbuffer_block += "row_major ";
+				member += "row_major ";
 
 			type type = info.type;
 			if (_shader_model < 40)
@@ -1079,26 +1222,25 @@ protected:
 				_module.total_uniform_size *= 4;
 			}
 
-			write_type(_cbuffer_block, type);
-			_cbuffer_block += ' ' + id_to_name(res);
+			write_type(member, type);
+			member += ' ' + id_to_name(res);
 
 			if (info.type.is_array())
-				_cbuffer_block += '[' + std::to_string(info.type.array_length) + ']';
-
-			if (_shader_model < 40)
-			{
-				// Every constant register is 16 bytes wide, so divide memory offset by 16 to get the constant register index
-				// Note: All uniforms are floating-point in shader model 3, even if the uniform type says different!!
-				_cbuffer_block += " : register(c" + std::to_string(info.offset / 16) + ')';
-			}
-
-			_cbuffer_block += ";\n";
+				member += '[' + std::to_string(info.type.array_length) + ']';
 
 			_module.uniforms.push_back(info);
 		}
 
 		return res;
 	}
+	void optimize_uniform_layout() override
+	{
+		// Every uniform is put into separate constant registers in shader model 3, so there is no padding to fill
+		if (!_pack_uniforms || _shader_model < 40)
+			return;
+
+		pack_uniforms(&uniform_alignment);
+	}
 	id   define_variable(const location &loc, const type &type, std::string name, bool global, id initializer_value) override
 	{
 		// Constant variables with a constant initializer can just point to the initializer SSA variable, since they cannot be modified anyway, thus saving an unnecessary assignment
@@ -1114,7 +1256,7 @@ protected:
 		if (!name.empty())
 			define_name<naming::general>(res, name);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1273,7 +1415,7 @@ protected:
 		define_function({}, entry_point);
 		enter_block(create_block());
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		// Clear all color output parameters so no component is left uninitialized
 		for (const member_type &param : entry_point.parameter_list)
@@ -1393,7 +1535,7 @@ protected:
 		if (force_new_id)
 		{
 			// Need to store value in a new variable to comply with request for a new ID
-			std::string &code = _blocks.at(_current_block);
+			std::string &code = _blocks.at(_current_block).code;
 
 			code += '\t';
 			write_type(code, exp.type);
@@ -1409,7 +1551,7 @@ protected:
 	}
 	void emit_store(const expression &exp, id value) override
 	{
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, exp.location);
 
@@ -1474,7 +1616,7 @@ protected:
 				_constant_lookup.push_back({ data_type, data, res });
 
 			// Put constant variable into global scope, so that it can be reused in different blocks
-			std::string &code = _blocks.at(0);
+			std::string &code = _blocks.at(0).code;
 
 			// Array constants need to be stored in a constant variable as they cannot be used in-place
 			code += "static const ";
@@ -1498,7 +1640,7 @@ protected:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1519,7 +1661,7 @@ protected:
 	{
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1631,7 +1773,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1646,7 +1788,7 @@ protected:
 
 		return res;
 	}
-	id   emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1655,7 +1797,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1688,7 +1830,7 @@ protected:
 
 		return res;
 	}
-	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1697,7 +1839,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		enum
 		{
@@ -1727,7 +1869,7 @@ protected:
 
 		return res;
 	}
-	id   emit_construct(const location &loc, const type &res_type, const std::vector<expression> &args) override
+	id   emit_construct(const location &loc, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -1736,7 +1878,7 @@ protected:
 
 		const id res = make_id();
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		write_location(code, loc);
 
@@ -1778,15 +1920,13 @@ protected:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_statement_block != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		code_block &true_statement_data = _blocks.at(true_statement_block);
+		code_block &false_statement_data = _blocks.at(false_statement_block);
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
-
-		code += _blocks.at(condition_block);
+		block.append(_blocks.at(condition_block));
 
 		write_location(code, loc);
 
@@ -1796,13 +1936,13 @@ protected:
 		if (flags & 0x2) code += "[branch] ";
 
 		code += "if (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += true_statement_data;
+		block.append(true_statement_data, 1);
 		code += "\t}\n";
 
 		if (!false_statement_data.empty())
 		{
 			code += "\telse\n\t{\n";
-			code += false_statement_data;
+			block.append(false_statement_data, 1);
 			code += "\t}\n";
 		}
 
@@ -1815,17 +1955,16 @@ protected:
 	{
 		assert(condition_value != 0 && condition_block != 0 && true_value != 0 && true_statement_block != 0 && false_value != 0 && false_statement_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &true_statement_data = _blocks.at(true_statement_block);
-		std::string &false_statement_data = _blocks.at(false_statement_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		increase_indentation_level(true_statement_data);
-		increase_indentation_level(false_statement_data);
+		code_block &true_statement_data = _blocks.at(true_statement_block);
+		code_block &false_statement_data = _blocks.at(false_statement_block);
 
 		const id res = make_id();
 
-		code += _blocks.at(condition_block);
+		// The condition block is indented like the statement blocks if it is the same as one of them
+		block.append(_blocks.at(condition_block), (true_statement_block == condition_block ? 1 : 0) + (false_statement_block == condition_block ? 1 : 0));
 
 		code += '\t';
 		write_type(code, res_type);
@@ -1834,10 +1973,12 @@ protected:
 		write_location(code, loc);
 
 		code += "\tif (" + id_to_name(condition_value) + ")\n\t{\n";
-		code += (true_statement_block != condition_block ? true_statement_data : std::string());
+		if (true_statement_block != condition_block)
+			block.append(true_statement_data, 1);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(true_value) + ";\n";
 		code += "\t}\n\telse\n\t{\n";
-		code += (false_statement_block != condition_block ? false_statement_data : std::string());
+		if (false_statement_block != condition_block)
+			block.append(false_statement_data, 1);
 		code += "\t\t" + id_to_name(res) + " = " + id_to_name(false_value) + ";\n";
 		code += "\t}\n";
 
@@ -1852,16 +1993,13 @@ protected:
 	{
 		assert(prev_block != 0 && header_block != 0 && loop_block != 0 && continue_block != 0);
 
-		std::string &code = _blocks.at(_current_block);
-
-		std::string &loop_data = _blocks.at(loop_block);
-		std::string &continue_data = _blocks.at(continue_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		increase_indentation_level(loop_data);
-		increase_indentation_level(loop_data);
-		increase_indentation_level(continue_data);
+		code_block &loop_data = _blocks.at(loop_block);
+		std::string continue_data = _blocks.at(continue_block).to_string(1);
 
-		code += _blocks.at(prev_block);
+		block.append(_blocks.at(prev_block));
 
 		std::string attributes;
 		if (flags & 0x1)
@@ -1880,9 +2018,7 @@ protected:
 			continue_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 
 			// We need to add the continue block to all "continue" statements as well
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data);
+			set_continue_code(continue_block, continue_data);
 
 			code += "\tbool " + condition_name + ";\n";
 
@@ -1890,14 +2026,14 @@ protected:
 
 			code += '\t' + attributes;
 			code += "do\n\t{\n\t\t{\n";
-			code += loop_data; // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
+			block.append(loop_data, 2); // Encapsulate loop body into another scope, so not to confuse any local variables with the current iteration variable accessed in the continue block below
 			code += "\t\t}\n";
 			code += continue_data;
 			code += "\t}\n\twhile (" + condition_name + ");\n";
 		}
 		else
 		{
-			std::string &condition_data = _blocks.at(condition_block);
+			std::string condition_data = _blocks.at(condition_block).to_string();
 
 			// Work around D3DCompiler putting uniform variables that are used as the loop count register into integer registers (only in SM3)
 			// Only applies to dynamic loops with uniform variables in the condition, where it generates a loop instruction like "rep i0", but then expects the "i0" register to be set externally
@@ -1933,9 +2069,7 @@ protected:
 				condition_data.erase(pos_prev_assign + 1, pos_assign - pos_prev_assign - 1);
 			}
 
-			const std::string continue_id = "__CONTINUE__" + std::to_string(continue_block);
-			for (size_t offset = 0; (offset = loop_data.find(continue_id, offset)) != std::string::npos; offset += continue_data.size())
-				loop_data.replace(offset, continue_id.size(), continue_data + condition_data);
+			set_continue_code(continue_block, continue_data + condition_data);
 
 			write_location(code, loc);
 
@@ -1944,7 +2078,7 @@ protected:
 				code += "while (true)\n\t{\n\t\tif (" + condition_name + ")\n\t\t{\n";
 			else
 				code += "while (" + condition_name + ")\n\t{\n\t\t{\n";
-			code += loop_data;
+			block.append(loop_data, 2);
 			code += "\t\t}\n";
 			if (use_break_statement_for_condition)
 				code += "\t\telse break;\n";
@@ -1966,9 +2100,10 @@ protected:
 		assert(selector_value != 0 && selector_block != 0 && default_label != 0 && default_block != 0);
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
-		code += _blocks.at(selector_block);
+		block.append(_blocks.at(selector_block));
 
 		if (_shader_model >= 40)
 		{
@@ -2009,23 +2144,19 @@ protected:
 				}
 
 				assert(case_blocks[i / 2] != 0);
-				std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-				increase_indentation_level(case_data);
+				code_block &case_data = _blocks.at(case_blocks[i / 2]);
 
 				code += "{\n";
-				code += case_data;
+				block.append(case_data, 1);
 				code += "\t}\n";
 			}
 
 			if (default_label != 0 && default_block != _current_block)
 			{
-				std::string &default_data = _blocks.at(default_block);
-
-				increase_indentation_level(default_data);
+				code_block &default_data = _blocks.at(default_block);
 
 				code += "\tdefault: {\n";
-				code += default_data;
+				block.append(default_data, 1);
 				code += "\t}\n";
 
 				_blocks.erase(default_block);
@@ -2060,12 +2191,10 @@ protected:
 				}
 
 				assert(case_blocks[i / 2] != 0);
-				std::string &case_data = _blocks.at(case_blocks[i / 2]);
-
-				increase_indentation_level(case_data);
+				code_block &case_data = _blocks.at(case_blocks[i / 2]);
 
 				code += ")\n\t{\n";
-				code += case_data;
+				block.append(case_data, 1);
 				code += "\t}\n\telse\n\t";
 			}
 
@@ -2073,11 +2202,9 @@ protected:
 
 			if (default_block != _current_block)
 			{
-				std::string &default_data = _blocks.at(default_block);
-
-				increase_indentation_level(default_data);
+				code_block &default_data = _blocks.at(default_block);
 
-				code += default_data;
+				block.append(default_data, 1);
 
 				_blocks.erase(default_block);
 			}
@@ -2096,15 +2223,33 @@ protected:
 		if (pragma == "reshade skipoptimization" || pragma == "reshade nooptimization")
 			return;
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 		code += "#pragma " + pragma + '\n';
 	}
 
+	std::shared_ptr<code_block> get_continue_block(id continue_block)
+	{
+		std::shared_ptr<code_block> &block = _continue_blocks[continue_block];
+		if (block == nullptr)
+			block = std::make_shared<code_block>();
+		return block;
+	}
+	void set_continue_code(id continue_block, std::string code)
+	{
+		// Fill in the code at all "continue" statements that were added to the loop body
+		if (const auto it = _continue_blocks.find(continue_block);
+			it != _continue_blocks.end())
+		{
+			it->second->code = std::move(code);
+			_continue_blocks.erase(it);
+		}
+	}
+
 	id   create_block() override
 	{
 		const id res = make_id();
 
-		std::string &block = _blocks.emplace(res, std::string()).first->second;
+		std::string &block = _blocks.emplace(res, code_block()).first->second.code;
 		// Reserve a decently big enough memory block to avoid frequent reallocations
 		block.reserve(4096);
 
@@ -2126,7 +2271,7 @@ protected:
 		if (!is_in_block())
 			return 0;
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\tdiscard;\n";
 
@@ -2156,7 +2301,7 @@ protected:
 		if (!_current_function->return_type.is_void() && value == 0)
 			return set_block(0);
 
-		std::string &code = _blocks.at(_current_block);
+		std::string &code = _blocks.at(_current_block).code;
 
 		code += "\treturn";
 
@@ -2179,7 +2324,8 @@ protected:
 		if (!is_in_block())
 			return _last_block;
 
-		std::string &code = _blocks.at(_current_block);
+		code_block &block = _blocks.at(_current_block);
+		std::string &code = block.code;
 
 		switch (loop_flow)
 		{
@@ -2187,7 +2333,8 @@ protected:
 			code += "\tbreak;\n";
 			break;
 		case 2: // Keep track of continue target block, so we can insert its code here later
-			code += "__CONTINUE__" + std::to_string(target) + "\tcontinue;\n";
+			block.append(get_continue_block(target));
+			code += "\tcontinue;\n";
 			break;
 		}
 
@@ -2204,7 +2351,10 @@ protected:
 	{
 		assert(_current_function != nullptr && _last_block != 0);
 
-		_blocks.emplace(_current_function->id, _current_function_declaration + "{\n" + _blocks.at(_last_block) + "}\n");
+		code_block &function_data = _blocks.emplace(_current_function->id, code_block()).first->second;
+		function_data.code = _current_function_declaration + "{\n";
+		function_data.append(_blocks.at(_last_block));
+		function_data.code += "}\n";
 
 		_current_function = nullptr;
 		_current_function_declaration.clear();
@@ -2212,8 +2362,8 @@ protected:
 };
 
 #ifndef RESHADEFX_CODEGEN_HLSL_INLINE
-codegen *reshadefx::create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants)
+codegen *reshadefx::create_codegen_hlsl(unsigned int shader_model, bool debug_info, bool uniforms_to_spec_constants, bool pack_uniforms)
 {
-	return new codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants);
+	return new codegen_hlsl(shader_model, debug_info, uniforms_to_spec_constants, pack_uniforms);
 }
 #endif
@@ -0,0 +1,1013 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "effect_codegen.hpp"
+#include <cassert>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm> // std::all_of, std::none_of, std::swap
+
+using namespace reshadefx;
+
+namespace reshadefx
+{
+	class codegen_optimizer;
+}
+
+/// <summary>
+/// A code generation layer which records the SSA stream of each function, removes redundant and unused values from it and then replays the result into the actual back-end.
+/// All definitions outside of functions are passed through to the back-end immediately.
+/// </summary>
+class reshadefx::codegen_optimizer final : public codegen
+{
+public:
+	explicit codegen_optimizer(codegen *backend) :
+		_backend(backend)
+	{
+		// Take over the state of the back-end, so that the parser sees the same module and functions through this layer
+		swap_state();
+	}
+	~codegen_optimizer()
+	{
+		// Hand everything generated so far back to the back-end
+		swap_state();
+	}
+
+	std::string finalize_code() const override
+	{
+		return _backend->finalize_code();
+	}
+	bool assemble_code_for_entry_point(const std::string &entry_point_name, std::string &binary, std::string &assembly, std::string &errors) const override
+	{
+		return _backend->assemble_code_for_entry_point(entry_point_name, binary, assembly, errors);
+	}
+
+private:
+	/// <summary>
+	/// A call into the code generation interface that was made inside a function.
+	/// </summary>
+	struct instruction
+	{
+		enum op_type
+		{
+			op_create_block,
+			op_set_block,
+			op_enter_block,
+			op_leave_block_and_kill,
+			op_leave_block_and_return,
+			op_leave_block_and_switch,
+			op_leave_block_and_branch,
+			op_leave_block_and_branch_conditional,
+			op_define_variable,
+			op_load,
+			op_store,
+			op_access_chain,
+			op_constant,
+			op_unary_op,
+			op_binary_op,
+			op_ternary_op,
+			op_call,
+			op_call_intrinsic,
+			op_construct,
+			op_if,
+			op_phi,
+			op_loop,
+			op_switch,
+		};
+
+		op_type op;
+		// Set if this only computes a value without any side effects, so it can be removed if that value is never used
+		bool is_pure = false;
+		bool is_dead = false;
+		// Set to the value of 'force_new_id' for loads and 'global' for variables
+		bool flag = false;
+		unsigned int flags = 0;
+		tokenid token = tokenid::unknown;
+		id result = 0;
+		// Intrinsic to call, which is not an SSA ID and therefore never replaced
+		id intrinsic = 0;
+		location loc;
+		type res_type = {};
+		type value_type = {};
+		std::vector<id> operands;
+		expression chain;
+		std::pmr::vector<expression> args;
+		constant data = {};
+		std::string name;
+		std::vector<id> case_literal_and_labels;
+		std::vector<id> case_blocks;
+	};
+
+	/// <summary>
+	/// Temporarily hands the state shared with the parser over to the back-end while calling into it.
+	/// </summary>
+	struct backend_scope
+	{
+		explicit backend_scope(codegen_optimizer &optimizer) : optimizer(optimizer) { optimizer.swap_state(); }
+		~backend_scope() { optimizer.swap_state(); }
+
+		codegen_optimizer &optimizer;
+	};
+
+	void swap_state()
+	{
+		std::swap(_module, _backend->_module);
+		std::swap(_structs, _backend->_structs);
+		std::swap(_functions, _backend->_functions);
+		std::swap(_next_id, _backend->_next_id);
+		std::swap(_last_block, _backend->_last_block);
+		std::swap(_current_block, _backend->_current_block);
+		std::swap(_current_function, _backend->_current_function);
+	}
+
+	id   define_struct(const location &loc, struct_type &info) override
+	{
+		const backend_scope scope(*this);
+		return _backend->define_struct(loc, info);
+	}
+	id   define_texture(const location &loc, texture &info) override
+	{
+		const backend_scope scope(*this);
+		const id res = _backend->define_texture(loc, info);
+		_read_only_variables.insert(res);
+		return res;
+	}
+	id   define_sampler(const location &loc, const texture &tex_info, sampler &info) override
+	{
+		const backend_scope scope(*this);
+		const id res = _backend->define_sampler(loc, tex_info, info);
+		_read_only_variables.insert(res);
+		return res;
+	}
+	id   define_storage(const location &loc, const texture &tex_info, storage &info) override
+	{
+		const backend_scope scope(*this);
+		const id res = _backend->define_storage(loc, tex_info, info);
+		_read_only_variables.insert(res);
+		return res;
+	}
+	id   define_uniform(const location &loc, uniform &info) override
+	{
+		const backend_scope scope(*this);
+		const id res = _backend->define_uniform(loc, info);
+		_read_only_variables.insert(res);
+		return res;
+	}
+	id   define_variable(const location &loc, const type &type, std::string name, bool global, id initializer_value) override
+	{
+		id res;
+		if (_in_function)
+		{
+			instruction &inst = add_instruction(instruction::op_define_variable);
+			inst.loc = loc;
+			inst.res_type = type;
+			inst.name = std::move(name);
+			inst.flag = global;
+			inst.operands = { initializer_value };
+			res = inst.result = make_id();
+		}
+		else
+		{
+			const backend_scope scope(*this);
+			res = _backend->define_variable(loc, type, std::move(name), global, initializer_value);
+		}
+
+		if (type.has(reshadefx::type::q_const))
+			_read_only_variables.insert(res);
+		// Other invocations may write to shared memory at any time, so never assume the value of such variables is known
+		if (type.has(reshadefx::type::q_groupshared))
+			_shared_variables.insert(res);
+
+		return res;
+	}
+	id   define_function(const location &loc, function &info) override
+	{
+		const backend_scope scope(*this);
+		const id res = _backend->define_function(loc, info);
+
+		// Everything up until the end of the function is recorded now and only passed on to the back-end in 'leave_function'
+		_in_function = true;
+		_function_block = _backend->_current_block;
+		_function_last_block = _backend->_last_block;
+		_function_first_id = _backend->_next_id;
+
+		return res;
+	}
+
+	void define_entry_point(function &func) override
+	{
+		const backend_scope scope(*this);
+		_backend->define_entry_point(func);
+	}
+
+	id   emit_load(const expression &exp, bool force_new_id) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_load(exp, force_new_id);
+		}
+
+		std::string key;
+		std::unordered_map<std::string, id> *values = nullptr;
+
+		if (!exp.is_constant && !force_new_id)
+		{
+			// Loading a value through an access chain that does not modify it is just a copy of the value
+			if (!exp.is_lvalue && std::all_of(exp.chain.begin(), exp.chain.end(), is_identity_operation))
+				return exp.base;
+
+			if (!exp.is_lvalue)
+				values = &_values;
+			else if (_read_only_variables.find(exp.base) != _read_only_variables.end())
+				values = &_values;
+			else if (_shared_variables.find(exp.base) == _shared_variables.end())
+				values = &_memory_values;
+		}
+
+		if (values != nullptr)
+		{
+			key = make_key('L', exp);
+
+			if (const auto it = values->find(key);
+				it != values->end())
+				return it->second;
+		}
+
+		instruction &inst = add_instruction(instruction::op_load);
+		inst.is_pure = true;
+		inst.flag = force_new_id;
+		inst.chain = exp;
+		inst.result = make_id();
+
+		if (values != nullptr)
+			values->emplace(std::move(key), inst.result);
+
+		return inst.result;
+	}
+	void emit_store(const expression &exp, id value) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_store(exp, value);
+		}
+
+		instruction &inst = add_instruction(instruction::op_store);
+		inst.chain = exp;
+		inst.operands = { value };
+
+		_memory_values.clear();
+
+		// Subsequent loads through the same access chain can use the stored value directly
+		if (exp.is_lvalue && _shared_variables.find(exp.base) == _shared_variables.end())
+			_memory_values.emplace(make_key('L', exp), value);
+	}
+	id   emit_access_chain(const expression &exp, size_t &chain_index) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_access_chain(exp, chain_index);
+		}
+
+		chain_index = exp.chain.size();
+
+		instruction &inst = add_instruction(instruction::op_access_chain);
+		inst.is_pure = true;
+		inst.chain = exp;
+		inst.result = make_id();
+
+		_pointers.insert(inst.result);
+
+		return inst.result;
+	}
+
+	id   emit_constant(const type &data_type, const constant &data) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_constant(data_type, data);
+		}
+
+		instruction &inst = add_instruction(instruction::op_constant);
+		inst.is_pure = true;
+		inst.res_type = data_type;
+		inst.data = data;
+		return inst.result = make_id();
+	}
+
+	id   emit_unary_op(const location &loc, tokenid op, const type &res_type, id val) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_unary_op(loc, op, res_type, val);
+		}
+
+		std::string key(1, 'U');
+		append_key(key, static_cast<uint32_t>(op));
+		append_key(key, res_type);
+		append_key(key, val);
+
+		if (const auto it = _values.find(key);
+			it != _values.end())
+			return it->second;
+
+		instruction &inst = add_instruction(instruction::op_unary_op);
+		inst.is_pure = true;
+		inst.loc = loc;
+		inst.token = op;
+		inst.res_type = res_type;
+		inst.operands = { val };
+		inst.result = make_id();
+
+		_values.emplace(std::move(key), inst.result);
+
+		return inst.result;
+	}
+	id   emit_binary_op(const location &loc, tokenid op, const type &res_type, const type &type, id lhs, id rhs) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_binary_op(loc, op, res_type, type, lhs, rhs);
+		}
+
+		std::string key(1, 'B');
+		append_key(key, static_cast<uint32_t>(op));
+		append_key(key, res_type);
+		append_key(key, type);
+		// Operands of commutative operators can be in any order for the purpose of finding an equivalent operation
+		if (is_commutative(op) && rhs < lhs)
+		{
+			append_key(key, rhs);
+			append_key(key, lhs);
+		}
+		else
+		{
+			append_key(key, lhs);
+			append_key(key, rhs);
+		}
+
+		if (const auto it = _values.find(key);
+			it != _values.end())
+			return it->second;
+
+		instruction &inst = add_instruction(instruction::op_binary_op);
+		inst.is_pure = true;
+		inst.loc = loc;
+		inst.token = op;
+		inst.res_type = res_type;
+		inst.value_type = type;
+		inst.operands = { lhs, rhs };
+		inst.result = make_id();
+
+		_values.emplace(std::move(key), inst.result);
+
+		return inst.result;
+	}
+	id   emit_ternary_op(const location &loc, tokenid op, const type &res_type, id condition, id true_value, id false_value) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_ternary_op(loc, op, res_type, condition, true_value, false_value);
+		}
+
+		std::string key(1, 'T');
+		append_key(key, static_cast<uint32_t>(op));
+		append_key(key, res_type);
+		append_key(key, condition);
+		append_key(key, true_value);
+		append_key(key, false_value);
+
+		if (const auto it = _values.find(key);
+			it != _values.end())
+			return it->second;
+
+		instruction &inst = add_instruction(instruction::op_ternary_op);
+		inst.is_pure = true;
+		inst.loc = loc;
+		inst.token = op;
+		inst.res_type = res_type;
+		inst.operands = { condition, true_value, false_value };
+		inst.result = make_id();
+
+		_values.emplace(std::move(key), inst.result);
+
+		return inst.result;
+	}
+	id   emit_call(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_call(loc, function, res_type, args);
+		}
+
+		instruction &inst = add_instruction(instruction::op_call);
+		inst.loc = loc;
+		inst.res_type = res_type;
+		inst.operands = { function };
+		inst.args = args;
+
+		// The called function may write to any global variable or output parameter
+		_memory_values.clear();
+
+		return inst.result = make_id();
+	}
+	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::pmr::vector<expression> &args) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_call_intrinsic(loc, intrinsic, res_type, args);
+		}
+
+		// Intrinsics which return nothing (barriers, storage writes), write to output parameters or operate on memory referenced through a pointer (atomics) have side effects
+		const bool is_pure = !res_type.is_void() && std::none_of(args.begin(), args.end(),
+			[this](const expression &arg) {
+				return arg.is_lvalue || arg.type.is_storage() || _pointers.find(arg.base) != _pointers.end();
+			});
+
+		std::string key;
+		if (is_pure)
+		{
+			key = 'I';
+			append_key(key, intrinsic);
+			append_key(key, res_type);
+			for (const expression &arg : args)
+				append_key(key, arg);
+
+			if (const auto it = _values.find(key);
+				it != _values.end())
+				return it->second;
+		}
+
+		instruction &inst = add_instruction(instruction::op_call_intrinsic);
+		inst.is_pure = is_pure;
+		inst.loc = loc;
+		inst.intrinsic = intrinsic;
+		inst.res_type = res_type;
+		inst.args = args;
+		inst.result = make_id();
+
+		if (is_pure)
+			_values.emplace(std::move(key), inst.result);
+		else
+			_memory_values.clear();
+
+		return inst.result;
+	}
+	id   emit_construct(const location &loc, const type &res_type, const std::pmr::vector<expression> &args) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_construct(loc, res_type, args);
+		}
+
+		// Constructing a value from a single value of the same type is just a copy of that value
+		if (args.size() == 1 && args[0].type == res_type && !res_type.is_array())
+			return args[0].base;
+
+		std::string key(1, 'C');
+		append_key(key, res_type);
+		for (const expression &arg : args)
+			append_key(key, arg);
+
+		if (const auto it = _values.find(key);
+			it != _values.end())
+			return it->second;
+
+		instruction &inst = add_instruction(instruction::op_construct);
+		inst.is_pure = true;
+		inst.loc = loc;
+		inst.res_type = res_type;
+		inst.args = args;
+		inst.result = make_id();
+
+		_values.emplace(std::move(key), inst.result);
+
+		return inst.result;
+	}
+
+	void emit_if(const location &loc, id condition_value, id condition_block, id true_statement_block, id false_statement_block, unsigned int flags) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			_backend->emit_if(loc, condition_value, condition_block, true_statement_block, false_statement_block, flags);
+			return;
+		}
+
+		instruction &inst = add_instruction(instruction::op_if);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { condition_value, condition_block, true_statement_block, false_statement_block };
+	}
+	id   emit_phi(const location &loc, id condition_value, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &res_type) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->emit_phi(loc, condition_value, condition_block, true_value, true_statement_block, false_value, false_statement_block, res_type);
+		}
+
+		instruction &inst = add_instruction(instruction::op_phi);
+		inst.loc = loc;
+		inst.res_type = res_type;
+		inst.operands = { condition_value, condition_block, true_value, true_statement_block, false_value, false_statement_block };
+		return inst.result = make_id();
+	}
+	void emit_loop(const location &loc, id condition_value, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int flags) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			_backend->emit_loop(loc, condition_value, prev_block, header_block, condition_block, loop_block, continue_block, flags);
+			return;
+		}
+
+		instruction &inst = add_instruction(instruction::op_loop);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { condition_value, prev_block, header_block, condition_block, loop_block, continue_block };
+	}
+	void emit_switch(const location &loc, id selector_value, id selector_block, id default_label, id default_block, const std::vector<id> &case_literal_and_labels, const std::vector<id> &case_blocks, unsigned int flags) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			_backend->emit_switch(loc, selector_value, selector_block, default_label, default_block, case_literal_and_labels, case_blocks, flags);
+			return;
+		}
+
+		instruction &inst = add_instruction(instruction::op_switch);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { selector_value, selector_block, default_label, default_block };
+		inst.case_literal_and_labels = case_literal_and_labels;
+		inst.case_blocks = case_blocks;
+	}
+
+	void emit_pragma(const std::string &pragma) override
+	{
+		const backend_scope scope(*this);
+		_backend->emit_pragma(pragma);
+	}
+
+	id   create_block() override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->create_block();
+		}
+
+		instruction &inst = add_instruction(instruction::op_create_block);
+		return inst.result = make_id();
+	}
+	id   set_block(id id) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->set_block(id);
+		}
+
+		add_instruction(instruction::op_set_block).operands = { id };
+
+		return change_block(id);
+	}
+	void enter_block(id id) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			_backend->enter_block(id);
+			return;
+		}
+
+		add_instruction(instruction::op_enter_block).operands = { id };
+
+		_values.clear();
+		_memory_values.clear();
+
+		_current_block = id;
+	}
+	id   leave_block_and_kill() override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->leave_block_and_kill();
+		}
+
+		if (!is_in_block())
+			return 0;
+
+		add_instruction(instruction::op_leave_block_and_kill);
+
+		return change_block(0);
+	}
+	id   leave_block_and_return(id value) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->leave_block_and_return(value);
+		}
+
+		if (!is_in_block())
+			return 0;
+
+		add_instruction(instruction::op_leave_block_and_return).operands = { value };
+
+		return change_block(0);
+	}
+	id   leave_block_and_switch(id value, id default_target) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->leave_block_and_switch(value, default_target);
+		}
+
+		if (!is_in_block())
+			return _last_block;
+
+		add_instruction(instruction::op_leave_block_and_switch).operands = { value, default_target };
+
+		return change_block(0);
+	}
+	id   leave_block_and_branch(id target, unsigned int loop_flow) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->leave_block_and_branch(target, loop_flow);
+		}
+
+		if (!is_in_block())
+			return _last_block;
+
+		instruction &inst = add_instruction(instruction::op_leave_block_and_branch);
+		inst.flags = loop_flow;
+		inst.operands = { target };
+
+		return change_block(0);
+	}
+	id   leave_block_and_branch_conditional(id condition, id true_target, id false_target) override
+	{
+		if (!_in_function)
+		{
+			const backend_scope scope(*this);
+			return _backend->leave_block_and_branch_conditional(condition, true_target, false_target);
+		}
+
+		if (!is_in_block())
+			return _last_block;
+
+		add_instruction(instruction::op_leave_block_and_branch_conditional).operands = { condition, true_target, false_target };
+
+		return change_block(0);
+	}
+	void leave_function() override
+	{
+		assert(_in_function);
+
+		_in_function = false;
+		_values.clear();
+		_memory_values.clear();
+		_pointers.clear();
+
+		remove_dead_values();
+
+		// Rewind to the state right after the function was defined and pass on the optimized function to the back-end
+		_current_block = _function_block;
+		_last_block = _function_last_block;
+
+		const id next_id = _next_id;
+
+		const backend_scope scope(*this);
+		replay(next_id);
+		_backend->leave_function();
+
+		_instructions.clear();
+	}
+
+	void optimize_bindings() override
+	{
+		const backend_scope scope(*this);
+		_backend->optimize_bindings();
+	}
+	void optimize_uniform_layout() override
+	{
+		const backend_scope scope(*this);
+		_backend->optimize_uniform_layout();
+	}
+
+	instruction &add_instruction(instruction::op_type op)
+	{
+		instruction &inst = _instructions.emplace_back();
+		inst.op = op;
+		return inst;
+	}
+
+	id   change_block(id id)
+	{
+		// No values are reused across basic blocks, since it is not known here which blocks dominate which
+		_values.clear();
+		_memory_values.clear();
+
+		_last_block = _current_block;
+		_current_block = id;
+
+		return _last_block;
+	}
+
+	static bool is_commutative(tokenid op)
+	{
+		switch (op)
+		{
+		case tokenid::plus:
+		case tokenid::plus_plus:
+		case tokenid::plus_equal:
+		case tokenid::star:
+		case tokenid::star_equal:
+		case tokenid::caret:
+		case tokenid::caret_equal:
+		case tokenid::pipe:
+		case tokenid::pipe_equal:
+		case tokenid::ampersand:
+		case tokenid::ampersand_equal:
+		case tokenid::equal_equal:
+		case tokenid::exclaim_equal:
+			return true;
+		default:
+			return false;
+		}
+	}
+	static bool is_identity_operation(const expression::operation &op)
+	{
+		switch (op.op)
+		{
+		case expression::operation::op_cast:
+			return op.from == op.to;
+		case expression::operation::op_swizzle:
+			if (op.from != op.to || op.from.is_matrix() || op.from.is_array())
+				return false;
+			for (unsigned int i = 0; i < op.from.rows; ++i)
+				if (op.swizzle[i] != static_cast<signed char>(i))
+					return false;
+			return op.from.rows == 4 || op.swizzle[op.from.rows] < 0;
+		default:
+			return false;
+		}
+	}
+
+	static void append_key(std::string &key, uint32_t value)
+	{
+		key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+	static void append_key(std::string &key, const type &type)
+	{
+		append_key(key, static_cast<uint32_t>(type.base) | (static_cast<uint32_t>(type.rows) << 8) | (static_cast<uint32_t>(type.cols) << 12) | (static_cast<uint32_t>(type.qualifiers) << 16));
+		append_key(key, type.array_length);
+		append_key(key, type.struct_definition);
+	}
+	static void append_key(std::string &key, const expression &exp)
+	{
+		append_key(key, exp.base);
+		append_key(key, exp.type);
+		append_key(key, exp.is_lvalue ? 1u : 0u);
+
+		for (const expression::operation &op : exp.chain)
+		{
+			append_key(key, static_cast<uint32_t>(op.op));
+			append_key(key, op.from);
+			append_key(key, op.to);
+			append_key(key, op.index);
+			key.append(reinterpret_cast<const char *>(op.swizzle), sizeof(op.swizzle));
+		}
+	}
+	static std::string make_key(char prefix, const expression &exp)
+	{
+		std::string key(1, prefix);
+		append_key(key, exp);
+		return key;
+	}
+
+	template <typename F>
+	static void visit_operands(const instruction &inst, F &&visit)
+	{
+		for (const id operand : inst.operands)
+			visit(operand);
+
+		const auto visit_expression = [&visit](const expression &exp) {
+			visit(exp.base);
+			for (const expression::operation &op : exp.chain)
+				if (op.op == expression::operation::op_dynamic_index)
+					visit(op.index);
+		};
+
+		visit_expression(inst.chain);
+		for (const expression &arg : inst.args)
+			visit_expression(arg);
+
+		// Only every second element is a label, the others are literal case values
+		for (size_t i = 1; i < inst.case_literal_and_labels.size(); i += 2)
+			visit(inst.case_literal_and_labels[i]);
+		for (const id block : inst.case_blocks)
+			visit(block);
+	}
+
+	void remove_dead_values()
+	{
+		std::unordered_map<id, size_t> definitions;
+		for (size_t i = 0; i < _instructions.size(); ++i)
+			if (_instructions[i].result != 0)
+				definitions.emplace(_instructions[i].result, i);
+
+		std::vector<size_t> num_uses(_instructions.size());
+		for (const instruction &inst : _instructions)
+			visit_operands(inst, [&](id operand) {
+				if (const auto it = definitions.find(operand);
+					it != definitions.end())
+					num_uses[it->second]++;
+			});
+
+		std::vector<size_t> worklist;
+		for (size_t i = 0; i < _instructions.size(); ++i)
+			if (_instructions[i].is_pure && num_uses[i] == 0)
+				worklist.push_back(i);
+
+		// Removing an unused value may in turn make the values it used unused, so keep going until nothing changes anymore
+		while (!worklist.empty())
+		{
+			instruction &inst = _instructions[worklist.back()];
+			worklist.pop_back();
+
+			inst.is_dead = true;
+
+			visit_operands(inst, [&](id operand) {
+				if (const auto it = definitions.find(operand);
+					it != definitions.end() && --num_uses[it->second] == 0 && _instructions[it->second].is_pure)
+					worklist.push_back(it->second);
+			});
+		}
+	}
+
+	void replay(id next_id)
+	{
+		// IDs handed out while recording are replaced with the IDs the back-end returns for the same values
+		std::vector<id> replacements(next_id - _function_first_id);
+		for (size_t i = 0; i < replacements.size(); ++i)
+			replacements[i] = _function_first_id + static_cast<id>(i);
+
+		const auto replace = [&](id value) {
+			return value >= _function_first_id && value - _function_first_id < replacements.size() ? replacements[value - _function_first_id] : value;
+		};
+		const auto replace_expression = [&](const expression &exp) {
+			expression res = exp;
+			res.base = replace(res.base);
+			for (expression::operation &op : res.chain)
+				if (op.op == expression::operation::op_dynamic_index)
+					op.index = replace(op.index);
+			return res;
+		};
+		const auto replace_args = [&](const std::pmr::vector<expression> &args) {
+			std::pmr::vector<expression> res;
+			res.reserve(args.size());
+			for (const expression &arg : args)
+				res.push_back(replace_expression(arg));
+			return res;
+		};
+
+		for (instruction &inst : _instructions)
+		{
+			if (inst.is_dead)
+				continue;
+
+			std::vector<id> &operands = inst.operands;
+			for (id &operand : operands)
+				operand = replace(operand);
+
+			id res = 0;
+
+			switch (inst.op)
+			{
+			case instruction::op_create_block:
+				res = _backend->create_block();
+				break;
+			case instruction::op_set_block:
+				_backend->set_block(operands[0]);
+				break;
+			case instruction::op_enter_block:
+				_backend->enter_block(operands[0]);
+				break;
+			case instruction::op_leave_block_and_kill:
+				_backend->leave_block_and_kill();
+				break;
+			case instruction::op_leave_block_and_return:
+				_backend->leave_block_and_return(operands[0]);
+				break;
+			case instruction::op_leave_block_and_switch:
+				_backend->leave_block_and_switch(operands[0], operands[1]);
+				break;
+			case instruction::op_leave_block_and_branch:
+				_backend->leave_block_and_branch(operands[0], inst.flags);
+				break;
+			case instruction::op_leave_block_and_branch_conditional:
+				_backend->leave_block_and_branch_conditional(operands[0], operands[1], operands[2]);
+				break;
+			case instruction::op_define_variable:
+				res = _backend->define_variable(inst.loc, inst.res_type, std::move(inst.name), inst.flag, operands[0]);
+				break;
+			case instruction::op_load:
+				res = _backend->emit_load(replace_expression(inst.chain), inst.flag);
+				break;
+			case instruction::op_store:
+				_backend->emit_store(replace_expression(inst.chain), operands[0]);
+				break;
+			case instruction::op_access_chain:
+			{
+				size_t chain_index = 0;
+				res = _backend->emit_access_chain(replace_expression(inst.chain), chain_index);
+				break;
+			}
+			case instruction::op_constant:
+				res = _backend->emit_constant(inst.res_type, inst.data);
+				break;
+			case instruction::op_unary_op:
+				res = _backend->emit_unary_op(inst.loc, inst.token, inst.res_type, operands[0]);
+				break;
+			case instruction::op_binary_op:
+				res = _backend->emit_binary_op(inst.loc, inst.token, inst.res_type, inst.value_type, operands[0], operands[1]);
+				break;
+			case instruction::op_ternary_op:
+				res = _backend->emit_ternary_op(inst.loc, inst.token, inst.res_type, operands[0], operands[1], operands[2]);
+				break;
+			case instruction::op_call:
+				res = _backend->emit_call(inst.loc, operands[0], inst.res_type, replace_args(inst.args));
+				break;
+			case instruction::op_call_intrinsic:
+				res = _backend->emit_call_intrinsic(inst.loc, inst.intrinsic, inst.res_type, replace_args(inst.args));
+				break;
+			case instruction::op_construct:
+				res = _backend->emit_construct(inst.loc, inst.res_type, replace_args(inst.args));
+				break;
+			case instruction::op_if:
+				_backend->emit_if(inst.loc, operands[0], operands[1], operands[2], operands[3], inst.flags);
+				break;
+			case instruction::op_phi:
+				res = _backend->emit_phi(inst.loc, operands[0], operands[1], operands[2], operands[3], operands[4], operands[5], inst.res_type);
+				break;
+			case instruction::op_loop:
+				_backend->emit_loop(inst.loc, operands[0], operands[1], operands[2], operands[3], operands[4], operands[5], inst.flags);
+				break;
+			case instruction::op_switch:
+				for (size_t i = 1; i < inst.case_literal_and_labels.size(); i += 2)
+					inst.case_literal_and_labels[i] = replace(inst.case_literal_and_labels[i]);
+				for (id &block : inst.case_blocks)
+					block = replace(block);
+				_backend->emit_switch(inst.loc, operands[0], operands[1], operands[2], operands[3], inst.case_literal_and_labels, inst.case_blocks, inst.flags);
+				break;
+			}
+
+			if (inst.result != 0)
+			{
+				assert(inst.result >= _function_first_id);
+				replacements[inst.result - _function_first_id] = res;
+			}
+		}
+	}
+
+	codegen *const _backend;
+
+	std::vector<instruction> _instructions;
+	bool _in_function = false;
+	id _function_block = 0;
+	id _function_last_block = 0;
+	id _function_first_id = 0;
+
+	// Values computed in the current basic block, indexed by the operation that computed them
+	std::unordered_map<std::string, id> _values;
+	// Values loaded from or stored to variables in the current basic block, which are forgotten whenever memory may be written
+	std::unordered_map<std::string, id> _memory_values;
+
+	// Access chains passed to intrinsics by reference instead of by value
+	std::unordered_set<id> _pointers;
+	std::unordered_set<id> _read_only_variables;
+	std::unordered_set<id> _shared_variables;
+};
+
+codegen *reshadefx::create_codegen_optimizer(codegen *backend)
+{
+	return new codegen_optimizer(backend);
+}
@@ -6,9 +6,12 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include <cassert>
-#include <cstring> // std::memcmp
+#include <cstring> // std::memcpy, std::strlen
+#include <array>
 #include <charconv> // std::from_chars
-#include <algorithm> // std::find_if, std::max, std::sort
+#include <limits> // std::numeric_limits
+#include <algorithm> // std::copy, std::fill, std::find, std::find_if, std::lower_bound, std::max, std::min, std::sort
+#include <string_view>
 #include <unordered_set>
 
 // Use the C++ variant of the SPIR-V headers
@@ -25,45 +28,33 @@ inline uint32_t align_up(uint32_t size, uint32_t alignment)
 	return ((size + alignment) & ~alignment);
 }
 
+struct spirv_basic_block;
+
 /// <summary>
-/// A single instruction in a SPIR-V module
+/// A single instruction in a SPIR-V module, which references the words it is encoded to in a basic block
 /// </summary>
 struct spirv_instruction
 {
-	spv::Op op;
-	spv::Id type;
+	spirv_basic_block *block;
+	size_t offset;
 	spv::Id result;
-	std::vector<spv::Id> operands;
-
-	explicit spirv_instruction(spv::Op op = spv::OpNop) : op(op), type(0), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id result) : op(op), type(result), result(0) {}
-	spirv_instruction(spv::Op op, spv::Id type, spv::Id result) : op(op), type(type), result(result) {}
 
 	/// <summary>
 	/// Add a single operand to the instruction.
 	/// </summary>
-	spirv_instruction &add(spv::Id operand)
-	{
-		operands.push_back(operand);
-		return *this;
-	}
+	spirv_instruction &add(spv::Id operand);
 
 	/// <summary>
 	/// Add a range of operands to the instruction.
 	/// </summary>
 	template <typename It>
-	spirv_instruction &add(It begin, It end)
-	{
-		operands.insert(operands.end(), begin, end);
-		return *this;
-	}
+	spirv_instruction &add(It begin, It end);
 
 	/// <summary>
 	/// Add a null-terminated literal UTF-8 string to the instruction.
 	/// </summary>
 	spirv_instruction &add_string(const char *string)
 	{
-		assert(std::strlen(string) <= (0xFFFF - (1 + operands.size())) * 4 - 1);
 		uint32_t word;
 		do {
 			word = 0;
@@ -75,64 +66,839 @@ struct spirv_instruction
 	}
 
 	/// <summary>
-	/// Write this instruction to a SPIR-V module.
+	/// Set the result type of an instruction that was added with a placeholder for it.
 	/// </summary>
-	/// <param name="output">The output stream to append this instruction to.</param>
-	void write(std::basic_string<char> &output) const
+	void set_type(spv::Id type);
+
+	operator uint32_t() const
 	{
-		// See https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html
-		// 0             | Opcode: The 16 high-order bits are the WordCount of the instruction. The 16 low-order bits are the opcode enumerant.
-		// 1             | Optional instruction type <id>
-		// .             | Optional instruction Result <id>
-		// .             | Operand 1 (if needed)
-		// .             | Operand 2 (if needed)
-		// ...           | ...
-		// WordCount - 1 | Operand N (N is determined by WordCount minus the 1 to 3 words used for the opcode, instruction type <id>, and instruction Result <id>).
+		assert(result != 0);
 
-		const uint32_t word_count = 1 + (type != 0) + (result != 0) + static_cast<uint32_t>(operands.size());
-		assert(word_count <= 0xFFFF);
-		write_word(output, (word_count << spv::WordCountShift) | op);
+		return result;
+	}
+};
+
+/// <summary>
+/// A list of instructions forming a basic block in the SPIR-V module, stored in their binary encoding
+/// </summary>
+struct spirv_basic_block
+{
+	// See https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html
+	// 0             | Opcode: The 16 high-order bits are the WordCount of the instruction. The 16 low-order bits are the opcode enumerant.
+	// 1             | Optional instruction type <id>
+	// .             | Optional instruction Result <id>
+	// .             | Operand 1 (if needed)
+	// .             | Operand 2 (if needed)
+	// ...           | ...
+	// WordCount - 1 | Operand N (N is determined by WordCount minus the 1 to 3 words used for the opcode, instruction type <id>, and instruction Result <id>).
+	std::vector<uint32_t> words;
 
-		// Optional instruction type ID
-		if (type != 0)
-			write_word(output, type);
+	/// <summary>
+	/// Iterator over the instructions in a basic block, which dereferences to a pointer to the first word of the instruction.
+	/// </summary>
+	struct const_iterator
+	{
+		const uint32_t *inst;
 
-		// Optional instruction result ID
+		const uint32_t *operator*() const { return inst; }
+		const_iterator &operator++() { inst += inst[0] >> spv::WordCountShift; return *this; }
+		bool operator!=(const const_iterator &other) const { return inst != other.inst; }
+	};
+
+	const_iterator begin() const { return { words.data() }; }
+	const_iterator end() const { return { words.data() + words.size() }; }
+
+	bool empty() const { return words.empty(); }
+
+	/// <summary>
+	/// Append a new instruction to the end of this block.
+	/// </summary>
+	/// <param name="op">Opcode of the instruction.</param>
+	/// <param name="type">Optional result type of the instruction.</param>
+	/// <param name="result">Optional result id of the instruction.</param>
+	/// <param name="has_type">Whether to reserve a word for the result type even if it is not known yet (see <see cref="spirv_instruction::set_type"/>).</param>
+	spirv_instruction add_instruction(spv::Op op, spv::Id type = 0, spv::Id result = 0, bool has_type = false)
+	{
+		const size_t offset = words.size();
+
+		words.push_back(op);
+		if (type != 0 || has_type)
+			words.push_back(type);
 		if (result != 0)
-			write_word(output, result);
+			words.push_back(result);
+
+		words[offset] |= static_cast<uint32_t>(words.size() - offset) << spv::WordCountShift;
 
-		// Write out the operands
-		for (const uint32_t operand : operands)
-			write_word(output, operand);
+		return { this, offset, result };
 	}
 
-	static void write_word(std::basic_string<char> &output, uint32_t word)
+	/// <summary>
+	/// Append another basic block the end of this one.
+	/// </summary>
+	void append(const spirv_basic_block &block)
 	{
-		output.insert(output.end(), reinterpret_cast<const char *>(&word), reinterpret_cast<const char *>(&word + 1));
+		words.insert(words.end(), block.words.begin(), block.words.end());
+	}
+	/// <summary>
+	/// Append a copy of a single instruction to the end of this block.
+	/// </summary>
+	void append(const uint32_t *inst)
+	{
+		words.insert(words.end(), inst, inst + (inst[0] >> spv::WordCountShift));
 	}
 
-	operator uint32_t() const
+	/// <summary>
+	/// Remove the last instruction from this block and return its words. It has to consist of exactly <typeparamref name="word_count"/> words.
+	/// </summary>
+	template <size_t word_count>
+	std::array<uint32_t, word_count> pop_back()
 	{
-		assert(result != 0);
+		assert(words.size() >= word_count && (words[words.size() - word_count] >> spv::WordCountShift) == word_count);
 
-		return result;
+		std::array<uint32_t, word_count> inst;
+		std::copy(words.end() - word_count, words.end(), inst.begin());
+		words.resize(words.size() - word_count);
+		return inst;
+	}
+	/// <summary>
+	/// Append the words of a single instruction to the end of this block.
+	/// </summary>
+	template <size_t word_count>
+	void push_back(const std::array<uint32_t, word_count> &inst)
+	{
+		words.insert(words.end(), inst.begin(), inst.end());
+	}
+
+	/// <summary>
+	/// Write all instructions in this block to a SPIR-V module.
+	/// </summary>
+	/// <param name="output">The output stream to append the instructions to.</param>
+	void write(std::basic_string<char> &output) const
+	{
+		write(output, words.data(), words.size());
+	}
+	static void write(std::basic_string<char> &output, const uint32_t *words, size_t word_count)
+	{
+		output.append(reinterpret_cast<const char *>(words), word_count * sizeof(uint32_t));
 	}
 };
 
+inline spirv_instruction &spirv_instruction::add(spv::Id operand)
+{
+	return add(&operand, &operand + 1);
+}
+template <typename It>
+inline spirv_instruction &spirv_instruction::add(It begin, It end)
+{
+	// Operands can only be added to the last instruction in a block
+	assert(offset + (block->words[offset] >> spv::WordCountShift) == block->words.size());
+
+	block->words.insert(block->words.end(), begin, end);
+
+	const size_t word_count = block->words.size() - offset;
+	assert(word_count <= 0xFFFF);
+	block->words[offset] = static_cast<uint32_t>(word_count << spv::WordCountShift) | (block->words[offset] & spv::OpCodeMask);
+
+	return *this;
+}
+inline void spirv_instruction::set_type(spv::Id type)
+{
+	assert(type != 0 && (block->words[offset] >> spv::WordCountShift) >= 2);
+
+	block->words[offset + 1] = type;
+}
+
 /// <summary>
-/// A list of instructions forming a basic block in the SPIR-V module
+/// Call the specified function for every word of an instruction that references an id (including the result type, but not the result id itself).
 /// </summary>
-struct spirv_basic_block
+/// <returns><see langword="true"/> if the operands of the instruction are known, <see langword="false"/> otherwise.</returns>
+template <typename T, typename F>
+static bool visit_id_operands(T *inst, F &&visit)
 {
-	std::vector<spirv_instruction> instructions;
+	const uint32_t word_count = inst[0] >> spv::WordCountShift;
+	const auto visit_range = [inst, word_count, &visit](uint32_t first, uint32_t last = 0xFFFF) {
+		for (last = std::min(last, word_count); first < last; ++first)
+			visit(inst[first]);
+	};
+
+	switch (inst[0] & spv::OpCodeMask)
+	{
+	case spv::OpNop:
+	case spv::OpCapability:
+	case spv::OpExtInstImport:
+	case spv::OpMemoryModel:
+	case spv::OpSource:
+	case spv::OpSourceContinued:
+	case spv::OpString:
+	case spv::OpTypeVoid:
+	case spv::OpTypeBool:
+	case spv::OpTypeInt:
+	case spv::OpTypeFloat:
+	case spv::OpLabel:
+	case spv::OpReturn:
+	case spv::OpKill:
+	case spv::OpFunctionEnd:
+		break;
+	case spv::OpEntryPoint:
+		visit_range(2, 3);
+		visit_range(3 + static_cast<uint32_t>((std::strlen(reinterpret_cast<const char *>(&inst[3])) + 4) / 4)); // Interface variables following the name
+		break;
+	case spv::OpExecutionMode:
+	case spv::OpName:
+	case spv::OpMemberName:
+	case spv::OpDecorate:
+	case spv::OpMemberDecorate:
+	case spv::OpLine:
+	case spv::OpBranch:
+	case spv::OpReturnValue:
+	case spv::OpSelectionMerge:
+		visit_range(1, 2);
+		break;
+	case spv::OpLoopMerge:
+		visit_range(1, 3);
+		break;
+	case spv::OpBranchConditional:
+		visit_range(1, 4);
+		break;
+	case spv::OpSwitch:
+		visit_range(1, 3);
+		for (uint32_t i = 4; i < word_count; i += 2) // Pairs of literal and target label
+			visit(inst[i]);
+		break;
+	case spv::OpTypeVector:
+	case spv::OpTypeMatrix:
+	case spv::OpTypeImage:
+	case spv::OpTypeSampledImage:
+		visit_range(2, 3);
+		break;
+	case spv::OpTypeArray:
+	case spv::OpTypeStruct:
+	case spv::OpTypeFunction:
+		visit_range(2);
+		break;
+	case spv::OpTypePointer:
+		visit_range(3);
+		break;
+	case spv::OpConstantTrue:
+	case spv::OpConstantFalse:
+	case spv::OpConstant:
+	case spv::OpConstantNull:
+	case spv::OpSpecConstantTrue:
+	case spv::OpSpecConstantFalse:
+	case spv::OpSpecConstant:
+	case spv::OpUndef:
+	case spv::OpFunctionParameter:
+		visit_range(1, 2);
+		break;
+	case spv::OpVariable:
+	case spv::OpFunction:
+		visit_range(1, 2);
+		visit_range(4); // Initializer or function type
+		break;
+	case spv::OpStore:
+		visit_range(1, 3);
+		break;
+	case spv::OpLoad:
+	case spv::OpCompositeExtract:
+		visit_range(1, 2);
+		visit_range(3, 4);
+		break;
+	case spv::OpCompositeInsert:
+	case spv::OpVectorShuffle:
+		visit_range(1, 2);
+		visit_range(3, 5);
+		break;
+	case spv::OpExtInst:
+		visit_range(1, 2);
+		visit_range(3, 4);
+		visit_range(5); // Skip instruction number
+		break;
+	case spv::OpImageSampleImplicitLod:
+	case spv::OpImageSampleExplicitLod:
+	case spv::OpImageFetch:
+	case spv::OpImageRead:
+		visit_range(1, 2);
+		visit_range(3, 5);
+		visit_range(6); // Skip image operands mask
+		break;
+	case spv::OpImageGather:
+		visit_range(1, 2);
+		visit_range(3, 6);
+		visit_range(7);
+		break;
+	case spv::OpImageWrite:
+		visit_range(1, 4);
+		visit_range(5);
+		break;
+	case spv::OpControlBarrier:
+	case spv::OpMemoryBarrier:
+		visit_range(1);
+		break;
+	case spv::OpConstantComposite:
+	case spv::OpSpecConstantComposite:
+	case spv::OpFunctionCall:
+	case spv::OpPhi:
+	case spv::OpAccessChain:
+	case spv::OpImage:
+	case spv::OpImageTexelPointer:
+	case spv::OpImageQuerySize:
+	case spv::OpImageQuerySizeLod:
+	case spv::OpAtomicExchange:
+	case spv::OpAtomicCompareExchange:
+	case spv::OpAtomicIAdd:
+	case spv::OpAtomicSMin:
+	case spv::OpAtomicUMin:
+	case spv::OpAtomicSMax:
+	case spv::OpAtomicUMax:
+	case spv::OpAtomicAnd:
+	case spv::OpAtomicOr:
+	case spv::OpAtomicXor:
+	case spv::OpSelect:
+	case spv::OpVectorExtractDynamic:
+	case spv::OpCompositeConstruct:
+	case spv::OpTranspose:
+	case spv::OpConvertFToU:
+	case spv::OpConvertFToS:
+	case spv::OpConvertSToF:
+	case spv::OpConvertUToF:
+	case spv::OpUConvert:
+	case spv::OpSConvert:
+	case spv::OpFConvert:
+	case spv::OpBitcast:
+	case spv::OpSNegate:
+	case spv::OpFNegate:
+	case spv::OpIAdd:
+	case spv::OpFAdd:
+	case spv::OpISub:
+	case spv::OpFSub:
+	case spv::OpIMul:
+	case spv::OpFMul:
+	case spv::OpUDiv:
+	case spv::OpSDiv:
+	case spv::OpFDiv:
+	case spv::OpUMod:
+	case spv::OpSRem:
+	case spv::OpFRem:
+	case spv::OpVectorTimesScalar:
+	case spv::OpMatrixTimesScalar:
+	case spv::OpVectorTimesMatrix:
+	case spv::OpMatrixTimesVector:
+	case spv::OpMatrixTimesMatrix:
+	case spv::OpDot:
+	case spv::OpAny:
+	case spv::OpAll:
+	case spv::OpIsNan:
+	case spv::OpIsInf:
+	case spv::OpLogicalEqual:
+	case spv::OpLogicalNotEqual:
+	case spv::OpLogicalOr:
+	case spv::OpLogicalAnd:
+	case spv::OpLogicalNot:
+	case spv::OpIEqual:
+	case spv::OpINotEqual:
+	case spv::OpUGreaterThan:
+	case spv::OpSGreaterThan:
+	case spv::OpUGreaterThanEqual:
+	case spv::OpSGreaterThanEqual:
+	case spv::OpULessThan:
+	case spv::OpSLessThan:
+	case spv::OpULessThanEqual:
+	case spv::OpSLessThanEqual:
+	case spv::OpFOrdEqual:
+	case spv::OpFOrdNotEqual:
+	case spv::OpFOrdLessThan:
+	case spv::OpFOrdGreaterThan:
+	case spv::OpFOrdLessThanEqual:
+	case spv::OpFOrdGreaterThanEqual:
+	case spv::OpShiftRightLogical:
+	case spv::OpShiftRightArithmetic:
+	case spv::OpShiftLeftLogical:
+	case spv::OpBitwiseOr:
+	case spv::OpBitwiseXor:
+	case spv::OpBitwiseAnd:
+	case spv::OpNot:
+	case spv::OpBitReverse:
+	case spv::OpBitCount:
+	case spv::OpDPdx:
+	case spv::OpDPdy:
+	case spv::OpFwidth:
+	case spv::OpDPdxFine:
+	case spv::OpDPdyFine:
+	case spv::OpDPdxCoarse:
+	case spv::OpDPdyCoarse:
+		visit_range(1, 2);
+		visit_range(3);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Get the result id of an instruction that is known to <see cref="visit_id_operands"/>, or zero if it does not have one.
+/// </summary>
+static spv::Id get_result_id(const uint32_t *inst)
+{
+	switch (inst[0] & spv::OpCodeMask)
+	{
+	case spv::OpExtInstImport:
+	case spv::OpString:
+	case spv::OpTypeVoid:
+	case spv::OpTypeBool:
+	case spv::OpTypeInt:
+	case spv::OpTypeFloat:
+	case spv::OpTypeVector:
+	case spv::OpTypeMatrix:
+	case spv::OpTypeImage:
+	case spv::OpTypeSampledImage:
+	case spv::OpTypeArray:
+	case spv::OpTypeStruct:
+	case spv::OpTypePointer:
+	case spv::OpTypeFunction:
+	case spv::OpLabel:
+		return inst[1];
+	case spv::OpNop:
+	case spv::OpCapability:
+	case spv::OpMemoryModel:
+	case spv::OpEntryPoint:
+	case spv::OpExecutionMode:
+	case spv::OpSource:
+	case spv::OpSourceContinued:
+	case spv::OpName:
+	case spv::OpMemberName:
+	case spv::OpLine:
+	case spv::OpDecorate:
+	case spv::OpMemberDecorate:
+	case spv::OpStore:
+	case spv::OpImageWrite:
+	case spv::OpControlBarrier:
+	case spv::OpMemoryBarrier:
+	case spv::OpSelectionMerge:
+	case spv::OpLoopMerge:
+	case spv::OpBranch:
+	case spv::OpBranchConditional:
+	case spv::OpSwitch:
+	case spv::OpReturn:
+	case spv::OpReturnValue:
+	case spv::OpKill:
+	case spv::OpFunctionEnd:
+		return 0;
+	default:
+		return inst[2];
+	}
+}
+
+/// <summary>
+/// Optimization passes operating on a complete SPIR-V module in its binary encoding, which remove code that drivers would otherwise have to remove during pipeline creation.
+/// </summary>
+class spirv_module_optimizer
+{
+public:
+	explicit spirv_module_optimizer(std::vector<uint32_t> &words) : _words(words) {}
 
 	/// <summary>
-	/// Append another basic block the end of this one.
+	/// Split the module into its instructions.
 	/// </summary>
-	void append(const spirv_basic_block &block)
+	/// <returns><see langword="true"/> if the module can be optimized, <see langword="false"/> if it contains instructions the passes do not know about.</returns>
+	bool parse()
+	{
+		if (_words.size() < 5 || _words[0] != spv::MagicNumber)
+			return false;
+
+		// Skip module header
+		for (size_t offset = 5, word_count; offset < _words.size(); offset += word_count)
+		{
+			word_count = _words[offset] >> spv::WordCountShift;
+			if (word_count == 0 || offset + word_count > _words.size() || !visit_id_operands(&_words[offset], [](uint32_t) {}))
+				return false;
+
+			// The function declaration may be preceded by a line instruction, which then belongs to the function
+			if ((_words[offset] & spv::OpCodeMask) == spv::OpFunction)
+				_functions.push_back({ _offsets.size() - (!_offsets.empty() && op(_offsets.size() - 1) == spv::OpLine ? 1 : 0), _offsets.size(), 0 });
+			else if ((_words[offset] & spv::OpCodeMask) == spv::OpFunctionEnd && !_functions.empty())
+				_functions.back().end = _offsets.size();
+
+			_offsets.push_back(offset);
+		}
+
+		_dead.assign(_offsets.size(), false);
+
+		return true;
+	}
+
+	/// <summary>
+	/// Check that ids are defined exactly once and within the id bound, that all referenced ids are defined and that functions consist of terminated blocks.
+	/// </summary>
+	/// <param name="errors">Receives a description of the first problem found.</param>
+	bool validate(std::string &errors) const
+	{
+		const uint32_t bound = _words[3];
+
+		std::vector<bool> defined(bound, false);
+		for (size_t i = 0; i < _offsets.size(); ++i)
+		{
+			const spv::Id result = get_result_id(inst(i));
+			if (result == 0)
+				continue;
+
+			if (result >= bound)
+				return errors = "id " + std::to_string(result) + " exceeds id bound " + std::to_string(bound), false;
+			if (defined[result])
+				return errors = "id " + std::to_string(result) + " is defined more than once", false;
+			defined[result] = true;
+		}
+
+		spv::Id undefined = 0;
+		bool in_function = false, in_block = false;
+
+		for (size_t i = 0; i < _offsets.size(); ++i)
+		{
+			visit_id_operands(inst(i), [bound, &defined, &undefined](uint32_t operand) {
+				if (undefined == 0 && (operand >= bound || !defined[operand]))
+					undefined = operand;
+			});
+			if (undefined != 0)
+				return errors = "instruction " + std::to_string(i) + " references undefined id " + std::to_string(undefined), false;
+
+			switch (op(i))
+			{
+			case spv::OpFunction:
+				if (in_function)
+					return errors = "function " + std::to_string(inst(i)[2]) + " is declared inside another function", false;
+				in_function = true;
+				break;
+			case spv::OpFunctionEnd:
+				if (!in_function || in_block)
+					return errors = "function ended without terminating its last block", false;
+				in_function = false;
+				break;
+			case spv::OpLabel:
+				if (!in_function || in_block)
+					return errors = "block " + std::to_string(inst(i)[1]) + " started before the previous block was terminated", false;
+				in_block = true;
+				break;
+			case spv::OpBranch:
+			case spv::OpBranchConditional:
+			case spv::OpSwitch:
+			case spv::OpKill:
+			case spv::OpReturn:
+			case spv::OpReturnValue:
+				if (!in_block)
+					return errors = "instruction " + std::to_string(i) + " terminates a block outside of one", false;
+				in_block = false;
+				break;
+			default:
+				break;
+			}
+		}
+
+		if (in_function)
+			return errors = "module ends inside a function", false;
+
+		return true;
+	}
+
+	/// <summary>
+	/// Merge blocks into their only predecessor if that ends in an unconditional branch to them.
+	/// </summary>
+	void merge_trivial_blocks()
+	{
+		for (const function_range &function : _functions)
+		{
+			if (_dead[function.declaration])
+				continue;
+
+			std::unordered_map<spv::Id, uint32_t> label_references;
+			for (size_t i = function.begin; i < function.end; ++i)
+				if (op(i) == spv::OpLabel)
+					label_references[inst(i)[1]] = 0;
+
+			for (size_t i = function.begin; i < function.end; ++i)
+				visit_id_operands(inst(i), [&label_references](uint32_t operand) {
+					if (const auto it = label_references.find(operand);
+						it != label_references.end())
+						it->second++;
+				});
+
+			for (size_t i = function.begin + 1; i + 2 < function.end; ++i)
+			{
+				// Only consider blocks that directly follow their predecessor, so that the block order still satisfies dominance
+				if (op(i) != spv::OpBranch || op(i + 1) != spv::OpLabel || inst(i)[1] != inst(i + 1)[1] || label_references[inst(i)[1]] != 1)
+					continue;
+				// Merge instructions have to stay directly in front of the branch that ends their header block, and phi instructions at the start of a block
+				if (op(i - 1) == spv::OpSelectionMerge || op(i - 1) == spv::OpLoopMerge || op(i + 2) == spv::OpPhi)
+					continue;
+
+				_dead[i] = _dead[i + 1] = true;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Replace loads from function variables that were stored to or loaded from earlier in the same block with the known value, and remove variables that are never loaded from.
+	/// </summary>
+	void forward_local_loads_and_stores()
 	{
-		instructions.insert(instructions.end(), block.instructions.begin(), block.instructions.end());
+		for (const function_range &function : _functions)
+		{
+			if (_dead[function.declaration])
+				continue;
+
+			// Find variables which are only accessed through loads and stores of their entire value
+			std::unordered_map<spv::Id, bool> local_variables;
+			for (size_t i = function.begin; i < function.end; ++i)
+				if (op(i) == spv::OpVariable && inst(i)[3] == spv::StorageClassFunction)
+					local_variables[inst(i)[2]] = true;
+
+			if (local_variables.empty())
+				continue;
+
+			for (size_t i = function.begin; i < function.end; ++i)
+			{
+				uint32_t *const words = inst(i);
+				const uint32_t word_count = words[0] >> spv::WordCountShift;
+
+				visit_id_operands(words, [&](uint32_t &operand) {
+					const auto it = local_variables.find(operand);
+					if (it == local_variables.end())
+						return;
+
+					const ptrdiff_t index = &operand - words;
+					if (!((op(i) == spv::OpLoad && index == 3 && word_count == 4) || (op(i) == spv::OpStore && index == 1 && word_count == 3)))
+						it->second = false;
+				});
+			}
+
+			const auto is_candidate = [&local_variables](spv::Id variable) {
+				const auto it = local_variables.find(variable);
+				return it != local_variables.end() && it->second;
+			};
+
+			std::unordered_map<spv::Id, spv::Id> replacements;
+			std::unordered_map<spv::Id, spv::Id> current_values;
+			const auto replace_operands = [this, &replacements](size_t i) {
+				visit_id_operands(inst(i), [&replacements](uint32_t &operand) {
+					if (const auto it = replacements.find(operand);
+						it != replacements.end())
+						operand = it->second;
+				});
+			};
+
+			for (size_t i = function.begin; i < function.end; ++i)
+			{
+				if (_dead[i])
+					continue;
+
+				// Values of all previous instructions are final, since definitions always come before their uses (except for phi instructions)
+				if (!replacements.empty())
+					replace_operands(i);
+
+				const uint32_t *const words = inst(i);
+
+				switch (op(i))
+				{
+				case spv::OpLabel:
+					current_values.clear();
+					break;
+				case spv::OpVariable:
+					if ((words[0] >> spv::WordCountShift) == 5 && is_candidate(words[2]))
+						current_values[words[2]] = words[4]; // Initializer
+					break;
+				case spv::OpStore:
+					if (is_candidate(words[1]))
+						current_values[words[1]] = words[2];
+					break;
+				case spv::OpLoad:
+					if (!is_candidate(words[3]))
+						break;
+					if (const auto it = current_values.find(words[3]);
+						it != current_values.end())
+					{
+						replacements[words[2]] = it->second;
+						_dead[i] = true;
+					}
+					else
+					{
+						current_values[words[3]] = words[2];
+					}
+					break;
+				default:
+					break;
+				}
+			}
+
+			// Phi instructions may reference values from blocks that come after them
+			if (!replacements.empty())
+				for (size_t i = function.begin; i < function.end; ++i)
+					if (!_dead[i] && op(i) == spv::OpPhi)
+						replace_operands(i);
+
+			// Remove variables that are never loaded from anymore, together with all stores to them
+			std::unordered_set<spv::Id> loaded_variables;
+			for (size_t i = function.begin; i < function.end; ++i)
+				if (!_dead[i] && op(i) == spv::OpLoad)
+					loaded_variables.insert(inst(i)[3]);
+
+			for (size_t i = function.begin; i < function.end; ++i)
+			{
+				if (_dead[i])
+					continue;
+
+				if ((op(i) == spv::OpVariable && is_candidate(inst(i)[2]) && loaded_variables.find(inst(i)[2]) == loaded_variables.end()) ||
+					(op(i) == spv::OpStore && is_candidate(inst(i)[1]) && loaded_variables.find(inst(i)[1]) == loaded_variables.end()))
+					_dead[i] = true;
+			}
+		}
 	}
+
+	/// <summary>
+	/// Remove all functions, types, constants and global variables that are not referenced from the entry points.
+	/// </summary>
+	void remove_unused_functions_and_globals()
+	{
+		const uint32_t bound = _words[3];
+		const size_t first_function = _functions.empty() ? _offsets.size() : _functions.front().begin;
+
+		std::vector<size_t> definitions(bound, std::numeric_limits<size_t>::max());
+		for (size_t i = 0; i < _offsets.size(); ++i)
+			if (const spv::Id result = get_result_id(inst(i)); result < bound)
+				definitions[result] = i;
+
+		std::vector<bool> live(bound, false);
+		std::vector<spv::Id> worklist;
+		const auto mark_live = [bound, &live, &worklist](uint32_t operand) {
+			if (operand < bound && !live[operand])
+			{
+				live[operand] = true;
+				worklist.push_back(operand);
+			}
+		};
+
+		// Everything outside of functions that is not a debug name, an annotation or a removable declaration is referenced unconditionally
+		for (size_t i = 0; i < first_function; ++i)
+			if (!is_name_or_decoration(op(i)) && !is_removable_declaration(op(i)))
+				visit_id_operands(inst(i), mark_live);
+
+		while (!worklist.empty())
+		{
+			const spv::Id id = worklist.back();
+			worklist.pop_back();
+
+			const size_t i = definitions[id];
+			if (i == std::numeric_limits<size_t>::max())
+				continue;
+
+			if (i >= first_function)
+			{
+				// Referencing a function makes everything its body references live as well
+				if (op(i) == spv::OpFunction)
+				{
+					const auto function = std::lower_bound(_functions.begin(), _functions.end(), i,
+						[](const function_range &range, size_t declaration) { return range.declaration < declaration; });
+					assert(function != _functions.end() && function->declaration == i);
+
+					for (size_t k = function->begin; k <= function->end; ++k)
+						if (!_dead[k])
+							visit_id_operands(inst(k), mark_live);
+				}
+			}
+			else
+			{
+				visit_id_operands(inst(i), mark_live);
+			}
+		}
+
+		for (size_t i = 0; i < first_function; ++i)
+			if (is_removable_declaration(op(i)) && !live[get_result_id(inst(i))])
+				_dead[i] = true;
+
+		for (const function_range &function : _functions)
+			if (!live[inst(function.declaration)[2]])
+				std::fill(_dead.begin() + function.begin, _dead.begin() + function.end + 1, true);
+	}
+
+	/// <summary>
+	/// Remove all instructions that were marked as dead from the module, together with any names and decorations of the ids they defined.
+	/// </summary>
+	void compact()
+	{
+		const uint32_t bound = _words[3];
+
+		std::vector<bool> defined(bound, false);
+		for (size_t i = 0; i < _offsets.size(); ++i)
+			if (const spv::Id result = get_result_id(inst(i)); !_dead[i] && result < bound)
+				defined[result] = true;
+
+		size_t write_offset = 5;
+		for (size_t i = 0; i < _offsets.size(); ++i)
+		{
+			if (_dead[i] || (is_name_or_decoration(op(i)) && (inst(i)[1] >= bound || !defined[inst(i)[1]])))
+				continue;
+
+			const uint32_t word_count = inst(i)[0] >> spv::WordCountShift;
+			std::copy(inst(i), inst(i) + word_count, _words.data() + write_offset);
+			write_offset += word_count;
+		}
+
+		_words.resize(write_offset);
+	}
+
+private:
+	struct function_range
+	{
+		size_t begin; // Index of the first instruction belonging to the function
+		size_t declaration; // Index of the 'OpFunction' instruction
+		size_t end; // Index of the 'OpFunctionEnd' instruction
+	};
+
+	static bool is_name_or_decoration(spv::Op op)
+	{
+		return op == spv::OpName || op == spv::OpMemberName || op == spv::OpDecorate || op == spv::OpMemberDecorate;
+	}
+	static bool is_removable_declaration(spv::Op op)
+	{
+		switch (op)
+		{
+		case spv::OpString:
+		case spv::OpTypeVoid:
+		case spv::OpTypeBool:
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:
+		case spv::OpTypeVector:
+		case spv::OpTypeMatrix:
+		case spv::OpTypeImage:
+		case spv::OpTypeSampledImage:
+		case spv::OpTypeArray:
+		case spv::OpTypeStruct:
+		case spv::OpTypePointer:
+		case spv::OpTypeFunction:
+		case spv::OpConstantTrue:
+		case spv::OpConstantFalse:
+		case spv::OpConstant:
+		case spv::OpConstantComposite:
+		case spv::OpConstantNull:
+		case spv::OpSpecConstantTrue:
+		case spv::OpSpecConstantFalse:
+		case spv::OpSpecConstant:
+		case spv::OpSpecConstantComposite:
+		case spv::OpVariable:
+		case spv::OpUndef:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	uint32_t *inst(size_t index) { return _words.data() + _offsets[index]; }
+	const uint32_t *inst(size_t index) const { return _words.data() + _offsets[index]; }
+	spv::Op op(size_t index) const { return static_cast<spv::Op>(_words[_offsets[index]] & spv::OpCodeMask); }
+
+	std::vector<uint32_t> &_words;
+	std::vector<size_t> _offsets;
+	std::vector<bool> _dead;
+	std::vector<function_range> _functions;
 };
 
 class codegen_spirv final : public codegen
@@ -140,12 +906,14 @@ class codegen_spirv final : public codegen
 	static_assert(sizeof(id) == sizeof(spv::Id), "unexpected SPIR-V id type size");
 
 public:
-	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y) :
+	codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, int optimization_level, bool pack_uniforms) :
 		_debug_info(debug_info),
 		_vulkan_semantics(vulkan_semantics),
 		_uniforms_to_spec_constants(uniforms_to_spec_constants),
 		_enable_16bit_types(enable_16bit_types),
-		_flip_vert_y(flip_vert_y)
+		_flip_vert_y(flip_vert_y),
+		_pack_uniforms(pack_uniforms),
+		_optimization_level(optimization_level)
 	{
 		_glsl_ext = make_id();
 	}
@@ -162,6 +930,15 @@ private:
 		{
 			return lhs.type == rhs.type && lhs.is_ptr == rhs.is_ptr && lhs.array_stride == rhs.array_stride && lhs.storage == rhs.storage;
 		}
+
+		struct hash
+		{
+			size_t operator()(const type_lookup &lookup) const
+			{
+				const uint32_t words[] = { lookup.type.base, lookup.type.rows, lookup.type.cols, lookup.type.array_length, lookup.type.struct_definition, lookup.is_ptr, lookup.array_stride, static_cast<uint32_t>(lookup.storage.first), static_cast<uint32_t>(lookup.storage.second) };
+				return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(words), sizeof(words)));
+			}
+		};
 	};
 	struct function_blocks
 	{
@@ -170,16 +947,20 @@ private:
 		spirv_basic_block definition;
 		reshadefx::type return_type;
 		std::vector<reshadefx::type> param_types;
+	};
+	struct global_blocks
+	{
+		// Either the function definition or the word range of the variable declaration in '_variables'
+		const function_blocks *function = nullptr;
+		size_t variable_begin = 0;
+		size_t variable_end = 0;
 
-		friend bool operator==(const function_blocks &lhs, const function_blocks &rhs)
-		{
-			if (lhs.param_types.size() != rhs.param_types.size())
-				return false;
-			for (size_t i = 0; i < lhs.param_types.size(); ++i)
-				if (!(lhs.param_types[i] == rhs.param_types[i]))
-					return false;
-			return lhs.return_type == rhs.return_type;
-		}
+		spirv_basic_block entry_point;
+		spirv_basic_block names;
+		spirv_basic_block annotations;
+
+		// Indices of the global variables and functions referenced directly by this function
+		std::vector<size_t> references;
 	};
 
 	bool _debug_info = false;
@@ -187,6 +968,8 @@ private:
 	bool _uniforms_to_spec_constants = false;
 	bool _enable_16bit_types = false;
 	bool _flip_vert_y = false;
+	bool _pack_uniforms = false;
+	int _optimization_level = 0;
 
 	spirv_basic_block _entries;
 	spirv_basic_block _execution_modes;
@@ -197,6 +980,10 @@ private:
 	spirv_basic_block _variables;
 
 	std::vector<function_blocks> _functions_blocks;
+
+	// All global variables and functions in module order, with the names, decorations and entry point instructions that belong to them (see 'build_global_index')
+	std::vector<global_blocks> _globals;
+	std::unordered_map<spv::Id, size_t> _global_lookup;
 	std::unordered_map<id, spirv_basic_block> _block_data;
 	spirv_basic_block *_current_block_data = nullptr;
 
@@ -206,16 +993,34 @@ private:
 	std::vector<spv::Id> _global_ubo_types;
 	function_blocks *_current_function_blocks = nullptr;
 
-	std::vector<std::pair<type_lookup, spv::Id>> _type_lookup;
-	std::vector<std::tuple<type, constant, spv::Id>> _constant_lookup;
-	std::vector<std::pair<function_blocks, spv::Id>> _function_type_lookup;
+	std::unordered_map<type_lookup, spv::Id, type_lookup::hash> _type_lookup;
+	// Constants and function types are looked up by a canonical encoding of their definition (see 'append_lookup_key')
+	std::unordered_map<std::string, spv::Id> _constant_lookup;
+	std::unordered_map<std::string, spv::Id> _function_type_lookup;
+	std::string _lookup_key;
 	std::unordered_map<std::string, spv::Id> _string_lookup;
 	std::unordered_map<spv::Id, std::pair<spv::StorageClass, spv::ImageFormat>> _storage_lookup;
 	std::unordered_map<std::string, uint32_t> _semantic_to_location;
 
-	std::unordered_set<spv::Id> _spec_constants;
+	// Index of the instruction defining each specialization constant in '_types_and_constants'
+	std::unordered_map<spv::Id, size_t> _spec_constants;
 	std::unordered_set<spv::Capability> _capabilities;
 
+	static void append_lookup_key(std::string &key, const type &info)
+	{
+		// Qualifiers are not part of the key, the same as they are ignored when comparing types
+		const uint32_t words[] = { info.base, static_cast<uint32_t>(info.rows | (info.cols << 4)), info.array_length, info.struct_definition };
+		key.append(reinterpret_cast<const char *>(words), sizeof(words));
+	}
+	static void append_lookup_key(std::string &key, const constant &data)
+	{
+		const uint32_t array_length = static_cast<uint32_t>(data.array_data.size());
+		key.append(reinterpret_cast<const char *>(data.as_uint), sizeof(data.as_uint));
+		key.append(reinterpret_cast<const char *>(&array_length), sizeof(array_length));
+		for (const constant &elem : data.array_data)
+			key.append(reinterpret_cast<const char *>(elem.as_uint), sizeof(elem.as_uint));
+	}
+
 	void add_location(const location &loc, spirv_basic_block &block)
 	{
 		if (loc.source.empty() || !_debug_info)
@@ -278,79 +1083,76 @@ private:
 			.add(loc.line)
 			.add(loc.column);
 	}
-	spirv_instruction &add_instruction(spv::Op op, spv::Id type = 0)
+	spirv_instruction add_instruction(spv::Op op, spv::Id type = 0)
 	{
 		assert(is_in_function() && is_in_block());
 
-		return add_instruction(op, type, *_current_block_data);
+		// All instructions with a result inside functions have a result type, so always reserve a word for it (access chains only set it after adding all operands)
+		return _current_block_data->add_instruction(op, type, make_id(), true);
 	}
-	spirv_instruction &add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
+	spirv_instruction add_instruction(spv::Op op, spv::Id type, spirv_basic_block &block)
 	{
-		spirv_instruction &instruction = add_instruction_without_result(op, block);
-		instruction.type = type;
-		instruction.result = make_id();
-		return instruction;
+		return block.add_instruction(op, type, make_id());
 	}
-	spirv_instruction &add_instruction_without_result(spv::Op op)
+	spirv_instruction add_instruction_without_result(spv::Op op)
 	{
 		assert(is_in_function() && is_in_block());
 
 		return add_instruction_without_result(op, *_current_block_data);
 	}
-	spirv_instruction &add_instruction_without_result(spv::Op op, spirv_basic_block &block)
+	spirv_instruction add_instruction_without_result(spv::Op op, spirv_basic_block &block)
 	{
-		return block.instructions.emplace_back(op);
+		return block.add_instruction(op);
 	}
 
 	void finalize_header_section(std::basic_string<char> &spirv) const
 	{
-		// Write SPIRV header info
-		spirv_instruction::write_word(spirv, spv::MagicNumber);
-		spirv_instruction::write_word(spirv, 0x10300); // Force SPIR-V 1.3
-		spirv_instruction::write_word(spirv, 0u); // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
-		spirv_instruction::write_word(spirv, _next_id); // Maximum ID
-		spirv_instruction::write_word(spirv, 0u); // Reserved for instruction schema
+		spirv_basic_block header;
+		header.words = {
+			spv::MagicNumber,
+			0x10300, // Force SPIR-V 1.3
+			0u, // Generator magic number, see https://www.khronos.org/registry/spir-v/api/spir-v.xml
+			_next_id, // Maximum ID
+			0u // Reserved for instruction schema
+		};
 
 		// All capabilities
-		spirv_instruction(spv::OpCapability)
-			.add(spv::CapabilityShader) // Implicitly declares the Matrix capability too
-			.write(spirv);
+		header.add_instruction(spv::OpCapability)
+			.add(spv::CapabilityShader); // Implicitly declares the Matrix capability too
 
 		for (const spv::Capability capability : _capabilities)
-			spirv_instruction(spv::OpCapability)
-				.add(capability)
-				.write(spirv);
+			header.add_instruction(spv::OpCapability)
+				.add(capability);
 
 		// Optional extension instructions
-		spirv_instruction(spv::OpExtInstImport, _glsl_ext)
-			.add_string("GLSL.std.450") // Import GLSL extension
-			.write(spirv);
+		header.add_instruction(spv::OpExtInstImport, 0, _glsl_ext)
+			.add_string("GLSL.std.450"); // Import GLSL extension
 
 		// Single required memory model instruction
-		spirv_instruction(spv::OpMemoryModel)
+		header.add_instruction(spv::OpMemoryModel)
 			.add(spv::AddressingModelLogical)
-			.add(spv::MemoryModelGLSL450)
-			.write(spirv);
+			.add(spv::MemoryModelGLSL450);
+
+		header.write(spirv);
 	}
 	void finalize_debug_info_section(std::basic_string<char> &spirv) const
 	{
-		spirv_instruction(spv::OpSource)
+		spirv_basic_block source;
+		source.add_instruction(spv::OpSource)
 			.add(spv::SourceLanguageUnknown) // ReShade FX is not a reserved token at the moment
-			.add(0) // Language version, TODO: Maybe fill in ReShade version here?
-			.write(spirv);
+			.add(0); // Language version, TODO: Maybe fill in ReShade version here?
+		source.write(spirv);
 
 		if (_debug_info)
 		{
 			// All debug instructions
-			for (const spirv_instruction &inst : _debug_a.instructions)
-				inst.write(spirv);
+			_debug_a.write(spirv);
 		}
 	}
 	void finalize_type_and_constants_section(std::basic_string<char> &spirv) const
 	{
 		// All type declarations
-		for (const spirv_instruction &inst : _types_and_constants.instructions)
-			inst.write(spirv);
+		_types_and_constants.write(spirv);
 
 		// Initialize the UBO type now that all member types are known
 		if (_global_ubo_type == 0 || _global_ubo_variable == 0)
@@ -358,17 +1160,128 @@ private:
 
 		const id global_ubo_type_ptr = _global_ubo_type + 1;
 
-		spirv_instruction(spv::OpTypeStruct, _global_ubo_type)
-			.add(_global_ubo_types.begin(), _global_ubo_types.end())
-			.write(spirv);
-		spirv_instruction(spv::OpTypePointer, global_ubo_type_ptr)
+		spirv_basic_block global_ubo;
+		global_ubo.add_instruction(spv::OpTypeStruct, 0, _global_ubo_type)
+			.add(_global_ubo_types.begin(), _global_ubo_types.end());
+		global_ubo.add_instruction(spv::OpTypePointer, 0, global_ubo_type_ptr)
 			.add(spv::StorageClassUniform)
-			.add(_global_ubo_type)
-			.write(spirv);
+			.add(_global_ubo_type);
 
-		spirv_instruction(spv::OpVariable, global_ubo_type_ptr, _global_ubo_variable)
-			.add(spv::StorageClassUniform)
-			.write(spirv);
+		global_ubo.add_instruction(spv::OpVariable, global_ubo_type_ptr, _global_ubo_variable)
+			.add(spv::StorageClassUniform);
+		global_ubo.write(spirv);
+	}
+
+	void build_global_index()
+	{
+		assert(_globals.empty());
+
+		// Global variables are declared before functions, so keep them first in the list to preserve module order
+		for (size_t offset = 0, begin = 0, word_count; offset < _variables.words.size(); offset += word_count)
+		{
+			const uint32_t *const inst = &_variables.words[offset];
+			word_count = inst[0] >> spv::WordCountShift;
+
+			// The variable declaration may be preceded by a line instruction
+			if ((inst[0] & spv::OpCodeMask) != spv::OpVariable)
+				continue;
+
+			// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpVariable
+			_global_lookup.emplace(inst[2], _globals.size());
+
+			global_blocks &variable = _globals.emplace_back();
+			variable.variable_begin = begin;
+			variable.variable_end = begin = offset + word_count;
+		}
+
+		// Assign every result of a function to that function, so that the names and decorations of e.g. its parameters and local variables are only written together with it
+		std::vector<uint32_t> owners(_next_id, std::numeric_limits<uint32_t>::max());
+		for (const auto &[variable, index] : _global_lookup)
+			owners[variable] = static_cast<uint32_t>(index);
+
+		for (const function_blocks &function : _functions_blocks)
+		{
+			if (function.definition.empty())
+				continue;
+
+			const uint32_t index = static_cast<uint32_t>(_globals.size());
+			_globals.emplace_back().function = &function;
+
+			for (const spirv_basic_block *const block : { &function.declaration, &function.variables, &function.definition })
+			{
+				for (const uint32_t *const inst : *block)
+				{
+					if (const spv::Id result = get_result_id(inst); result != 0 && result < _next_id)
+						owners[result] = index;
+
+					// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpFunction
+					if ((inst[0] & spv::OpCodeMask) == spv::OpFunction)
+						_global_lookup.emplace(inst[2], index);
+				}
+			}
+		}
+
+		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpEntryPoint
+		for (const uint32_t *const inst : _entries)
+			_globals[owners[inst[2]]].entry_point.append(inst);
+		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpExecutionMode
+		for (const uint32_t *const inst : _execution_modes)
+			_globals[owners[inst[1]]].entry_point.append(inst);
+
+		// Collect the references of each function once, so that extracting an entry point only has to walk the call graph
+		std::vector<size_t> last_referenced_by(_globals.size(), std::numeric_limits<size_t>::max());
+		for (size_t index = 0; index < _globals.size(); ++index)
+		{
+			const global_blocks &global = _globals[index];
+			if (global.function == nullptr)
+				continue;
+
+			const auto add_reference = [this, &last_referenced_by, index](spv::Id operand) {
+				if (const auto it = _global_lookup.find(operand);
+					it != _global_lookup.end() && it->second != index && last_referenced_by[it->second] != index)
+				{
+					last_referenced_by[it->second] = index;
+					_globals[index].references.push_back(it->second);
+				}
+			};
+
+			// The entry point instruction references all interface variables
+			for (const spirv_basic_block *const block : { &global.entry_point, &global.function->declaration, &global.function->variables, &global.function->definition })
+			{
+				for (const uint32_t *const inst : *block)
+				{
+					// Conservatively treat every operand as a reference if the instruction is not known
+					if (!visit_id_operands(inst, add_reference))
+						for (uint32_t i = 1; i < (inst[0] >> spv::WordCountShift); ++i)
+							add_reference(inst[i]);
+				}
+			}
+		}
+
+		// Move names and decorations of global variables and functions out of the module-wide sections, so that only those of types and constants remain there
+		const auto split_by_target = [this, &owners](spirv_basic_block &block, spirv_basic_block global_blocks::*target_block) {
+			spirv_basic_block remaining;
+			for (const uint32_t *const inst : block)
+			{
+				// All of OpName, OpMemberName, OpDecorate and OpMemberDecorate have the target as first operand
+				if (inst[1] < _next_id && owners[inst[1]] != std::numeric_limits<uint32_t>::max())
+					(_globals[owners[inst[1]]].*target_block).append(inst);
+				else
+					remaining.append(inst);
+			}
+			block = std::move(remaining);
+		};
+
+		split_by_target(_debug_b, &global_blocks::names);
+		split_by_target(_annotations, &global_blocks::annotations);
+	}
+
+	void optimize_bindings() override
+	{
+		codegen::optimize_bindings();
+
+		// The module is complete at this point, so can prepare for extracting entry points from it
+		build_global_index();
 	}
 
 	std::string finalize_code() const override
@@ -382,118 +1295,128 @@ private:
 		if (entry_point == nullptr)
 			return false;
 
-		// Build list of IDs to remove
-		std::vector<spv::Id> variables_to_remove;
-		std::vector<spv::Id> functions_to_remove;
+		const auto entry_point_it = _global_lookup.find(entry_point->id);
+		if (entry_point_it == _global_lookup.end())
+			return false;
 
-		finalize_header_section(spirv);
+		// Collect all global variables and functions reachable from the entry point over the call graph
+		std::vector<size_t> referenced_globals = { entry_point_it->second };
+		std::unordered_set<size_t> visited_globals = { entry_point_it->second };
 
-		// The entry point and execution mode declaration
-		for (const spirv_instruction &inst : _entries.instructions)
+		for (size_t i = 0; i < referenced_globals.size(); ++i)
 		{
-			assert(inst.op == spv::OpEntryPoint);
-
-			// Only add the matching entry point
-			if (inst.operands[1] == entry_point->id)
+			for (const size_t index : _globals[referenced_globals[i]].references)
 			{
-				inst.write(spirv);
-			}
-			else
-			{
-				functions_to_remove.push_back(inst.operands[1]);
-
-				// Add interface variables to list of variables to remove
-				for (uint32_t k = 2 + static_cast<uint32_t>((std::strlen(reinterpret_cast<const char *>(&inst.operands[2])) + 4) / 4); k < inst.operands.size(); ++k)
-					variables_to_remove.push_back(inst.operands[k]);
+				if (visited_globals.insert(index).second)
+					referenced_globals.push_back(index);
 			}
 		}
 
-		for (const spirv_instruction &inst : _execution_modes.instructions)
-		{
-			assert(inst.op == spv::OpExecutionMode);
+		// Write everything in module order
+		std::sort(referenced_globals.begin(), referenced_globals.end());
 
-			// Only add execution mode for the matching entry point
-			if (inst.operands[0] == entry_point->id)
-			{
-				inst.write(spirv);
-			}
-		}
+		const size_t module_offset = spirv.size();
 
-		finalize_debug_info_section(spirv);
+		finalize_header_section(spirv);
 
-		for (const spirv_instruction &inst : _debug_b.instructions)
-		{
-			// Remove all names of interface variables and functions for non-matching entry points
-			if (std::find(variables_to_remove.begin(), variables_to_remove.end(), inst.operands[0]) != variables_to_remove.end() ||
-				std::find(functions_to_remove.begin(), functions_to_remove.end(), inst.operands[0]) != functions_to_remove.end())
-				continue;
+		// The entry point and execution mode declaration
+		_globals[entry_point_it->second].entry_point.write(spirv);
 
-			inst.write(spirv);
-		}
+		finalize_debug_info_section(spirv);
+
+		// All names of types and constants, followed by those of the referenced variables and functions
+		_debug_b.write(spirv);
+		for (const size_t index : referenced_globals)
+			_globals[index].names.write(spirv);
 
 		// All annotation instructions
-		for (spirv_instruction inst : _annotations.instructions)
+		_annotations.write(spirv);
+		for (const size_t index : referenced_globals)
 		{
-			if (inst.op == spv::OpDecorate)
+			for (const uint32_t *const inst : _globals[index].annotations)
 			{
-				// Remove all decorations targeting any of the interface variables for non-matching entry points
-				if (std::find(variables_to_remove.begin(), variables_to_remove.end(), inst.operands[0]) != variables_to_remove.end())
-					continue;
+				const uint32_t word_count = inst[0] >> spv::WordCountShift;
 
+				// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpDecorate
 				// Replace bindings
-				if (inst.operands[1] == spv::DecorationBinding)
+				if ((inst[0] & spv::OpCodeMask) == spv::OpDecorate && inst[2] == spv::DecorationBinding)
 				{
-					if (const auto referenced_sampler_it = std::find(entry_point->referenced_samplers.begin(), entry_point->referenced_samplers.end(), inst.operands[0]);
+					assert(word_count == 4);
+					uint32_t binding_inst[4] = { inst[0], inst[1], inst[2], inst[3] };
+
+					if (const auto referenced_sampler_it = std::find(entry_point->referenced_samplers.begin(), entry_point->referenced_samplers.end(), inst[1]);
 						referenced_sampler_it != entry_point->referenced_samplers.end())
-						inst.operands[2] = static_cast<uint32_t>(referenced_sampler_it - entry_point->referenced_samplers.begin());
+						binding_inst[3] = static_cast<uint32_t>(referenced_sampler_it - entry_point->referenced_samplers.begin());
 					else
-					if (const auto referenced_storage_it = std::find(entry_point->referenced_storages.begin(), entry_point->referenced_storages.end(), inst.operands[0]);
+					if (const auto referenced_storage_it = std::find(entry_point->referenced_storages.begin(), entry_point->referenced_storages.end(), inst[1]);
 						referenced_storage_it != entry_point->referenced_storages.end())
-						inst.operands[2] = static_cast<uint32_t>(referenced_storage_it - entry_point->referenced_storages.begin());
+						binding_inst[3] = static_cast<uint32_t>(referenced_storage_it - entry_point->referenced_storages.begin());
+
+					spirv_basic_block::write(spirv, binding_inst, 4);
+					continue;
 				}
-			}
 
-			inst.write(spirv);
+				spirv_basic_block::write(spirv, inst, word_count);
+			}
 		}
 
 		finalize_type_and_constants_section(spirv);
 
-		for (const spirv_instruction &inst : _variables.instructions)
-		{
-			// Remove all declarations of the interface variables for non-matching entry points
-			if (inst.op == spv::OpVariable && std::find(variables_to_remove.begin(), variables_to_remove.end(), inst.result) != variables_to_remove.end())
-				continue;
-
-			inst.write(spirv);
-		}
+		// All referenced global variables
+		for (const size_t index : referenced_globals)
+			if (const global_blocks &global = _globals[index]; global.function == nullptr)
+				spirv_basic_block::write(spirv, _variables.words.data() + global.variable_begin, global.variable_end - global.variable_begin);
 
 		// All referenced function definitions
-		for (const function_blocks &function : _functions_blocks)
+		for (const size_t index : referenced_globals)
 		{
-			if (function.definition.instructions.empty())
+			const global_blocks &global = _globals[index];
+			if (global.function == nullptr)
 				continue;
 
-			assert(function.declaration.instructions[function.declaration.instructions[0].op != spv::OpFunction ? 1 : 0].op == spv::OpFunction);
-			const spv::Id definition = function.declaration.instructions[function.declaration.instructions[0].op != spv::OpFunction ? 1 : 0].result;
-
-			if (std::find(functions_to_remove.begin(), functions_to_remove.end(), definition) != functions_to_remove.end())
-				continue;
+			const function_blocks &function = *global.function;
 
-			for (const spirv_instruction &inst : function.declaration.instructions)
-				inst.write(spirv);
+			function.declaration.write(spirv);
 
 			// Grab first label and move it in front of variable declarations
-			function.definition.instructions.front().write(spirv);
-			assert(function.definition.instructions.front().op == spv::OpLabel);
+			const size_t label_word_count = function.definition.words[0] >> spv::WordCountShift;
+			assert((function.definition.words[0] & spv::OpCodeMask) == spv::OpLabel);
+			spirv_basic_block::write(spirv, function.definition.words.data(), label_word_count);
 
-			for (const spirv_instruction &inst : function.variables.instructions)
-				inst.write(spirv);
-			for (auto inst_it = function.definition.instructions.begin() + 1; inst_it != function.definition.instructions.end(); ++inst_it)
-				inst_it->write(spirv);
+			function.variables.write(spirv);
+			spirv_basic_block::write(spirv, function.definition.words.data() + label_word_count, function.definition.words.size() - label_word_count);
 		}
 
+		if (_optimization_level > 0)
+			optimize_module(spirv, module_offset);
+
 		return true;
 	}
+	void optimize_module(std::basic_string<char> &spirv, size_t module_offset) const
+	{
+		std::vector<uint32_t> words((spirv.size() - module_offset) / sizeof(uint32_t));
+		std::memcpy(words.data(), spirv.data() + module_offset, words.size() * sizeof(uint32_t));
+
+		spirv_module_optimizer optimizer(words);
+		if (!optimizer.parse())
+			return;
+
+		optimizer.remove_unused_functions_and_globals();
+
+		if (_optimization_level >= 2)
+		{
+			optimizer.merge_trivial_blocks();
+			optimizer.forward_local_loads_and_stores();
+
+			// Removing loads and stores may have left more constants unused
+			optimizer.remove_unused_functions_and_globals();
+		}
+
+		optimizer.compact();
+
+		spirv.resize(module_offset);
+		spirv_basic_block::write(spirv, words.data(), words.size());
+	}
 
 	spv::Id convert_type(type info, bool is_ptr = false, spv::StorageClass storage = spv::StorageClassFunction, spv::ImageFormat format = spv::ImageFormatUnknown, uint32_t array_stride = 0)
 	{
@@ -517,8 +1440,7 @@ private:
 
 		const type_lookup lookup { info, is_ptr, array_stride, { storage, format } };
 
-		if (const auto lookup_it = std::find_if(_type_lookup.begin(), _type_lookup.end(),
-				[&lookup](const std::pair<type_lookup, spv::Id> &lookup_entry) { return lookup_entry.first == lookup; });
+		if (const auto lookup_it = _type_lookup.find(lookup);
 			lookup_it != _type_lookup.end())
 			return lookup_it->second;
 
@@ -686,17 +1608,24 @@ private:
 			}
 		}
 
-		_type_lookup.push_back({ lookup, type_id });
+		_type_lookup.emplace(lookup, type_id);
 
 		return type_id;
 	}
 	spv::Id convert_type(const function_blocks &info)
 	{
-		if (const auto lookup_it = std::find_if(_function_type_lookup.begin(), _function_type_lookup.end(),
-				[&lookup = info](const std::pair<function_blocks, spv::Id> &lookup_entry) { return lookup_entry.first == lookup; });
+		_lookup_key.clear();
+		append_lookup_key(_lookup_key, info.return_type);
+		for (const type &param_type : info.param_types)
+			append_lookup_key(_lookup_key, param_type);
+
+		if (const auto lookup_it = _function_type_lookup.find(_lookup_key);
 			lookup_it != _function_type_lookup.end())
 			return lookup_it->second;
 
+		// Take ownership of the key, since it is overwritten when converting the parameter types below
+		std::string lookup_key = std::move(_lookup_key);
+
 		const spv::Id return_type_id = convert_type(info.return_type);
 		assert(return_type_id != 0);
 
@@ -705,11 +1634,11 @@ private:
 		for (const type &param_type : info.param_types)
 			param_type_ids.push_back(convert_type(param_type, true));
 
-		spirv_instruction &inst = add_instruction(spv::OpTypeFunction, 0, _types_and_constants)
+		spirv_instruction inst = add_instruction(spv::OpTypeFunction, 0, _types_and_constants)
 			.add(return_type_id)
 			.add(param_type_ids.begin(), param_type_ids.end());
 
-		_function_type_lookup.push_back({ info, inst });
+		_function_type_lookup.emplace(std::move(lookup_key), inst);
 
 		return inst;
 	}
@@ -737,8 +1666,7 @@ private:
 			lookup.type.struct_definition = static_cast<uint32_t>(elem_info.base);
 		}
 
-		if (const auto lookup_it = std::find_if(_type_lookup.begin(), _type_lookup.end(),
-				[&lookup](const std::pair<type_lookup, spv::Id> &lookup_entry) { return lookup_entry.first == lookup; });
+		if (const auto lookup_it = _type_lookup.find(lookup);
 			lookup_it != _type_lookup.end())
 			return lookup_it->second;
 
@@ -753,7 +1681,7 @@ private:
 				.add(info.is_storage() ? 2 : 1) // Used with a sampler or as storage
 				.add(format);
 
-		_type_lookup.push_back({ lookup, type_id });
+		_type_lookup.emplace(lookup, type_id);
 
 		return type_id;
 	}
@@ -999,6 +1927,14 @@ private:
 
 		return res;
 	}
+	static uint32_t uniform_alignment(const uniform &info)
+	{
+		// Same rules as the std140 layout in GLSL
+		if (info.type.is_matrix() || info.type.is_array())
+			return 16;
+		return (info.type.rows == 3 ? 4 : info.type.rows) * 4;
+	}
+
 	id   define_uniform(const location &, uniform &info) override
 	{
 		if (_uniforms_to_spec_constants && info.has_initializer_value)
@@ -1007,11 +1943,15 @@ private:
 
 			add_name(res, info.unique_name.c_str());
 
-			const auto add_spec_constant = [this](const spirv_instruction &inst, const uniform &info, const constant &initializer_value, size_t initializer_offset) {
-				assert(inst.op == spv::OpSpecConstant || inst.op == spv::OpSpecConstantTrue || inst.op == spv::OpSpecConstantFalse);
+			// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpSpecConstantComposite
+			const auto find_spec_constant = [this](spv::Id id) {
+				return _types_and_constants.words.data() + _spec_constants.at(id);
+			};
+			const auto add_spec_constant = [this](const uint32_t *inst, const uniform &info, const constant &initializer_value, size_t initializer_offset) {
+				assert((inst[0] & spv::OpCodeMask) == spv::OpSpecConstant || (inst[0] & spv::OpCodeMask) == spv::OpSpecConstantTrue || (inst[0] & spv::OpCodeMask) == spv::OpSpecConstantFalse);
 
 				const uint32_t spec_id = static_cast<uint32_t>(_module.spec_constants.size());
-				add_decoration(inst, spv::DecorationSpecId, { spec_id });
+				add_decoration(inst[2], spv::DecorationSpecId, { spec_id });
 
 				uniform scalar_info = info;
 				scalar_info.type.rows = 1;
@@ -1024,8 +1964,7 @@ private:
 				_module.spec_constants.push_back(std::move(scalar_info));
 			};
 
-			const spirv_instruction &base_inst = _types_and_constants.instructions.back();
-			assert(base_inst == res);
+			const uint32_t *const base_inst = find_spec_constant(res);
 
 			// External specialization constants need to be scalars
 			if (info.type.is_scalar())
@@ -1034,38 +1973,43 @@ private:
 			}
 			else
 			{
-				assert(base_inst.op == spv::OpSpecConstantComposite);
+				assert((base_inst[0] & spv::OpCodeMask) == spv::OpSpecConstantComposite);
+				const uint32_t num_elements = (base_inst[0] >> spv::WordCountShift) - 3;
 
 				// Add each individual scalar component of the constant as a separate external specialization constant
-				for (size_t i = 0; i < (info.type.is_array() ? base_inst.operands.size() : 1); ++i)
+				for (uint32_t i = 0; i < (info.type.is_array() ? num_elements : 1); ++i)
 				{
 					constant initializer_value = info.initializer_value;
-					spirv_instruction elem_inst = base_inst;
+					const uint32_t *elem_inst = base_inst;
 
 					if (info.type.is_array())
 					{
-						elem_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-							[operand_id = base_inst.operands[i]](const spirv_instruction &inst) { return inst == operand_id; });
+						elem_inst = find_spec_constant(base_inst[3 + i]);
 
-						assert(initializer_value.array_data.size() == base_inst.operands.size());
+						assert(initializer_value.array_data.size() == num_elements);
 						initializer_value = initializer_value.array_data[i];
+
+						// Arrays of scalars do not have any rows
+						if ((elem_inst[0] & spv::OpCodeMask) != spv::OpSpecConstantComposite)
+						{
+							add_spec_constant(elem_inst, info, initializer_value, 0);
+							continue;
+						}
 					}
 
-					for (size_t row = 0; row < elem_inst.operands.size(); ++row)
+					for (uint32_t row = 0; row < (elem_inst[0] >> spv::WordCountShift) - 3; ++row)
 					{
-						const spirv_instruction &row_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-							[operand_id = elem_inst.operands[row]](const spirv_instruction &inst) { return inst == operand_id; });
+						const uint32_t *const row_inst = find_spec_constant(elem_inst[3 + row]);
 
-						if (row_inst.op != spv::OpSpecConstantComposite)
+						if ((row_inst[0] & spv::OpCodeMask) != spv::OpSpecConstantComposite)
 						{
 							add_spec_constant(row_inst, info, initializer_value, row);
 							continue;
 						}
 
-						for (size_t col = 0; col < row_inst.operands.size(); ++col)
+						for (uint32_t col = 0; col < (row_inst[0] >> spv::WordCountShift) - 3; ++col)
 						{
-							const spirv_instruction &col_inst = *std::find_if(_types_and_constants.instructions.rbegin(), _types_and_constants.instructions.rend(),
-								[operand_id = row_inst.operands[col]](const spirv_instruction &inst) { return inst == operand_id; });
+							const uint32_t *const col_inst = find_spec_constant(row_inst[3 + col]);
 
 							add_spec_constant(col_inst, info, initializer_value, row * info.type.cols + col);
 						}
@@ -1093,28 +2037,21 @@ private:
 				add_decoration(_global_ubo_variable, spv::DecorationBinding, { 0 });
 			}
 
-			uint32_t alignment = (info.type.rows == 3 ? 4 : info.type.rows) * 4;
 			info.size = info.type.rows * 4;
 
 			uint32_t array_stride = 16;
 			const uint32_t matrix_stride = 16;
 
 			if (info.type.is_matrix())
-			{
-				alignment = matrix_stride;
 				info.size = info.type.rows * matrix_stride;
-			}
 			if (info.type.is_array())
 			{
-				alignment = array_stride;
 				array_stride = align_up(info.size, array_stride);
 				// Uniform block rules do not permit anything in the padding of an array
 				info.size = array_stride * info.type.array_length;
 			}
 
-			info.offset = _module.total_uniform_size;
-			info.offset = align_up(info.offset, alignment);
-			_module.total_uniform_size = info.offset + info.size;
+			info.offset = allocate_uniform(info.size, uniform_alignment(info), false);
 
 			type ubo_type = info.type;
 			// Convert boolean uniform variables to integer type so that they have a defined size
@@ -1129,7 +2066,9 @@ private:
 
 			add_member_name(_global_ubo_type, member_index, info.unique_name.c_str());
 
-			add_member_decoration(_global_ubo_type, member_index, spv::DecorationOffset, { info.offset });
+			// Offsets only become final after packing, so decorate members with them at that point instead
+			if (!_pack_uniforms)
+				add_member_decoration(_global_ubo_type, member_index, spv::DecorationOffset, { info.offset });
 
 			if (info.type.is_matrix())
 			{
@@ -1144,6 +2083,17 @@ private:
 			return 0xF0000000 | member_index;
 		}
 	}
+	void optimize_uniform_layout() override
+	{
+		if (!_pack_uniforms)
+			return;
+
+		pack_uniforms(&uniform_alignment);
+
+		// Members of the global uniform buffer were added in the same order as the uniform variables in the module
+		for (uint32_t member_index = 0; member_index < static_cast<uint32_t>(_module.uniforms.size()); ++member_index)
+			add_member_decoration(_global_ubo_type, member_index, spv::DecorationOffset, { _module.uniforms[member_index].offset });
+	}
 	id   define_variable(const location &loc, const type &type, std::string name, bool global, id initializer_value) override
 	{
 		spv::StorageClass storage = spv::StorageClassFunction;
@@ -1164,7 +2114,7 @@ private:
 		add_location(loc, block);
 
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpVariable
-		spirv_instruction &inst = add_instruction(spv::OpVariable, convert_type(type, true, storage, format), block);
+		spirv_instruction inst = add_instruction(spv::OpVariable, convert_type(type, true, storage, format), block);
 		inst.add(storage);
 
 		const id res = inst.result;
@@ -1255,7 +2205,7 @@ private:
 		spv::Id position_variable = 0;
 		spv::Id point_size_variable = 0;
 		std::vector<spv::Id> inputs_and_outputs;
-		std::vector<expression> call_params;
+		std::pmr::vector<expression> call_params;
 
 		// Generate the glue entry point function
 		function entry_point = func;
@@ -1588,7 +2538,8 @@ private:
 				it != _storage_lookup.end())
 				storage = it->second;
 
-			spirv_instruction *access_chain = nullptr;
+			spirv_instruction access_chain = {};
+			bool has_access_chain = false;
 
 			// Check if this is a uniform variable (see 'define_uniform' function above) and dereference it
 			if (result & 0xF0000000)
@@ -1601,9 +2552,10 @@ private:
 				if (is_uniform_bool)
 					base_type.base = type::t_uint;
 
-				access_chain = &add_instruction(spv::OpAccessChain)
+				access_chain = add_instruction(spv::OpAccessChain)
 					.add(_global_ubo_variable)
 					.add(emit_constant(member_index));
+				has_access_chain = true;
 			}
 
 			// Any indexing expressions can be resolved during load with an 'OpAccessChain' already
@@ -1616,8 +2568,8 @@ private:
 				assert(_current_block_data != &_types_and_constants);
 
 				// Use access chain from uniform if possible, otherwise create new one
-				if (access_chain == nullptr) access_chain =
-					&add_instruction(spv::OpAccessChain).add(result); // Base
+				if (!has_access_chain) access_chain =
+					add_instruction(spv::OpAccessChain).add(result); // Base
 
 				// Ignore first index into 1xN matrices, since they were translated to a vector type in SPIR-V
 				if (exp.chain[0].from.rows == 1 && exp.chain[0].from.cols > 1)
@@ -1627,18 +2579,18 @@ private:
 					exp.chain[i].op == expression::operation::op_member ||
 					exp.chain[i].op == expression::operation::op_dynamic_index ||
 					exp.chain[i].op == expression::operation::op_constant_index); ++i)
-					access_chain->add(exp.chain[i].op == expression::operation::op_dynamic_index ?
+					access_chain.add(exp.chain[i].op == expression::operation::op_dynamic_index ?
 						exp.chain[i].index :
 						emit_constant(exp.chain[i].index)); // Indexes
 
 				base_type = exp.chain[i - 1].to;
-				access_chain->type = convert_type(base_type, true, storage.first, storage.second); // Last type is the result
-				result = access_chain->result;
+				access_chain.set_type(convert_type(base_type, true, storage.first, storage.second)); // Last type is the result
+				result = access_chain.result;
 			}
-			else if (access_chain != nullptr)
+			else if (has_access_chain)
 			{
-				access_chain->type = convert_type(base_type, true, storage.first, storage.second, base_type.is_array() ? 16u : 0u);
-				result = access_chain->result;
+				access_chain.set_type(convert_type(base_type, true, storage.first, storage.second, base_type.is_array() ? 16u : 0u));
+				result = access_chain.result;
 			}
 
 			result =
@@ -1671,7 +2623,7 @@ private:
 					type cast_type = op.to;
 					cast_type.base = op.from.base;
 
-					std::vector<expression> args;
+					std::pmr::vector<expression> args;
 					args.reserve(op.to.components());
 					for (unsigned int c = 0; c < op.to.components(); ++c)
 						args.emplace_back().reset_to_rvalue(exp.location, result, op.from);
@@ -1682,7 +2634,7 @@ private:
 				{
 					assert(op.from.components() == op.to.components());
 
-					std::vector<expression> args;
+					std::pmr::vector<expression> args;
 					args.reserve(op.to.components());
 					for (unsigned int c = 0; c < op.to.components(); ++c)
 					{
@@ -1690,7 +2642,7 @@ private:
 						scalar_type.rows = 1;
 						scalar_type.cols = 1;
 
-						spirv_instruction &inst = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type));
+						spirv_instruction inst = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type));
 						inst.add(result);
 						inst.add(c);
 
@@ -1788,7 +2740,7 @@ private:
 				assert(op.to.is_vector());
 				if (op.from.is_vector())
 				{
-					spirv_instruction &inst = add_instruction(spv::OpVectorShuffle, convert_type(op.to));
+					spirv_instruction inst = add_instruction(spv::OpVectorShuffle, convert_type(op.to));
 					inst.add(result); // Vector 1
 					inst.add(result); // Vector 2
 					for (int c = 0; c < 4 && op.swizzle[c] >= 0; ++c)
@@ -1797,7 +2749,7 @@ private:
 				}
 				else
 				{
-					spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
+					spirv_instruction inst = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
 					for (unsigned int c = 0; c < op.to.rows; ++c)
 						inst.add(result);
 					result = inst;
@@ -1806,7 +2758,7 @@ private:
 			case expression::operation::op_matrix_swizzle:
 				if (op.swizzle[1] < 0)
 				{
-					spirv_instruction &inst = add_instruction(spv::OpCompositeExtract, convert_type(op.to));
+					spirv_instruction inst = add_instruction(spv::OpCompositeExtract, convert_type(op.to));
 					inst.add(result); // Composite
 					if (op.from.rows > 1)
 					{
@@ -1834,7 +2786,7 @@ private:
 						scalar_type.rows = 1;
 						scalar_type.cols = 1;
 
-						spirv_instruction &inst = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type));
+						spirv_instruction inst = add_instruction(spv::OpCompositeExtract, convert_type(scalar_type));
 						inst.add(result);
 						if (op.from.rows > 1) // Matrix types with a single row are actually vectors, so they don't need the extra index
 							inst.add(row);
@@ -1843,7 +2795,7 @@ private:
 						components[c] = inst;
 					}
 
-					spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
+					spirv_instruction inst = add_instruction(spv::OpCompositeConstruct, convert_type(op.to));
 					for (int c = 0; c < 4 && op.swizzle[c] >= 0; ++c)
 						inst.add(components[c]);
 					result = inst;
@@ -1887,7 +2839,7 @@ private:
 						add_instruction(spv::OpLoad, convert_type(base_type))
 							.add(target); // Pointer
 
-					spirv_instruction &inst = add_instruction(spv::OpVectorShuffle, convert_type(base_type));
+					spirv_instruction inst = add_instruction(spv::OpVectorShuffle, convert_type(base_type));
 					inst.add(result); // Vector 1
 					inst.add(value); // Vector 2
 
@@ -1908,7 +2860,7 @@ private:
 						add_instruction(spv::OpLoad, convert_type(base_type))
 							.add(target); // Pointer
 
-					spirv_instruction &inst = add_instruction(spv::OpCompositeInsert, convert_type(base_type));
+					spirv_instruction inst = add_instruction(spv::OpCompositeInsert, convert_type(base_type));
 					inst.add(value); // Object
 					inst.add(result); // Composite
 					if (op.from.rows > 1)
@@ -1958,8 +2910,8 @@ private:
 		// Ensure that 'access_chain' cannot get invalidated by calls to 'emit_constant' or 'convert_type'
 		assert(_current_block_data != &_types_and_constants);
 
-		spirv_instruction *access_chain =
-			&add_instruction(spv::OpAccessChain).add(exp.base); // Base
+		spirv_instruction access_chain =
+			add_instruction(spv::OpAccessChain).add(exp.base); // Base
 
 		// Ignore first index into 1xN matrices, since they were translated to a vector type in SPIR-V
 		if (exp.chain[0].from.rows == 1 && exp.chain[0].from.cols > 1)
@@ -1969,12 +2921,12 @@ private:
 			exp.chain[i].op == expression::operation::op_member ||
 			exp.chain[i].op == expression::operation::op_dynamic_index ||
 			exp.chain[i].op == expression::operation::op_constant_index); ++i)
-			access_chain->add(exp.chain[i].op == expression::operation::op_dynamic_index ?
+			access_chain.add(exp.chain[i].op == expression::operation::op_dynamic_index ?
 				exp.chain[i].index :
 				emit_constant(exp.chain[i].index)); // Indexes
 
-		access_chain->type = convert_type(exp.chain[i - 1].to, true, storage.first, storage.second); // Last type is the result
-		return access_chain->result;
+		access_chain.set_type(convert_type(exp.chain[i - 1].to, true, storage.first, storage.second)); // Last type is the result
+		return access_chain.result;
 	}
 
 	using codegen::emit_constant;
@@ -1988,22 +2940,22 @@ private:
 	}
 	id   emit_constant(const type &data_type, const constant &data, bool spec_constant)
 	{
+		std::string lookup_key;
 		if (!spec_constant) // Specialization constants cannot reuse other constants
 		{
-			if (const auto it = std::find_if(_constant_lookup.begin(), _constant_lookup.end(),
-					[&data_type, &data](std::tuple<type, constant, spv::Id> &x) {
-						if (!(std::get<0>(x) == data_type && std::memcmp(&std::get<1>(x).as_uint[0], &data.as_uint[0], sizeof(uint32_t) * 16) == 0 && std::get<1>(x).array_data.size() == data.array_data.size()))
-							return false;
-						for (size_t i = 0; i < data.array_data.size(); ++i)
-							if (std::memcmp(&std::get<1>(x).array_data[i].as_uint[0], &data.array_data[i].as_uint[0], sizeof(uint32_t) * 16) != 0)
-								return false;
-						return true;
-					});
+			_lookup_key.clear();
+			append_lookup_key(_lookup_key, data_type);
+			append_lookup_key(_lookup_key, data);
+
+			if (const auto it = _constant_lookup.find(_lookup_key);
 				it != _constant_lookup.end())
-				return std::get<2>(*it); // Reuse existing constant instead of duplicating the definition
+				return it->second; // Reuse existing constant instead of duplicating the definition
+
+			// Take ownership of the key, since it is overwritten when emitting the elements of composite constants below
+			lookup_key = std::move(_lookup_key);
 		}
 
-		spv::Id result;
+		spirv_instruction inst = {};
 		if (data_type.is_array())
 		{
 			assert(data_type.is_bounded_array()); // Unbounded arrays cannot be constants
@@ -2021,7 +2973,7 @@ private:
 			for (size_t i = elements.size(); i < static_cast<size_t>(data_type.array_length); ++i)
 				elements.push_back(emit_constant(elem_type, {}, spec_constant));
 
-			result =
+			inst =
 				add_instruction(spec_constant ? spv::OpSpecConstantComposite : spv::OpConstantComposite, convert_type(data_type), _types_and_constants)
 					.add(elements.begin(), elements.end());
 		}
@@ -2029,7 +2981,7 @@ private:
 		{
 			assert(!spec_constant); // Structures cannot be specialization constants
 
-			result = add_instruction(spv::OpConstantNull, convert_type(data_type), _types_and_constants);
+			inst = add_instruction(spv::OpConstantNull, convert_type(data_type), _types_and_constants);
 		}
 		else if (data_type.is_vector() || data_type.is_matrix())
 		{
@@ -2052,19 +3004,20 @@ private:
 
 			if (data_type.rows == 1)
 			{
-				result = rows[0];
+				if (!spec_constant)
+					_constant_lookup.emplace(std::move(lookup_key), rows[0]);
+				return rows[0];
 			}
 			else
 			{
-				spirv_instruction &inst = add_instruction(spec_constant ? spv::OpSpecConstantComposite : spv::OpConstantComposite, convert_type(data_type), _types_and_constants);
+				inst = add_instruction(spec_constant ? spv::OpSpecConstantComposite : spv::OpConstantComposite, convert_type(data_type), _types_and_constants);
 				for (unsigned int i = 0; i < data_type.rows; ++i)
 					inst.add(rows[i]);
-				result = inst;
 			}
 		}
 		else if (data_type.is_boolean())
 		{
-			result = add_instruction(data.as_uint[0] ?
+			inst = add_instruction(data.as_uint[0] ?
 				(spec_constant ? spv::OpSpecConstantTrue : spv::OpConstantTrue) :
 				(spec_constant ? spv::OpSpecConstantFalse : spv::OpConstantFalse), convert_type(data_type), _types_and_constants);
 		}
@@ -2072,17 +3025,17 @@ private:
 		{
 			assert(data_type.is_scalar());
 
-			result =
+			inst =
 				add_instruction(spec_constant ? spv::OpSpecConstant : spv::OpConstant, convert_type(data_type), _types_and_constants)
 					.add(data.as_uint[0]);
 		}
 
 		if (spec_constant) // Keep track of all specialization constants
-			_spec_constants.insert(result);
+			_spec_constants.emplace(inst.result, inst.offset);
 		else
-			_constant_lookup.push_back({ data_type, data, result });
+			_constant_lookup.emplace(std::move(lookup_key), inst.result);
 
-		return result;
+		return inst;
 	}
 
 	id   emit_unary_op(const location &loc, tokenid op, const type &res_type, id val) override
@@ -2106,7 +3059,7 @@ private:
 
 		add_location(loc, *_current_block_data);
 
-		spirv_instruction &inst = add_instruction(spv_op, convert_type(res_type));
+		spirv_instruction inst = add_instruction(spv_op, convert_type(res_type));
 		inst.add(val); // Operand
 
 		if (res_type.has(type::q_precise))
@@ -2217,7 +3170,7 @@ private:
 					.add(rhs)
 					.add(row);
 
-				spirv_instruction &inst = add_instruction(spv_op, convert_type(vector_type));
+				spirv_instruction inst = add_instruction(spv_op, convert_type(vector_type));
 				inst.add(lhs_elem); // Operand 1
 				inst.add(rhs_elem); // Operand 2
 
@@ -2229,13 +3182,13 @@ private:
 				ids.push_back(inst);
 			}
 
-			spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
+			spirv_instruction inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
 			inst.add(ids.begin(), ids.end());
 
 			return inst;
 		}
 
-		spirv_instruction &inst = add_instruction(spv_op, convert_type(res_type));
+		spirv_instruction inst = add_instruction(spv_op, convert_type(res_type));
 		inst.add(lhs); // Operand 1
 		inst.add(rhs); // Operand 2
 
@@ -2253,14 +3206,14 @@ private:
 
 		add_location(loc, *_current_block_data);
 
-		spirv_instruction &inst = add_instruction(spv::OpSelect, convert_type(res_type));
+		spirv_instruction inst = add_instruction(spv::OpSelect, convert_type(res_type));
 		inst.add(condition); // Condition
 		inst.add(true_value); // Object 1
 		inst.add(false_value); // Object 2
 
 		return inst;
 	}
-	id   emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call(const location &loc, id function, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -2269,14 +3222,14 @@ private:
 		add_location(loc, *_current_block_data);
 
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpFunctionCall
-		spirv_instruction &inst = add_instruction(spv::OpFunctionCall, convert_type(res_type));
+		spirv_instruction inst = add_instruction(spv::OpFunctionCall, convert_type(res_type));
 		inst.add(function); // Function
 		for (const expression &arg : args)
 			inst.add(arg.base); // Arguments
 
 		return inst;
 	}
-	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::vector<expression> &args) override
+	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -2298,7 +3251,7 @@ private:
 			return assert(false), 0;
 		}
 	}
-	id   emit_construct(const location &loc, const type &res_type, const std::vector<expression> &args) override
+	id   emit_construct(const location &loc, const type &res_type, const std::pmr::vector<expression> &args) override
 	{
 #ifndef NDEBUG
 		for (const expression &arg : args)
@@ -2319,7 +3272,7 @@ private:
 			// Turn the list of scalar arguments into a list of column vectors
 			for (size_t arg = 0; arg < args.size(); arg += vector_type.rows)
 			{
-				spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(vector_type));
+				spirv_instruction inst = add_instruction(spv::OpCompositeConstruct, convert_type(vector_type));
 				for (unsigned int row = 0; row < vector_type.rows; ++row)
 					inst.add(args[arg + row].base);
 
@@ -2335,7 +3288,7 @@ private:
 				ids.push_back(arg.base);
 		}
 
-		spirv_instruction &inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
+		spirv_instruction inst = add_instruction(spv::OpCompositeConstruct, convert_type(res_type));
 		inst.add(ids.begin(), ids.end());
 
 		return inst;
@@ -2343,35 +3296,32 @@ private:
 
 	void emit_if(const location &loc, id, id condition_block, id true_statement_block, id false_statement_block, unsigned int selection_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 2> merge_label = _current_block_data->pop_back<2>();
+		assert((merge_label[0] & spv::OpCodeMask) == spv::OpLabel);
 
 		// Add previous block containing the condition value first
 		_current_block_data->append(_block_data[condition_block]);
 
-		spirv_instruction branch_inst = _current_block_data->instructions.back();
-		assert(branch_inst.op == spv::OpBranchConditional);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 4> branch_inst = _current_block_data->pop_back<4>();
+		assert((branch_inst[0] & spv::OpCodeMask) == spv::OpBranchConditional);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpSelectionMerge)
-			.add(merge_label)
+			.add(merge_label[1])
 			.add(selection_control & 0x3); // 'SelectionControl' happens to match the flags produced by the parser
 
 		// Append all blocks belonging to the branch
-		_current_block_data->instructions.push_back(branch_inst);
+		_current_block_data->push_back(branch_inst);
 		_current_block_data->append(_block_data[true_statement_block]);
 		_current_block_data->append(_block_data[false_statement_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->push_back(merge_label);
 	}
 	id   emit_phi(const location &loc, id, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &res_type) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 2> merge_label = _current_block_data->pop_back<2>();
+		assert((merge_label[0] & spv::OpCodeMask) == spv::OpLabel);
 
 		// Add previous block containing the condition value first
 		_current_block_data->append(_block_data[condition_block]);
@@ -2381,12 +3331,12 @@ private:
 		if (false_statement_block != condition_block)
 			_current_block_data->append(_block_data[false_statement_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->push_back(merge_label);
 
 		add_location(loc, *_current_block_data);
 
 		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#OpPhi
-		spirv_instruction &inst = add_instruction(spv::OpPhi, convert_type(res_type))
+		spirv_instruction inst = add_instruction(spv::OpPhi, convert_type(res_type))
 			.add(true_value) // Variable 0
 			.add(true_statement_block) // Parent 0
 			.add(false_value) // Variable 1
@@ -2396,27 +3346,27 @@ private:
 	}
 	void emit_loop(const location &loc, id, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int loop_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 2> merge_label = _current_block_data->pop_back<2>();
+		assert((merge_label[0] & spv::OpCodeMask) == spv::OpLabel);
 
 		// Add previous block first
 		_current_block_data->append(_block_data[prev_block]);
 
-		// Fill header block
-		assert(_block_data[header_block].instructions.size() == 2);
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[0]);
-		assert(_current_block_data->instructions.back().op == spv::OpLabel);
+		// Fill header block, which consists of a label followed by a branch
+		const std::vector<uint32_t> &header_words = _block_data[header_block].words;
+		assert(header_words.size() == 4);
+		assert((header_words[0] & spv::OpCodeMask) == spv::OpLabel);
+		_current_block_data->words.insert(_current_block_data->words.end(), header_words.begin(), header_words.begin() + 2);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpLoopMerge)
-			.add(merge_label)
+			.add(merge_label[1])
 			.add(continue_block)
 			.add(loop_control & 0x3); // 'LoopControl' happens to match the flags produced by the parser
 
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[1]);
-		assert(_current_block_data->instructions.back().op == spv::OpBranch);
+		assert((header_words[2] & spv::OpCodeMask) == spv::OpBranch);
+		_current_block_data->words.insert(_current_block_data->words.end(), header_words.begin() + 2, header_words.end());
 
 		// Add condition block if it exists
 		if (condition_block != 0)
@@ -2426,38 +3376,37 @@ private:
 		_current_block_data->append(_block_data[loop_block]);
 		_current_block_data->append(_block_data[continue_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->push_back(merge_label);
 	}
 	void emit_switch(const location &loc, id, id selector_block, id default_label, id default_block, const std::vector<id> &case_literal_and_labels, const std::vector<id> &case_blocks, unsigned int selection_control) override
 	{
 		assert(case_blocks.size() == case_literal_and_labels.size() / 2);
 
-		spirv_instruction merge_label = _current_block_data->instructions.back();
-		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 2> merge_label = _current_block_data->pop_back<2>();
+		assert((merge_label[0] & spv::OpCodeMask) == spv::OpLabel);
 
 		// Add previous block containing the selector value first
 		_current_block_data->append(_block_data[selector_block]);
 
-		spirv_instruction switch_inst = _current_block_data->instructions.back();
-		assert(switch_inst.op == spv::OpSwitch);
-		_current_block_data->instructions.pop_back();
+		const std::array<uint32_t, 3> switch_inst = _current_block_data->pop_back<3>();
+		assert((switch_inst[0] & spv::OpCodeMask) == spv::OpSwitch);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
 		add_instruction_without_result(spv::OpSelectionMerge)
-			.add(merge_label)
+			.add(merge_label[1])
 			.add(selection_control & 0x3); // 'SelectionControl' happens to match the flags produced by the parser
 
-		// Update switch instruction to contain all case labels
-		switch_inst.operands[1] = default_label;
-		switch_inst.add(case_literal_and_labels.begin(), case_literal_and_labels.end());
+		// Add switch instruction again, now with all case labels
+		add_instruction_without_result(spv::OpSwitch)
+			.add(switch_inst[1]) // Selector
+			.add(default_label)
+			.add(case_literal_and_labels.begin(), case_literal_and_labels.end());
 
 		// Append all blocks belonging to the switch
-		_current_block_data->instructions.push_back(switch_inst);
 
 		std::vector<id> blocks = case_blocks;
-		if (default_label != merge_label)
+		if (default_label != merge_label[1])
 			blocks.push_back(default_block);
 		// Eliminate duplicates (because of multiple case labels pointing to the same block)
 		std::sort(blocks.begin(), blocks.end());
@@ -2465,11 +3414,13 @@ private:
 		for (const id case_block : blocks)
 			_current_block_data->append(_block_data[case_block]);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->push_back(merge_label);
 	}
 
-	void emit_pragma(const std::string &) override
+	void emit_pragma(const std::string &pragma) override
 	{
+		if (pragma == "reshade skipoptimization" || pragma == "reshade nooptimization")
+			_optimization_level = -1;
 	}
 
 	bool is_in_function() const { return _current_function_blocks != nullptr; }
@@ -2490,7 +3441,7 @@ private:
 
 		set_block(id);
 
-		add_instruction_without_result(spv::OpLabel).result = id;
+		_current_block_data->add_instruction(spv::OpLabel, 0, id);
 	}
 	id   leave_block_and_kill() override
 	{
@@ -2582,8 +3533,24 @@ private:
 };
 
 #ifndef RESHADEFX_CODEGEN_SPIRV_INLINE
-codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y)
+codegen *reshadefx::create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants, bool enable_16bit_types, bool flip_vert_y, int optimization_level, bool pack_uniforms)
 {
-	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y);
+	return new codegen_spirv(vulkan_semantics, debug_info, uniforms_to_spec_constants, enable_16bit_types, flip_vert_y, optimization_level, pack_uniforms);
+}
+
+bool reshadefx::validate_spirv_module(const std::string &code, std::string &errors)
+{
+	if (code.size() % sizeof(uint32_t) != 0)
+		return errors = "module size is not a multiple of the word size", false;
+
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	std::memcpy(words.data(), code.data(), code.size());
+
+	// The optimizer has to know every instruction in order to work on the module, so use it to split the module into instructions
+	spirv_module_optimizer optimizer(words);
+	if (!optimizer.parse())
+		return errors = "invalid module header, instruction size or unknown instruction", false;
+
+	return optimizer.validate(errors);
 }
 #endif
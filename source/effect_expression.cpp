@@ -9,6 +9,25 @@
 #include <cstring> // std::memcpy, std::memset
 #include <algorithm> // std::max, std::min
 
+static thread_local std::pmr::memory_resource *s_current_expression_resource = nullptr;
+
+reshadefx::expression_arena_scope::expression_arena_scope() :
+	_arena(64 * 1024, std::pmr::new_delete_resource()),
+	_previous_resource(s_current_expression_resource)
+{
+	s_current_expression_resource = &_arena;
+}
+reshadefx::expression_arena_scope::~expression_arena_scope()
+{
+	assert(s_current_expression_resource == &_arena);
+	s_current_expression_resource = _previous_resource;
+}
+
+std::pmr::memory_resource *reshadefx::expression_arena_scope::current_resource()
+{
+	return s_current_expression_resource != nullptr ? s_current_expression_resource : std::pmr::new_delete_resource();
+}
+
 reshadefx::type reshadefx::type::merge(const type &lhs, const type &rhs)
 {
 	type result;
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_token.hpp"
+#include <memory_resource>
 
 namespace reshadefx
 {
@@ -151,6 +152,26 @@ namespace reshadefx
 		std::vector<constant> array_data;
 	};
 
+	/// <summary>
+	/// Scope during which the access chains of expressions created on the current thread are allocated from a monotonic buffer, which is released all at once when the scope ends.
+	/// Expressions created in this scope may not outlive it.
+	/// </summary>
+	class expression_arena_scope
+	{
+	public:
+		expression_arena_scope();
+		~expression_arena_scope();
+
+		/// <summary>
+		/// Gets the memory resource that expressions created on the current thread allocate their access chain from.
+		/// </summary>
+		static std::pmr::memory_resource *current_resource();
+
+	private:
+		std::pmr::monotonic_buffer_resource _arena;
+		std::pmr::memory_resource *_previous_resource;
+	};
+
 	/// <summary>
 	/// Structures which keeps track of the access chain of an expression
 	/// </summary>
@@ -180,7 +201,7 @@ namespace reshadefx
 		bool is_lvalue = false;
 		bool is_constant = false;
 		reshadefx::location location;
-		std::vector<operation> chain;
+		std::pmr::vector<operation> chain { expression_arena_scope::current_resource() };
 
 		/// <summary>
 		/// Initializes the expression to a l-value.
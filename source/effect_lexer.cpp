@@ -8,6 +8,17 @@
 #include <string_view>
 #include <unordered_map> // Used for static lookup tables
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#include <emmintrin.h>
+	#define RESHADEFX_LEXER_SSE2 1
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define RESHADEFX_LEXER_NEON 1
+#endif
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
 using namespace reshadefx;
 
 enum token_type
@@ -233,7 +244,82 @@ static const std::unordered_map<tokenid, std::string_view> s_token_lookup = {
 	{ tokenid::storage2d, "storage2D" },
 	{ tokenid::storage3d, "storage3D" },
 };
-static const std::unordered_map<std::string_view, tokenid> s_keyword_lookup = {
+// Compile-time hash table used to classify identifiers as keywords or preprocessor directives without any heap allocation or static initialization
+struct keyword_entry
+{
+	std::string_view name;
+	tokenid id;
+};
+
+template <size_t SIZE>
+struct keyword_table
+{
+	static_assert((SIZE & (SIZE - 1)) == 0, "keyword table size has to be a power of two");
+
+	keyword_entry slots[SIZE] = {};
+	size_t min_name_length = SIZE_MAX;
+	size_t max_name_length = 0;
+	size_t max_probe_count = 0;
+
+	static constexpr uint32_t hash(std::string_view name)
+	{
+		assert(name.size() >= 2);
+
+		// Only sample the length and a few characters instead of hashing the entire name, collisions are resolved by comparing the full name
+		const size_t length = name.size();
+		uint32_t hash = uint32_t(length) | (uint32_t(uint8_t(name[0])) << 8) | (uint32_t(uint8_t(name[length - 1])) << 16) | (uint32_t(uint8_t(name[length - 2])) << 24);
+		hash ^= uint8_t(name[length / 2]) * 0x9E3779B1u;
+		hash *= 0x9E3779B1u;
+		return hash ^ (hash >> 15);
+	}
+
+	constexpr tokenid find(std::string_view name) const
+	{
+		if (name.size() < min_name_length || name.size() > max_name_length)
+			return tokenid::unknown;
+
+		const uint32_t first_slot = hash(name);
+		for (size_t probe = 0; probe < max_probe_count; ++probe)
+		{
+			const keyword_entry &slot = slots[(first_slot + probe) & (SIZE - 1)];
+			if (slot.name.empty())
+				break;
+			if (slot.name == name)
+				return slot.id;
+		}
+
+		return tokenid::unknown;
+	}
+};
+
+template <size_t SIZE, size_t N>
+static constexpr keyword_table<SIZE> build_keyword_table(const keyword_entry (&entries)[N])
+{
+	static_assert(N < SIZE / 2, "keyword table is too full");
+
+	keyword_table<SIZE> table;
+	for (const keyword_entry &entry : entries)
+	{
+		// Resolve collisions with linear probing
+		uint32_t slot = keyword_table<SIZE>::hash(entry.name);
+		size_t probe_count = 1;
+		while (!table.slots[slot & (SIZE - 1)].name.empty())
+			slot++, probe_count++;
+
+		table.slots[slot & (SIZE - 1)] = entry;
+
+		if (probe_count > table.max_probe_count)
+			table.max_probe_count = probe_count;
+		if (entry.name.size() < table.min_name_length)
+			table.min_name_length = entry.name.size();
+		if (entry.name.size() > table.max_name_length)
+			table.max_name_length = entry.name.size();
+	}
+
+	return table;
+}
+
+static constexpr keyword_entry s_keyword_list[] = {
 	{ "_Pragma", tokenid::pragma },
 	{ "asm", tokenid::reserved },
 	{ "asm_fragment", tokenid::reserved },
@@ -495,7 +581,7 @@ static const std::unordered_map<std::string_view, tokenid> s_keyword_lookup = {
 	{ "volatile", tokenid::volatile_ },
 	{ "while", tokenid::while_ }
 };
-static const std::unordered_map<std::string_view, tokenid> s_pp_directive_lookup = {
+static constexpr keyword_entry s_pp_directive_list[] = {
 	{ "define", tokenid::hash_def },
 	{ "undef", tokenid::hash_undef },
 	{ "if", tokenid::hash_if },
@@ -510,6 +596,9 @@ static const std::unordered_map<std::string_view, tokenid> s_pp_directive_lookup
 	{ "include", tokenid::hash_include },
 };
 
+static constexpr auto s_keyword_lookup = build_keyword_table<1024>(s_keyword_list);
+static constexpr auto s_pp_directive_lookup = build_keyword_table<32>(s_pp_directive_list);
+
 static bool is_octal_digit(char c)
 {
 	return static_cast<unsigned>(c - '0') < 8;
@@ -558,6 +647,106 @@ static long long octal_to_decimal(long long n)
 	return n;
 }
 
+enum class scan_class
+{
+	space, // Space characters, excluding new line
+	identifier, // Characters that can continue an identifier
+	line, // Any character but new line
+	multi_line_comment, // Any character but new line and '*'
+};
+
+#if defined(RESHADEFX_LEXER_SSE2) || defined(RESHADEFX_LEXER_NEON)
+static unsigned int count_trailing_zeros(uint64_t value)
+{
+	assert(value != 0);
+#ifdef _MSC_VER
+	unsigned long index;
+	#ifdef _WIN64
+	_BitScanForward64(&index, value);
+	#else
+	_BitScanForward(&index, static_cast<unsigned long>(value)); // Only SSE2 is used on 32-bit, which produces 16-bit masks
+	#endif
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+#endif
+
+/// <summary>
+/// Counts how many of the next 16 characters at the specified position belong to the specified class, stopping at the first one that does not.
+/// The caller has to ensure that there are at least 16 characters left to read. Always returns zero when no SIMD instruction set is available.
+/// </summary>
+template <scan_class CLASS>
+static size_t scan_16(const char *p)
+{
+#if defined(RESHADEFX_LEXER_SSE2)
+	const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+	__m128i match;
+	if constexpr (CLASS == scan_class::space)
+		match = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			// Characters '\v', '\f' and '\r' are adjacent
+			_mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\v' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1))));
+	else if constexpr (CLASS == scan_class::identifier)
+	{
+		// Setting bit 5 maps upper case to lower case letters, without moving any other character into that range (values above 127 are negative in the signed comparison and thus excluded)
+		const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		match = _mm_or_si128(
+			_mm_or_si128(
+				_mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1))),
+				_mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)))),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+	}
+	else if constexpr (CLASS == scan_class::line)
+		match = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+	else if constexpr (CLASS == scan_class::multi_line_comment)
+		match = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('*')));
+
+	// Build a mask with one bit set for every character that stops the scan
+	unsigned int stop_mask = static_cast<unsigned int>(_mm_movemask_epi8(match));
+	if constexpr (CLASS == scan_class::space || CLASS == scan_class::identifier)
+		stop_mask ^= 0xFFFF;
+
+	return stop_mask != 0 ? count_trailing_zeros(stop_mask) : 16;
+#elif defined(RESHADEFX_LEXER_NEON)
+	const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+
+	uint8x16_t match;
+	if constexpr (CLASS == scan_class::space)
+		match = vorrq_u8(
+			vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+			// Characters '\v', '\f' and '\r' are adjacent
+			vandq_u8(vcgeq_u8(v, vdupq_n_u8('\v')), vcleq_u8(v, vdupq_n_u8('\r'))));
+	else if constexpr (CLASS == scan_class::identifier)
+	{
+		// Setting bit 5 maps upper case to lower case letters, without moving any other character into that range
+		const uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+		match = vorrq_u8(
+			vorrq_u8(
+				vandq_u8(vcgeq_u8(lower, vdupq_n_u8('a')), vcleq_u8(lower, vdupq_n_u8('z'))),
+				vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9')))),
+			vceqq_u8(v, vdupq_n_u8('_')));
+	}
+	else if constexpr (CLASS == scan_class::line)
+		match = vceqq_u8(v, vdupq_n_u8('\n'));
+	else if constexpr (CLASS == scan_class::multi_line_comment)
+		match = vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('*')));
+
+	// Build a mask with four bits set for every character that stops the scan (NEON has no equivalent to 'movemask', so narrow each byte to a nibble instead)
+	uint64_t stop_mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+	if constexpr (CLASS == scan_class::space || CLASS == scan_class::identifier)
+		stop_mask = ~stop_mask;
+
+	return stop_mask != 0 ? count_trailing_zeros(stop_mask) / 4 : 16;
+#else
+	// Let the caller fall back to scanning one character at a time
+	(void)p;
+	return 0;
+#endif
+}
+
 std::string reshadefx::token::id_to_name(tokenid id)
 {
 	const auto it = s_token_lookup.find(id);
@@ -577,7 +766,7 @@ next_token:
 	tok.offset = input_offset();
 	tok.length = 1;
 	tok.literal_as_double = 0;
-	tok.literal_as_string.clear();
+	tok.literal_as_string = {};
 
 	assert(_cur <= _end);
 
@@ -713,6 +902,16 @@ next_token:
 		{
 			while (_cur < _end)
 			{
+				// Skip characters that cannot end the comment 16 at a time
+				if (_end - _cur >= 16)
+				{
+					if (const size_t length = scan_16<scan_class::multi_line_comment>(_cur); length != 0)
+					{
+						skip(length);
+						continue;
+					}
+				}
+
 				if (*_cur == '\n')
 				{
 					_cur_location.line++;
@@ -853,6 +1052,16 @@ void reshadefx::lexer::skip_space()
 	// Skip each character until a space is found
 	while (_cur < _end)
 	{
+		// Skip runs of space characters 16 at a time
+		if (_end - _cur >= 16)
+		{
+			if (const size_t length = scan_16<scan_class::space>(_cur); length != 0)
+			{
+				skip(length);
+				continue;
+			}
+		}
+
 		if (_cur[0] == '\\' && (_cur[1] == '\n' || (_cur[1] == '\r' && _cur[2] == '\n')))
 		{
 			skip(_cur[1] == '\r' ? 3 : 2);
@@ -882,14 +1091,24 @@ void reshadefx::lexer::skip_to_next_line()
 		}
 #endif
 
+		// Skip to the new line feed 16 characters at a time
+		if (_end - _cur >= 16)
+		{
+			if (const size_t length = scan_16<scan_class::line>(_cur); length != 0)
+			{
+				skip(length);
+				continue;
+			}
+		}
+
 		skip(1);
 	}
 }
 
 void reshadefx::lexer::reset_to_offset(size_t offset)
 {
-	assert(offset < _input.size());
-	_cur = _input.data() + offset;
+	assert(offset < _input->size());
+	_cur = _input->data() + offset;
 }
 
 void reshadefx::lexer::parse_identifier(token &tok) const
@@ -897,20 +1116,27 @@ void reshadefx::lexer::parse_identifier(token &tok) const
 	auto *const begin = _cur, *end = begin;
 
 	// Skip to the end of the identifier sequence
+	while (_end - end >= 16)
+	{
+		const size_t length = scan_16<scan_class::identifier>(end);
+		end += length;
+		if (length != 16)
+			break;
+	}
 	while (s_type_lookup[uint8_t(*end)] == IDENT || s_type_lookup[uint8_t(*end)] == DIGIT)
 		end++;
 
 	tok.id = tokenid::identifier;
 	tok.offset = input_offset();
 	tok.length = end - begin;
-	tok.literal_as_string.assign(begin, end);
+	tok.literal_as_string = std::string_view(begin, tok.length);
 
 	if (_ignore_keywords)
 		return;
 
-	if (const auto it = s_keyword_lookup.find(tok.literal_as_string);
-		it != s_keyword_lookup.end())
-		tok.id = it->second;
+	if (const tokenid id = s_keyword_lookup.find(tok.literal_as_string);
+		id != tokenid::unknown)
+		tok.id = id;
 }
 bool reshadefx::lexer::parse_pp_directive(token &tok)
 {
@@ -918,10 +1144,10 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 	skip_space(); // Skip any space between the '#' and directive
 	parse_identifier(tok);
 
-	if (const auto it = s_pp_directive_lookup.find(tok.literal_as_string);
-		it != s_pp_directive_lookup.end())
+	if (const tokenid id = s_pp_directive_lookup.find(tok.literal_as_string);
+		id != tokenid::unknown)
 	{
-		tok.id = it->second;
+		tok.id = id;
 		return true;
 	}
 	else if (!_ignore_line_directives && tok.literal_as_string == "line") // The #line directive needs special handling
@@ -945,7 +1171,7 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 			token temptok;
 			parse_string_literal(temptok, false);
 
-			_cur_location.source = std::move(temptok.literal_as_string);
+			_cur_location.source = temptok.literal_as_string;
 		}
 
 		// Do not return the #line directive as token to the caller
@@ -959,8 +1185,18 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 {
 	auto *const begin = _cur, *end = begin + 1; // Skip first quote character right away
-
-	for (auto c = *end; c != '"'; c = *++end)
+	auto *literal_end = end;
+
+	// The literal value is only copied into a separate string once it starts to differ from the input string (e.g. due to escape sequences)
+	std::string literal;
+	bool is_verbatim = true;
+	const auto make_literal_copy = [&]() {
+		if (is_verbatim)
+			literal.assign(begin + 1, end);
+		is_verbatim = false;
+	};
+
+	for (auto c = *end; c != '"'; c = *++end, literal_end = end)
 	{
 		if (c == '\n' || end >= _end)
 		{
@@ -973,6 +1209,7 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 		if (c == '\r')
 		{
 			// Silently ignore carriage return characters
+			make_literal_copy();
 			continue;
 		}
 
@@ -980,6 +1217,7 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 			c == '\\' && end[n] == '\n')
 		{
 			// Escape character found at end of line, the string literal continues on to the next line
+			make_literal_copy();
 			end += n;
 			_cur_location.line++;
 			continue;
@@ -988,6 +1226,8 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 		// Handle escape sequences
 		if (c == '\\' && escape)
 		{
+			make_literal_copy();
+
 			unsigned int n = 0;
 
 			// Any character following the '\' is not parsed as usual, so increment pointer here (this makes sure '\"' does not abort the outer loop as well)
@@ -1050,14 +1290,18 @@ void reshadefx::lexer::parse_string_literal(token &tok, bool escape)
 			}
 		}
 
-		tok.literal_as_string += c;
+		if (!is_verbatim)
+			literal += c;
 	}
 
 	tok.id = tokenid::string_literal;
 	tok.length = end - begin + 1;
 
-	// Free up unused memory
-	tok.literal_as_string.shrink_to_fit();
+	if (is_verbatim)
+		tok.literal_as_string = std::string_view(begin + 1, literal_end - (begin + 1));
+	else
+		// Keep modified literals alive for as long as this lexer exists, so that the token can reference them
+		tok.literal_as_string = *_escaped_string_literals.insert(std::move(literal)).first;
 }
 void reshadefx::lexer::parse_numeric_literal(token &tok) const
 {
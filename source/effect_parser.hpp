@@ -24,8 +24,9 @@ namespace reshadefx
 		/// </summary>
 		/// <param name="source">Source code string to parse.</param>
 		/// <param name="backend">Code generation implementation to use.</param>
+		/// <param name="optimize">Remove redundant and unused values from every function before passing it on to the code generation implementation.</param>
 		/// <returns><see langword="true"/> if parsing was successfull, <see langword="false"/> otherwise.</returns>
-		bool parse(std::string source, class codegen *backend);
+		bool parse(std::string source, class codegen *backend, bool optimize = false);
 
 		/// <summary>
 		/// Gets the list of error messages.
@@ -72,6 +73,7 @@ namespace reshadefx
 		bool parse_annotations(std::vector<annotation> &annotations);
 		bool parse_statement(bool scoped);
 		bool parse_statement_block(bool scoped);
+		bool accept_unrolled_for_loop(bool force, bool &parse_success);
 
 		std::string _errors;
 
@@ -8,7 +8,7 @@
 #include "effect_codegen.hpp"
 #include <cassert>
 #include <iterator> // std::back_inserter
-#include <algorithm> // std::find_if, std::lower_bound, std::set_union
+#include <algorithm> // std::all_of, std::find_if, std::lower_bound, std::set_union
 
 #define RESHADEFX_SHORT_CIRCUIT 0
 
@@ -99,14 +99,15 @@ bool reshadefx::parser::accept_symbol(std::string &identifier, scoped_symbol &sy
 		return false;
 	}
 
-	identifier = std::move(_token.literal_as_string);
+	identifier = _token.literal_as_string;
 
 	// Can concatenate multiple '::' to force symbol search for a specific namespace level
 	while (accept(tokenid::colon_colon))
 	{
 		if (!expect(tokenid::identifier))
 			return false;
-		identifier += "::" + std::move(_token.literal_as_string);
+		identifier += "::";
+		identifier += _token.literal_as_string;
 	}
 
 	// Figure out which scope to start searching in
@@ -755,7 +756,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 	else if (accept('{'))
 	{
 		bool is_constant = true;
-		std::vector<expression> elements;
+		std::pmr::vector<expression> elements(expression_arena_scope::current_resource());
 		type composite_type = { type::t_void, 1, 1 };
 
 		while (!peek('}'))
@@ -861,7 +862,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 	}
 	else if (accept(tokenid::string_literal))
 	{
-		std::string value = std::move(_token.literal_as_string);
+		std::string value(_token.literal_as_string);
 
 		// Multiple string literals in sequence are concatenated into a single string literal
 		while (accept(tokenid::string_literal))
@@ -890,7 +891,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 		// Parse entire argument expression list
 		bool is_constant = true;
 		unsigned int num_components = 0;
-		std::vector<expression> arguments;
+		std::pmr::vector<expression> arguments(expression_arena_scope::current_resource());
 
 		while (!peek(')'))
 		{
@@ -1008,7 +1009,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 			}
 
 			// Parse entire argument expression list
-			std::vector<expression> arguments;
+			std::pmr::vector<expression> arguments(expression_arena_scope::current_resource());
 
 			while (!peek(')'))
 			{
@@ -1030,13 +1031,6 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 			if (!expect(')'))
 				return false;
 
-			// Function calls can only be made from within functions
-			if (!_codegen->is_in_function())
-			{
-				error(location, 3005, "invalid function call outside of a function");
-				return false;
-			}
-
 			// Try to resolve the call by searching through both function symbols and intrinsics
 			bool undeclared = !symbol.id, ambiguous = false;
 
@@ -1053,139 +1047,169 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 
 			assert(symbol.function != nullptr);
 
-			std::vector<expression> parameters(symbol.function->parameter_list.size());
-
-			// We need to allocate some temporary variables to pass in and load results from pointer parameters
-			for (size_t i = 0; i < arguments.size(); ++i)
+			// Evaluate calls to pure math intrinsics with constant arguments at compile time
+			bool is_folded = false;
+			if (symbol.op == symbol_type::intrinsic && !precise && std::all_of(arguments.begin(), arguments.end(), [](const expression &argument_exp) { return argument_exp.is_constant && !argument_exp.type.is_array(); }))
 			{
-				const auto &param_type = symbol.function->parameter_list[i].type;
+				std::pmr::vector<expression> constant_arguments(arguments.begin(), arguments.end(), expression_arena_scope::current_resource());
+				for (size_t i = 0; i < constant_arguments.size(); ++i)
+					constant_arguments[i].add_cast_operation(symbol.function->parameter_list[i].type);
+
+				if (constant result; evaluate_constant_intrinsic_call(symbol.id, symbol.type, constant_arguments, result))
+				{
+					// Only warn once the call was folded, since otherwise the regular path below does so
+					for (size_t i = 0; i < arguments.size(); ++i)
+						if (arguments[i].type.components() > symbol.function->parameter_list[i].type.components())
+							warning(arguments[i].location, 3206, "implicit truncation of vector type");
 
-				if (param_type.has(type::q_out) && (!arguments[i].is_lvalue || (arguments[i].type.has(type::q_const) && !arguments[i].type.is_object())))
+					exp.reset_to_rvalue_constant(location, std::move(result), symbol.type);
+					is_folded = true;
+				}
+			}
+
+			if (!is_folded)
+			{
+				// Function calls can only be made from within functions
+				if (!_codegen->is_in_function())
 				{
-					error(arguments[i].location, 3025, "l-value specifies const object for an 'out' parameter");
+					error(location, 3005, "invalid function call outside of a function");
 					return false;
 				}
 
-				if (arguments[i].type.components() > param_type.components())
-					warning(arguments[i].location, 3206, "implicit truncation of vector type");
+				std::pmr::vector<expression> parameters(symbol.function->parameter_list.size(), expression_arena_scope::current_resource());
 
-				if (symbol.op == symbol_type::function || param_type.has(type::q_out))
+				// We need to allocate some temporary variables to pass in and load results from pointer parameters
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					if (param_type.is_object() || param_type.has(type::q_groupshared) /* Special case for atomic intrinsics */)
-					{
-						if (arguments[i].type != param_type)
-						{
-							error(location, 3004, "no matching intrinsic overload for '" + identifier + '\'');
-							return false;
-						}
+					const auto &param_type = symbol.function->parameter_list[i].type;
 
-						assert(arguments[i].is_lvalue);
+					if (param_type.has(type::q_out) && (!arguments[i].is_lvalue || (arguments[i].type.has(type::q_const) && !arguments[i].type.is_object())))
+					{
+						error(arguments[i].location, 3025, "l-value specifies const object for an 'out' parameter");
+						return false;
+					}
 
-						// Do not shadow object or pointer parameters to function calls
-						size_t chain_index = 0;
-						const codegen::id access_chain = _codegen->emit_access_chain(arguments[i], chain_index);
-						parameters[i].reset_to_lvalue(arguments[i].location, access_chain, param_type);
-						assert(chain_index == arguments[i].chain.size());
+					if (arguments[i].type.components() > param_type.components())
+						warning(arguments[i].location, 3206, "implicit truncation of vector type");
 
-						// This is referencing a l-value, but want to avoid copying below
-						parameters[i].is_lvalue = false;
+					if (symbol.op == symbol_type::function || param_type.has(type::q_out))
+					{
+						if (param_type.is_object() || param_type.has(type::q_groupshared) /* Special case for atomic intrinsics */)
+						{
+							if (arguments[i].type != param_type)
+							{
+								error(location, 3004, "no matching intrinsic overload for '" + identifier + '\'');
+								return false;
+							}
+
+							assert(arguments[i].is_lvalue);
+
+							// Do not shadow object or pointer parameters to function calls
+							size_t chain_index = 0;
+							const codegen::id access_chain = _codegen->emit_access_chain(arguments[i], chain_index);
+							parameters[i].reset_to_lvalue(arguments[i].location, access_chain, param_type);
+							assert(chain_index == arguments[i].chain.size());
+
+							// This is referencing a l-value, but want to avoid copying below
+							parameters[i].is_lvalue = false;
+						}
+						else
+						{
+							// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
+							const codegen::id temp_variable = _codegen->define_variable(arguments[i].location, param_type);
+							parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
+						}
 					}
 					else
 					{
-						// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
-						const codegen::id temp_variable = _codegen->define_variable(arguments[i].location, param_type);
-						parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
-					}
-				}
-				else
-				{
-					expression argument_exp = arguments[i];
-					argument_exp.add_cast_operation(param_type);
-					const codegen::id argument_value = _codegen->emit_load(argument_exp);
-					parameters[i].reset_to_rvalue(argument_exp.location, argument_value, param_type);
+						expression argument_exp = arguments[i];
+						argument_exp.add_cast_operation(param_type);
+						const codegen::id argument_value = _codegen->emit_load(argument_exp);
+						parameters[i].reset_to_rvalue(argument_exp.location, argument_value, param_type);
 
-					// Keep track of whether the parameter is a constant for code generation (this makes the expression invalid for all other uses)
-					parameters[i].is_constant = argument_exp.is_constant;
+						// Keep track of whether the parameter is a constant for code generation (this makes the expression invalid for all other uses)
+						parameters[i].is_constant = argument_exp.is_constant;
+					}
 				}
-			}
 
-			// Copy in parameters from the argument access chains to parameter variables
-			for (size_t i = 0; i < arguments.size(); ++i)
-			{
-				// Only do this for pointer parameters as discovered above
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in) && !parameters[i].type.is_object())
+				// Copy in parameters from the argument access chains to parameter variables
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					expression argument_exp = arguments[i];
-					argument_exp.add_cast_operation(parameters[i].type);
-					const codegen::id argument_value = _codegen->emit_load(argument_exp);
-					_codegen->emit_store(parameters[i], argument_value);
+					// Only do this for pointer parameters as discovered above
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in) && !parameters[i].type.is_object())
+					{
+						expression argument_exp = arguments[i];
+						argument_exp.add_cast_operation(parameters[i].type);
+						const codegen::id argument_value = _codegen->emit_load(argument_exp);
+						_codegen->emit_store(parameters[i], argument_value);
+					}
 				}
-			}
 
-			// Add remaining default arguments
-			for (size_t i = arguments.size(); i < parameters.size(); ++i)
-			{
-				assert(symbol.op == symbol_type::function);
+				// Add remaining default arguments
+				for (size_t i = arguments.size(); i < parameters.size(); ++i)
+				{
+					assert(symbol.op == symbol_type::function);
 
-				const auto &param = symbol.function->parameter_list[i];
-				assert(param.has_default_value || !_errors.empty());
+					const auto &param = symbol.function->parameter_list[i];
+					assert(param.has_default_value || !_errors.empty());
 
-				const codegen::id temp_variable = _codegen->define_variable(param.location, param.type);
-				parameters[i].reset_to_lvalue(param.location, temp_variable, param.type);
+					const codegen::id temp_variable = _codegen->define_variable(param.location, param.type);
+					parameters[i].reset_to_lvalue(param.location, temp_variable, param.type);
 
-				const codegen::id argument_value = _codegen->emit_constant(param.type, param.default_value);
-				_codegen->emit_store(parameters[i], argument_value);
-			}
+					const codegen::id argument_value = _codegen->emit_constant(param.type, param.default_value);
+					_codegen->emit_store(parameters[i], argument_value);
+				}
 
-			if (precise)
-				symbol.type.qualifiers |= type::q_precise;
+				if (precise)
+					symbol.type.qualifiers |= type::q_precise;
 
-			// Check if the call resolving found an intrinsic or function and invoke the corresponding code
-			const codegen::id result = (symbol.op == symbol_type::function) ?
-				_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
-				_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
+				// Check if the call resolving found an intrinsic or function and invoke the corresponding code
+				const codegen::id result = (symbol.op == symbol_type::function) ?
+					_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
+					_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
 
-			exp.reset_to_rvalue(location, result, symbol.type);
+				exp.reset_to_rvalue(location, result, symbol.type);
 
-			// Copy out parameters from parameter variables back to the argument access chains
-			for (size_t i = 0; i < arguments.size(); ++i)
-			{
-				// Only do this for pointer parameters as discovered above
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out) && !parameters[i].type.is_object())
+				// Copy out parameters from parameter variables back to the argument access chains
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					expression argument_exp = parameters[i];
-					argument_exp.add_cast_operation(arguments[i].type);
-					const codegen::id argument_value = _codegen->emit_load(argument_exp);
-					_codegen->emit_store(arguments[i], argument_value);
+					// Only do this for pointer parameters as discovered above
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out) && !parameters[i].type.is_object())
+					{
+						expression argument_exp = parameters[i];
+						argument_exp.add_cast_operation(arguments[i].type);
+						const codegen::id argument_value = _codegen->emit_load(argument_exp);
+						_codegen->emit_store(arguments[i], argument_value);
+					}
 				}
-			}
 
-			if (_codegen->_current_function != nullptr && symbol.op == symbol_type::function)
-			{
-				// Calling a function makes the caller inherit all sampler and storage object references from the callee
-				if (!symbol.function->referenced_samplers.empty())
+				if (_codegen->_current_function != nullptr && symbol.op == symbol_type::function)
 				{
-					std::vector<codegen::id> referenced_samplers;
-					referenced_samplers.reserve(_codegen->_current_function->referenced_samplers.size() + symbol.function->referenced_samplers.size());
-					std::set_union(_codegen->_current_function->referenced_samplers.begin(), _codegen->_current_function->referenced_samplers.end(), symbol.function->referenced_samplers.begin(), symbol.function->referenced_samplers.end(), std::back_inserter(referenced_samplers));
-					_codegen->_current_function->referenced_samplers = std::move(referenced_samplers);
-				}
-				if (!symbol.function->referenced_storages.empty())
-				{
-					std::vector<codegen::id> referenced_storages;
-					referenced_storages.reserve(_codegen->_current_function->referenced_storages.size() + symbol.function->referenced_storages.size());
-					std::set_union(_codegen->_current_function->referenced_storages.begin(), _codegen->_current_function->referenced_storages.end(), symbol.function->referenced_storages.begin(), symbol.function->referenced_storages.end(), std::back_inserter(referenced_storages));
-					_codegen->_current_function->referenced_storages = std::move(referenced_storages);
-				}
+					// Calling a function makes the caller inherit all sampler and storage object references from the callee
+					if (!symbol.function->referenced_samplers.empty())
+					{
+						std::vector<codegen::id> referenced_samplers;
+						referenced_samplers.reserve(_codegen->_current_function->referenced_samplers.size() + symbol.function->referenced_samplers.size());
+						std::set_union(_codegen->_current_function->referenced_samplers.begin(), _codegen->_current_function->referenced_samplers.end(), symbol.function->referenced_samplers.begin(), symbol.function->referenced_samplers.end(), std::back_inserter(referenced_samplers));
+						_codegen->_current_function->referenced_samplers = std::move(referenced_samplers);
+					}
+					if (!symbol.function->referenced_storages.empty())
+					{
+						std::vector<codegen::id> referenced_storages;
+						referenced_storages.reserve(_codegen->_current_function->referenced_storages.size() + symbol.function->referenced_storages.size());
+						std::set_union(_codegen->_current_function->referenced_storages.begin(), _codegen->_current_function->referenced_storages.end(), symbol.function->referenced_storages.begin(), symbol.function->referenced_storages.end(), std::back_inserter(referenced_storages));
+						_codegen->_current_function->referenced_storages = std::move(referenced_storages);
+					}
 
-				// Add callee and all its function references to the callers function references
-				{
-					std::vector<codegen::id> referenced_functions;
-					std::set_union(_codegen->_current_function->referenced_functions.begin(), _codegen->_current_function->referenced_functions.end(), symbol.function->referenced_functions.begin(), symbol.function->referenced_functions.end(), std::back_inserter(referenced_functions));
-					const auto it = std::lower_bound(referenced_functions.begin(), referenced_functions.end(), symbol.id);
-					if (it == referenced_functions.end() || *it != symbol.id)
-						referenced_functions.insert(it, symbol.id);
-					_codegen->_current_function->referenced_functions = std::move(referenced_functions);
+					// Add callee and all its function references to the callers function references
+					{
+						std::vector<codegen::id> referenced_functions;
+						std::set_union(_codegen->_current_function->referenced_functions.begin(), _codegen->_current_function->referenced_functions.end(), symbol.function->referenced_functions.begin(), symbol.function->referenced_functions.end(), std::back_inserter(referenced_functions));
+						const auto it = std::lower_bound(referenced_functions.begin(), referenced_functions.end(), symbol.id);
+						if (it == referenced_functions.end() || *it != symbol.id)
+							referenced_functions.insert(it, symbol.id);
+						_codegen->_current_function->referenced_functions = std::move(referenced_functions);
+					}
 				}
 			}
 		}
@@ -1271,7 +1295,7 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 				return false;
 
 			location = std::move(_token.location);
-			const std::string subscript = std::move(_token.literal_as_string);
+			const std::string subscript(_token.literal_as_string);
 
 			if (accept('(')) // Methods (function calls on types) are not supported right now
 			{
@@ -10,7 +10,7 @@
 #include <cctype> // std::toupper
 #include <cassert>
 #include <iterator> // std::back_inserter
-#include <algorithm> // std::max, std::replace, std::transform
+#include <algorithm> // std::max, std::replace, std::stable_sort, std::transform
 #include <string_view>
 
 template <typename ENTER_TYPE, typename LEAVE_TYPE>
@@ -24,10 +24,18 @@ private:
 	LEAVE_TYPE leave_lambda;
 };
 
-bool reshadefx::parser::parse(std::string source, codegen *backend)
+bool reshadefx::parser::parse(std::string source, codegen *backend, bool optimize)
 {
+	// Expressions only exist while parsing, so allocate them from an arena that is released in bulk at the end
+	const expression_arena_scope arena_scope;
+
+	// The optimizer passes everything on to the back-end and hands its state back to it when destroyed at the end of parsing
+	std::unique_ptr<codegen> optimizer;
+	if (optimize)
+		optimizer.reset(create_codegen_optimizer(backend));
+
 	_lexer = new lexer(std::move(source));
-	_codegen = backend;
+	_codegen = optimize ? optimizer.get() : backend;
 
 	consume();
 
@@ -50,8 +58,12 @@ bool reshadefx::parser::parse(std::string source, codegen *backend)
 
 	delete _lexer;
 
+	optimizer.reset();
+	_codegen = backend;
+
 	if (parse_success)
 	{
+		backend->optimize_uniform_layout();
 		backend->optimize_bindings();
 
 		assert(_loop_break_target_stack.empty() && _loop_continue_target_stack.empty());
@@ -70,7 +82,7 @@ bool reshadefx::parser::parse_top(bool &parse_success)
 		if (!expect('(') || !expect(tokenid::string_literal))
 			return false;
 
-		_codegen->emit_pragma(_token.literal_as_string);
+		_codegen->emit_pragma(std::string(_token.literal_as_string));
 
 		if (!expect(')'))
 			return false;
@@ -82,7 +94,7 @@ bool reshadefx::parser::parse_top(bool &parse_success)
 		if (!expect(tokenid::identifier))
 			return false;
 
-		const std::string name = std::move(_token.literal_as_string);
+		const std::string name(_token.literal_as_string);
 
 		if (!expect('{'))
 			return false;
@@ -131,7 +143,7 @@ bool reshadefx::parser::parse_top(bool &parse_success)
 			if (!expect(tokenid::identifier))
 				return false;
 
-			const std::string attribute = std::move(_token.literal_as_string);
+			const std::string attribute(_token.literal_as_string);
 
 			if (attribute == "shader")
 			{
@@ -197,7 +209,7 @@ bool reshadefx::parser::parse_top(bool &parse_success)
 
 			if (peek('('))
 			{
-				const std::string name = std::move(_token.literal_as_string);
+				const std::string name(_token.literal_as_string);
 
 				// This is definitely a function declaration, so parse it
 				if (!parse_function(type, name, stype, num_threads))
@@ -226,7 +238,7 @@ bool reshadefx::parser::parse_top(bool &parse_success)
 						return false;
 					}
 
-					const std::string name = std::move(_token.literal_as_string);
+					const std::string name(_token.literal_as_string);
 
 					if (!parse_variable(type, name, true))
 					{
@@ -271,23 +283,23 @@ bool reshadefx::parser::parse_statement(bool scoped)
 		return false;
 	}
 
+	enum control_mask
+	{
+		unroll = 0x1,
+		dont_unroll = 0x2,
+		flatten = (0x1 << 4),
+		dont_flatten = (0x2 << 4),
+		switch_force_case = (0x4 << 4),
+		switch_call = (0x8 << 4)
+	};
+
 	unsigned int loop_control = 0;
 	unsigned int selection_control = 0;
 
 	// Read any loop and branch control attributes first
 	while (accept('['))
 	{
-		enum control_mask
-		{
-			unroll = 0x1,
-			dont_unroll = 0x2,
-			flatten = (0x1 << 4),
-			dont_flatten = (0x2 << 4),
-			switch_force_case = (0x4 << 4),
-			switch_call = (0x8 << 4)
-		};
-
-		const std::string attribute = std::move(_token_next.literal_as_string);
+		const std::string attribute(_token_next.literal_as_string);
 
 		if (!expect(tokenid::identifier) || !expect(']'))
 			return false;
@@ -525,6 +537,10 @@ bool reshadefx::parser::parse_statement(bool scoped)
 
 		if (accept(tokenid::for_))
 		{
+			// Loops with a constant number of iterations are replaced with a copy of their body for every iteration if requested or if they are small enough
+			if (bool parse_success = true; (loop_control & dont_unroll) == 0 && accept_unrolled_for_loop((loop_control & unroll) != 0, parse_success))
+				return parse_success;
+
 			if (!expect('('))
 				return false;
 
@@ -542,7 +558,7 @@ bool reshadefx::parser::parse_statement(bool scoped)
 					if (count++ > 0 && !expect(','))
 						return false;
 
-					if (!expect(tokenid::identifier) || !parse_variable(type, std::move(_token.literal_as_string)))
+					if (!expect(tokenid::identifier) || !parse_variable(type, std::string(_token.literal_as_string)))
 						return false;
 				}
 				while (!peek(';'));
@@ -897,7 +913,7 @@ bool reshadefx::parser::parse_statement(bool scoped)
 				return false;
 			}
 
-			if (!expect(tokenid::identifier) || !parse_variable(type, std::move(_token.literal_as_string)))
+			if (!expect(tokenid::identifier) || !parse_variable(type, std::string(_token.literal_as_string)))
 			{
 				consume_until(';');
 				return false;
@@ -964,6 +980,339 @@ bool reshadefx::parser::parse_statement_block(bool scoped)
 	return expect('}');
 }
 
+bool reshadefx::parser::accept_unrolled_for_loop(bool force, bool &parse_success)
+{
+	// Maximum number of iterations to unroll a loop with the 'unroll' attribute for
+	const size_t max_forced_iterations = 1024;
+	// Maximum number of tokens the body of a loop without attributes may have in total across all iterations to still be unrolled
+	const size_t max_unrolled_tokens = 512;
+
+	// Remember where the loop starts, so that it can be parsed as a regular loop again if it turns out it cannot be unrolled
+	const lexer loop_lexer = *_lexer;
+	const token loop_token = _token;
+	const token loop_token_next = _token_next;
+	const size_t loop_errors_length = _errors.size();
+
+	const auto reject = [&]() {
+		*_lexer = loop_lexer;
+		_token = loop_token;
+		_token_next = loop_token_next;
+		_errors.resize(loop_errors_length);
+		return false;
+	};
+
+	// Only expressions made up of literals and named constants are allowed in the loop header, since those can be evaluated without generating any code
+	const auto parse_constant_expression = [this](tokenid terminator, expression &exp) {
+		const lexer expression_lexer = *_lexer;
+		const token expression_token = _token;
+		const token expression_token_next = _token_next;
+
+		unsigned int level = 0;
+		bool is_constant = !peek(terminator);
+		while (is_constant && (level != 0 || !peek(terminator)))
+		{
+			consume();
+
+			switch (_token.id)
+			{
+			case tokenid::parenthesis_open:
+				++level;
+				break;
+			case tokenid::parenthesis_close:
+				is_constant = level-- != 0;
+				break;
+			case tokenid::identifier:
+				is_constant = !peek('(') && find_symbol(std::string(_token.literal_as_string)).op == symbol_type::constant;
+				break;
+			case tokenid::int_literal:
+			case tokenid::uint_literal:
+			case tokenid::plus:
+			case tokenid::minus:
+			case tokenid::star:
+			case tokenid::slash:
+			case tokenid::percent:
+			case tokenid::less_less:
+			case tokenid::greater_greater:
+			case tokenid::ampersand:
+			case tokenid::pipe:
+			case tokenid::caret:
+			case tokenid::tilde:
+				break;
+			default:
+				is_constant = false;
+				break;
+			}
+		}
+
+		*_lexer = expression_lexer;
+		_token = expression_token;
+		_token_next = expression_token_next;
+
+		return is_constant && parse_expression(exp) && exp.is_constant && exp.type.is_scalar() && exp.type.is_integral() && accept(terminator);
+	};
+
+	// The loop has to be of the form "for (int i = <constant>; i <comparison> <constant>; <increment or decrement of i>)"
+	if (!accept('('))
+		return reject();
+
+	type counter_type = {};
+	if (accept(tokenid::int_))
+		counter_type = { type::t_int, 1, 1, type::q_const };
+	else if (accept(tokenid::uint_))
+		counter_type = { type::t_uint, 1, 1, type::q_const };
+	else
+		return reject();
+
+	if (!accept(tokenid::identifier))
+		return reject();
+
+	const std::string counter_name(_token.literal_as_string);
+	const auto accept_counter = [this, &counter_name]() {
+		return peek(tokenid::identifier) && _token_next.literal_as_string == counter_name && accept(tokenid::identifier);
+	};
+
+	expression initializer_exp;
+	if (!accept('=') || !parse_constant_expression(tokenid::semicolon, initializer_exp))
+		return reject();
+
+	if (!accept_counter())
+		return reject();
+
+	const tokenid comparison = _token_next.id;
+	if (comparison != tokenid::less && comparison != tokenid::less_equal && comparison != tokenid::greater && comparison != tokenid::greater_equal && comparison != tokenid::exclaim_equal)
+		return reject();
+	consume();
+
+	expression condition_exp;
+	if (!parse_constant_expression(tokenid::semicolon, condition_exp))
+		return reject();
+
+	bool decrement = false;
+	expression step_exp;
+	if (accept(tokenid::plus_plus) || accept(tokenid::minus_minus))
+	{
+		decrement = _token.id == tokenid::minus_minus;
+		step_exp.reset_to_rvalue_constant(_token.location, 1u);
+
+		if (!accept_counter() || !accept(')'))
+			return reject();
+	}
+	else if (accept_counter())
+	{
+		if (accept(tokenid::plus_plus) || accept(tokenid::minus_minus))
+		{
+			decrement = _token.id == tokenid::minus_minus;
+			step_exp.reset_to_rvalue_constant(_token.location, 1u);
+
+			if (!accept(')'))
+				return reject();
+		}
+		else if (accept(tokenid::plus_equal) || accept(tokenid::minus_equal))
+		{
+			decrement = _token.id == tokenid::minus_equal;
+
+			if (!parse_constant_expression(tokenid::parenthesis_close, step_exp))
+				return reject();
+		}
+		else
+		{
+			return reject();
+		}
+	}
+	else
+	{
+		return reject();
+	}
+
+	// The comparison is done in the type both sides are promoted to, like in any other binary expression (so e.g. "int i < 4u" compares as unsigned)
+	const type comparison_type = type::merge(counter_type, condition_exp.type);
+
+	initializer_exp.add_cast_operation(counter_type);
+	condition_exp.add_cast_operation(comparison_type);
+	step_exp.add_cast_operation(counter_type);
+
+	// Evaluate the loop in the type of the counter variable, so that the number of iterations matches what would happen at runtime (including wrap around)
+	const uint32_t condition_value = condition_exp.constant.as_uint[0];
+	const auto evaluate_condition = [&](uint32_t value) {
+		if (comparison_type.is_signed())
+		{
+			const int32_t lhs = static_cast<int32_t>(value);
+			const int32_t rhs = static_cast<int32_t>(condition_value);
+			switch (comparison)
+			{
+			case tokenid::less:
+				return lhs < rhs;
+			case tokenid::less_equal:
+				return lhs <= rhs;
+			case tokenid::greater:
+				return lhs > rhs;
+			case tokenid::greater_equal:
+				return lhs >= rhs;
+			default:
+				return lhs != rhs;
+			}
+		}
+		else
+		{
+			switch (comparison)
+			{
+			case tokenid::less:
+				return value < condition_value;
+			case tokenid::less_equal:
+				return value <= condition_value;
+			case tokenid::greater:
+				return value > condition_value;
+			case tokenid::greater_equal:
+				return value >= condition_value;
+			default:
+				return value != condition_value;
+			}
+		}
+	};
+
+	const uint32_t step_value = decrement ? 0u - step_exp.constant.as_uint[0] : step_exp.constant.as_uint[0];
+
+	std::vector<uint32_t> counter_values;
+	for (uint32_t value = initializer_exp.constant.as_uint[0]; evaluate_condition(value); value += step_value)
+	{
+		if (counter_values.size() == max_forced_iterations)
+			return reject();
+
+		counter_values.push_back(value);
+	}
+
+	// Loops that never execute are left to the regular loop code, so that their body is still checked for errors
+	if (counter_values.empty())
+		return reject();
+
+	// Scan over the loop body to check that it does not contain any control flow that would need to leave an iteration early, no static variables and that it never writes to the counter variable
+	const lexer body_lexer = *_lexer;
+	const token body_token = _token;
+	const token body_token_next = _token_next;
+
+	const bool is_block = peek('{');
+	size_t body_length = 0;
+	unsigned int level = 0;
+	// Whether each open parenthesis belongs to a call, in which case the counter variable could be passed to an 'out' parameter
+	std::vector<bool> parentheses;
+
+	for (bool end_of_body = false; !end_of_body; ++body_length)
+	{
+		if (peek(tokenid::end_of_file))
+			return reject();
+
+		const tokenid prev_token = _token.id;
+		consume();
+
+		switch (_token.id)
+		{
+		case tokenid::brace_open:
+			++level;
+			break;
+		case tokenid::brace_close:
+			if (level == 0)
+				return reject();
+			end_of_body = --level == 0 && is_block;
+			break;
+		case tokenid::parenthesis_open:
+			parentheses.push_back(prev_token == tokenid::identifier);
+			break;
+		case tokenid::parenthesis_close:
+			if (!parentheses.empty())
+				parentheses.pop_back();
+			break;
+		case tokenid::semicolon:
+			end_of_body = level == 0 && parentheses.empty() && !is_block;
+			break;
+		case tokenid::for_:
+		case tokenid::while_:
+		case tokenid::do_:
+		case tokenid::if_:
+		case tokenid::switch_:
+			// Only allow nested control flow when the body is a block, so that it is easy to tell where the body ends
+			if (!is_block)
+				return reject();
+			break;
+		case tokenid::break_:
+		case tokenid::continue_:
+		case tokenid::return_:
+		case tokenid::discard_:
+		// Static local variables keep their value across iterations, which would not work with a separate copy of them in every unrolled iteration
+		case tokenid::static_:
+			return reject();
+		case tokenid::identifier:
+			if (_token.literal_as_string != counter_name || prev_token == tokenid::dot)
+				break;
+			if (prev_token == tokenid::plus_plus || prev_token == tokenid::minus_minus)
+				return reject();
+			switch (_token_next.id)
+			{
+			case tokenid::equal:
+			case tokenid::plus_equal:
+			case tokenid::minus_equal:
+			case tokenid::star_equal:
+			case tokenid::slash_equal:
+			case tokenid::percent_equal:
+			case tokenid::ampersand_equal:
+			case tokenid::pipe_equal:
+			case tokenid::caret_equal:
+			case tokenid::less_less_equal:
+			case tokenid::greater_greater_equal:
+			case tokenid::plus_plus:
+			case tokenid::minus_minus:
+			case tokenid::dot:
+			case tokenid::bracket_open:
+				return reject();
+			default:
+				break;
+			}
+			if (!parentheses.empty() && parentheses.back() && (prev_token == tokenid::parenthesis_open || prev_token == tokenid::comma) && (peek(',') || peek(')')))
+				return reject();
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!force && counter_values.size() * body_length > max_unrolled_tokens)
+		return reject();
+
+	// Parse the body once for every iteration, with the counter variable replaced by a named constant holding the value for that iteration
+	// Diagnostics are only kept for the first iteration, since later ones would just repeat the same warnings
+	size_t first_iteration_errors_length = std::string::npos;
+
+	for (const uint32_t value : counter_values)
+	{
+		*_lexer = body_lexer;
+		_token = body_token;
+		_token_next = body_token_next;
+
+		enter_scope();
+
+		symbol counter = { symbol_type::constant, 0, counter_type };
+		counter.constant.as_uint[0] = value;
+		insert_symbol(counter_name, counter);
+
+		const bool iteration_success = parse_statement(false);
+
+		leave_scope();
+
+		if (!iteration_success)
+		{
+			parse_success = false;
+			return true;
+		}
+
+		if (first_iteration_errors_length == std::string::npos)
+			first_iteration_errors_length = _errors.size();
+		else
+			_errors.resize(first_iteration_errors_length);
+	}
+
+	parse_success = true;
+	return true;
+}
+
 bool reshadefx::parser::parse_type(type &type)
 {
 	type.qualifiers = 0;
@@ -1046,7 +1395,7 @@ bool reshadefx::parser::parse_annotations(std::vector<annotation> &annotations)
 			return false;
 		}
 
-		std::string name = std::move(_token.literal_as_string);
+		std::string name(_token.literal_as_string);
 
 		expression annotation_exp;
 		if (!expect('=') || !parse_expression_multary(annotation_exp) || !expect(';'))
@@ -1076,7 +1425,7 @@ bool reshadefx::parser::parse_struct()
 	struct_type info;
 	// The structure name is optional
 	if (accept(tokenid::identifier))
-		info.name = std::move(_token.literal_as_string);
+		info.name = _token.literal_as_string;
 	else
 		info.name = "_anonymous_struct_" + std::to_string(struct_location.line) + '_' + std::to_string(struct_location.column);
 
@@ -1110,7 +1459,7 @@ bool reshadefx::parser::parse_struct()
 				return false;
 			}
 
-			member.name = std::move(_token.literal_as_string);
+			member.name = _token.literal_as_string;
 			member.location = std::move(_token.location);
 
 			if (member.type.is_void())
@@ -1179,7 +1528,7 @@ bool reshadefx::parser::parse_struct()
 					return false;
 				}
 
-				member.semantic = std::move(_token.literal_as_string);
+				member.semantic = _token.literal_as_string;
 				// Make semantic upper case to simplify comparison later on
 				std::transform(member.semantic.begin(), member.semantic.end(), member.semantic.begin(),
 					[](std::string::value_type c) {
@@ -1306,7 +1655,7 @@ bool reshadefx::parser::parse_function(type type, std::string name, shader_type
 			break;
 		}
 
-		param.name = std::move(_token.literal_as_string);
+		param.name = _token.literal_as_string;
 		param.location = std::move(_token.location);
 
 		if (param.type.is_void())
@@ -1373,7 +1722,7 @@ bool reshadefx::parser::parse_function(type type, std::string name, shader_type
 				break;
 			}
 
-			param.semantic = std::move(_token.literal_as_string);
+			param.semantic = _token.literal_as_string;
 			// Make semantic upper case to simplify comparison later on
 			std::transform(param.semantic.begin(), param.semantic.end(), param.semantic.begin(),
 				[](std::string::value_type c) {
@@ -1450,7 +1799,7 @@ bool reshadefx::parser::parse_function(type type, std::string name, shader_type
 			return false;
 		}
 
-		info.return_semantic = std::move(_token.literal_as_string);
+		info.return_semantic = _token.literal_as_string;
 		// Make semantic upper case to simplify comparison later on
 		std::transform(info.return_semantic.begin(), info.return_semantic.end(), info.return_semantic.begin(),
 			[](std::string::value_type c) {
@@ -1608,7 +1957,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 		}
 
 		std::string &semantic = texture_info.semantic;
-		semantic = std::move(_token.literal_as_string);
+		semantic = _token.literal_as_string;
 
 		// Make semantic upper case to simplify comparison later on
 		std::transform(semantic.begin(), semantic.end(), semantic.begin(),
@@ -1704,7 +2053,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 				}
 
 				location property_location = std::move(_token.location);
-				const std::string property_name = std::move(_token.literal_as_string);
+				const std::string property_name(_token.literal_as_string);
 
 				if (!expect('='))
 				{
@@ -1719,7 +2068,8 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 				if (accept(tokenid::identifier)) // Handle special enumeration names for property values
 				{
 					// Transform identifier to uppercase to do case-insensitive comparison
-					std::transform(_token.literal_as_string.begin(), _token.literal_as_string.end(), _token.literal_as_string.begin(),
+					std::string value_name(_token.literal_as_string);
+					std::transform(value_name.begin(), value_name.end(), value_name.begin(),
 						[](std::string::value_type c) {
 							return static_cast<std::string::value_type>(std::toupper(c));
 						});
@@ -1753,7 +2103,7 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 					};
 
 					// Look up identifier in list of possible enumeration names
-					if (const auto it = s_enum_values.find(_token.literal_as_string);
+					if (const auto it = s_enum_values.find(value_name);
 						it != s_enum_values.end())
 						property_exp.reset_to_rvalue_constant(_token.location, it->second);
 					else // No match found, so rewind to parser state before the identifier was consumed and try parsing it as a normal expression
@@ -2088,7 +2438,7 @@ bool reshadefx::parser::parse_technique()
 		return false;
 
 	technique info;
-	info.name = std::move(_token.literal_as_string);
+	info.name = _token.literal_as_string;
 
 	bool parse_success = parse_annotations(info.annotations);
 
@@ -2126,7 +2476,7 @@ bool reshadefx::parser::parse_technique_pass(pass &info)
 
 	// Passes can have an optional name
 	if (accept(tokenid::identifier))
-		info.name = std::move(_token.literal_as_string);
+		info.name = _token.literal_as_string;
 
 	bool parse_success = true;
 	bool targets_support_srgb = true;
@@ -2145,7 +2495,7 @@ bool reshadefx::parser::parse_technique_pass(pass &info)
 		}
 
 		location state_location = std::move(_token.location);
-		const std::string state_name = std::move(_token.literal_as_string);
+		const std::string state_name(_token.literal_as_string);
 
 		if (!expect('='))
 		{
@@ -2365,7 +2715,8 @@ bool reshadefx::parser::parse_technique_pass(pass &info)
 			if (accept(tokenid::identifier)) // Handle special enumeration names for pass states
 			{
 				// Transform identifier to uppercase to do case-insensitive comparison
-				std::transform(_token.literal_as_string.begin(), _token.literal_as_string.end(), _token.literal_as_string.begin(),
+				std::string value_name(_token.literal_as_string);
+				std::transform(value_name.begin(), value_name.end(), value_name.begin(),
 					[](std::string::value_type c) {
 						return static_cast<std::string::value_type>(std::toupper(c));
 					});
@@ -2411,7 +2762,7 @@ bool reshadefx::parser::parse_technique_pass(pass &info)
 				};
 
 				// Look up identifier in list of possible enumeration names
-				if (const auto it = s_enum_values.find(_token.literal_as_string);
+				if (const auto it = s_enum_values.find(value_name);
 					it != s_enum_values.end())
 					state_exp.reset_to_rvalue_constant(_token.location, it->second);
 				else // No match found, so rewind to parser state before the identifier was consumed and try parsing it as a normal expression
@@ -2625,6 +2976,69 @@ bool reshadefx::parser::parse_technique_pass(pass &info)
 	return expect('}') && parse_success;
 }
 
+uint32_t reshadefx::codegen::allocate_uniform(uint32_t size, uint32_t alignment, bool pack)
+{
+	const auto align_offset = [size, alignment](uint32_t offset) {
+		offset = (offset + alignment - 1) & ~(alignment - 1);
+		// Values that fit into a four-component vector may not cross a 16-byte boundary (std140 alignment already guarantees this, but HLSL packing does not)
+		if (size <= 16 && (offset & 15) + size > 16)
+			offset = (offset + 15) & ~15u;
+		return offset;
+	};
+
+	if (pack)
+	{
+		// Use the first padding range the uniform variable fits into, so that the layout stays identical to one in which it had been declared at that point
+		for (auto it = _uniform_padding.begin(); it != _uniform_padding.end(); ++it)
+		{
+			const uint32_t offset = align_offset(it->first);
+			const uint32_t padding_end = it->first + it->second;
+			if (offset + size > padding_end)
+				continue;
+
+			const std::pair<uint32_t, uint32_t> padding_before(it->first, offset - it->first);
+			const std::pair<uint32_t, uint32_t> padding_after(offset + size, padding_end - (offset + size));
+
+			it = _uniform_padding.erase(it);
+			if (padding_after.second != 0)
+				it = _uniform_padding.insert(it, padding_after);
+			if (padding_before.second != 0)
+				_uniform_padding.insert(it, padding_before);
+
+			return offset;
+		}
+	}
+
+	const uint32_t offset = align_offset(_module.total_uniform_size);
+	if (pack && offset != _module.total_uniform_size)
+		_uniform_padding.emplace_back(_module.total_uniform_size, offset - _module.total_uniform_size);
+	_module.total_uniform_size = offset + size;
+
+	return offset;
+}
+
+void reshadefx::codegen::pack_uniforms(uint32_t(*uniform_alignment)(const uniform &info))
+{
+	std::vector<uniform *> uniforms;
+	uniforms.reserve(_module.uniforms.size());
+	for (uniform &info : _module.uniforms)
+		uniforms.push_back(&info);
+
+	// Place large and strictly aligned uniform variables first, which makes it likely that padding behind them can be filled with the remaining smaller ones
+	std::stable_sort(uniforms.begin(), uniforms.end(),
+		[uniform_alignment](const uniform *lhs, const uniform *rhs) {
+			const uint32_t lhs_alignment = uniform_alignment(*lhs);
+			const uint32_t rhs_alignment = uniform_alignment(*rhs);
+			return lhs_alignment != rhs_alignment ? lhs_alignment > rhs_alignment : lhs->size > rhs->size;
+		});
+
+	_module.total_uniform_size = 0;
+	_uniform_padding.clear();
+
+	for (uniform *info : uniforms)
+		info->offset = allocate_uniform(info->size, uniform_alignment(*info), true);
+}
+
 void reshadefx::codegen::optimize_bindings()
 {
 	struct sampler_group
@@ -2697,6 +3111,115 @@ void reshadefx::codegen::optimize_bindings()
 		}
 	}
 
+	// Keep textures at the same binding in all passes that reference them where possible, so that the runtime can share descriptor tables between passes
+	{
+		// Never grow binding lists past the largest one, so that the number of required descriptors stays the same
+		size_t max_sampler_bindings = 0;
+		size_t max_storage_bindings = 0;
+		for (const technique &tech : _module.techniques)
+		{
+			for (const pass &pass : tech.passes)
+			{
+				for (const std::string *entry_point_name : { &pass.vs_entry_point, &pass.ps_entry_point, &pass.cs_entry_point })
+				{
+					if (entry_point_name->empty())
+						continue;
+
+					const function *const func = find_function(*entry_point_name);
+					max_sampler_bindings = std::max(max_sampler_bindings, func->referenced_samplers.size());
+					max_storage_bindings = std::max(max_storage_bindings, func->referenced_storages.size());
+				}
+			}
+		}
+
+		std::unordered_map<id, uint32_t> preferred_sampler_bindings;
+		std::unordered_map<id, uint32_t> preferred_storage_bindings;
+
+		const auto assign_bindings = [](std::vector<id> &referenced, size_t fixed_bindings, size_t max_bindings, std::unordered_map<id, uint32_t> &preferred_bindings) {
+			// Bindings in front are fixed (since they have to match those of the vertex shader), so only move the ones after
+			for (size_t binding = 0; binding < std::min(referenced.size(), fixed_bindings); ++binding)
+				if (referenced[binding] != 0)
+					preferred_bindings.emplace(referenced[binding], static_cast<uint32_t>(binding));
+
+			if (referenced.size() <= fixed_bindings)
+				return;
+
+			std::vector<id> remaining(referenced.begin() + fixed_bindings, referenced.end());
+			referenced.resize(fixed_bindings);
+
+			// First place everything that can go to the binding it had in a previous pass, then fill the holes with the rest
+			for (id &referenced_id : remaining)
+			{
+				const auto it = preferred_bindings.find(referenced_id);
+				if (it == preferred_bindings.end() || it->second < fixed_bindings || it->second >= max_bindings)
+					continue;
+
+				if (it->second >= referenced.size())
+					referenced.resize(it->second + 1);
+				if (referenced[it->second] != 0)
+					continue;
+
+				referenced[it->second] = referenced_id;
+				referenced_id = 0;
+			}
+
+			for (const id referenced_id : remaining)
+			{
+				if (referenced_id == 0)
+					continue;
+
+				auto binding_it = std::find(referenced.begin() + fixed_bindings, referenced.end(), 0u);
+				if (binding_it == referenced.end())
+					binding_it = referenced.insert(referenced.end(), 0);
+
+				*binding_it = referenced_id;
+				preferred_bindings.emplace(referenced_id, static_cast<uint32_t>(binding_it - referenced.begin()));
+			}
+		};
+
+		std::vector<function *> visited_entry_points;
+
+		for (const technique &tech : _module.techniques)
+		{
+			for (const pass &pass : tech.passes)
+			{
+				if (!pass.cs_entry_point.empty())
+				{
+					function *const cs = find_function(pass.cs_entry_point);
+					if (std::find(visited_entry_points.begin(), visited_entry_points.end(), cs) != visited_entry_points.end())
+						continue;
+					visited_entry_points.push_back(cs);
+
+					assign_bindings(cs->referenced_samplers, 0, max_sampler_bindings, preferred_sampler_bindings);
+					assign_bindings(cs->referenced_storages, 0, max_storage_bindings, preferred_storage_bindings);
+					continue;
+				}
+
+				function *const vs = find_function(pass.vs_entry_point);
+				function *const ps = !pass.ps_entry_point.empty() ? find_function(pass.ps_entry_point) : nullptr;
+
+				const auto group_it = std::find_if(sampler_groups.begin(), sampler_groups.end(),
+					[vs](const sampler_group &group) {
+						return std::find(group.vs_entry_points.begin(), group.vs_entry_points.end(), vs) != group.vs_entry_points.end();
+					});
+				assert(group_it != sampler_groups.end());
+
+				if (std::find(visited_entry_points.begin(), visited_entry_points.end(), vs) == visited_entry_points.end())
+				{
+					visited_entry_points.push_back(vs);
+
+					assign_bindings(vs->referenced_samplers, vs->referenced_samplers.size(), max_sampler_bindings, preferred_sampler_bindings);
+				}
+				if (ps != nullptr && std::find(visited_entry_points.begin(), visited_entry_points.end(), ps) == visited_entry_points.end())
+				{
+					visited_entry_points.push_back(ps);
+
+					assign_bindings(ps->referenced_samplers, group_it->vs_referenced_samplers.size(), max_sampler_bindings, preferred_sampler_bindings);
+				}
+			}
+		}
+	}
+
 	// Finally apply the generated bindings to all passes
 	for (technique &tech : _module.techniques)
 	{
@@ -7,8 +7,11 @@
 #include "effect_preprocessor.hpp"
 #include <limits>
 #include <cstdio> // fclose, fopen, fread, fseek
+#include <cstring> // std::memcpy
 #include <cassert>
-#include <algorithm> // std::find_if
+#include <algorithm> // std::count, std::find_if, std::replace_if
+#include <mutex>
+#include <shared_mutex>
 
 #ifndef _WIN32
 	// On Linux systems the native path encoding is UTF-8 already, so no conversion necessary
@@ -53,6 +56,9 @@ enum macro_replacement
 	macro_replacement_stringize = '\xFE',
 };
 
+// Identifies the layout written by 'save_snapshot', so that snapshots from other versions are rejected
+static const uint64_t s_snapshot_version = 0x34305348435046; // "FPCHS04"
+
 static const int s_precedence_lookup[] = {
 	0, 1, 2, 3, 4, // bitwise operators
 	5, 6, 7, 7, 7, 7, // logical operators
@@ -99,6 +105,156 @@ static bool read_file(const std::filesystem::path &path, std::string &file_data)
 	return true;
 }
 
+static std::shared_ptr<const std::string> read_file_shared(const std::filesystem::path &path)
+{
+	struct file_cache_entry
+	{
+		std::filesystem::file_time_type last_write_time;
+		uintmax_t file_size;
+		std::shared_ptr<const std::string> file_data;
+	};
+
+	// Process-wide cache of file contents, shared between all preprocessor instances (which may run concurrently on different threads), so that common headers are only read once
+	// Entries are keyed by canonical path and are read again only when the modification time or size of the file changed
+	static std::shared_mutex s_file_cache_mutex;
+	static std::unordered_map<std::string, file_cache_entry> s_file_cache;
+
+	std::error_code ec;
+	const std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return nullptr;
+	const uintmax_t file_size = std::filesystem::file_size(path, ec);
+	if (ec)
+		return nullptr;
+
+	std::filesystem::path canonical_path = std::filesystem::canonical(path, ec);
+	if (ec)
+		canonical_path = path;
+	const std::string canonical_path_string = canonical_path.u8string();
+
+	{
+		const std::shared_lock<std::shared_mutex> lock(s_file_cache_mutex);
+
+		if (const auto it = s_file_cache.find(canonical_path_string);
+			it != s_file_cache.end() && it->second.last_write_time == last_write_time && it->second.file_size == file_size)
+			return it->second.file_data;
+	}
+
+	std::string file_data;
+	if (!read_file(path, file_data))
+		return nullptr;
+
+	std::shared_ptr<const std::string> shared_file_data = std::make_shared<const std::string>(std::move(file_data));
+
+	{
+		const std::unique_lock<std::shared_mutex> lock(s_file_cache_mutex);
+
+		s_file_cache[canonical_path_string] = { last_write_time, file_size, shared_file_data };
+	}
+
+	return shared_file_data;
+}
+
+/// <summary>
+/// Finds the '#include' directives at the beginning of the specified source code (preceded by nothing but whitespace and comments).
+/// The directives are copied to the same lines they appear on in the source code and all other lines are left empty, so that parsing the header prefix produces the same locations as parsing the source code.
+/// </summary>
+/// <returns>The offset following the line of the last '#include' directive.</returns>
+static size_t find_header_prefix(std::string_view source, std::string &header_prefix)
+{
+	size_t header_prefix_end = 0;
+
+	for (size_t offset = 0; offset < source.size();)
+	{
+		const char c = source[offset];
+
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+		{
+			offset++;
+			continue;
+		}
+
+		if (source.compare(offset, 2, "//") == 0)
+		{
+			offset = source.find('\n', offset);
+			// Stop at line continuations, which would extend the comment to the next line
+			if (offset == std::string_view::npos || source[offset - 1] == '\\' || (source[offset - 1] == '\r' && source[offset - 2] == '\\'))
+				break;
+			continue;
+		}
+		if (source.compare(offset, 2, "/*") == 0)
+		{
+			offset = source.find("*/", offset + 2);
+			// Directives are only recognized at the beginning of a line, so stop at comments that end in the middle of one
+			if (offset == std::string_view::npos || (offset = source.find_first_not_of(" \t\r", offset + 2)) == std::string_view::npos || source[offset] != '\n')
+				break;
+			continue;
+		}
+
+		// Only accept '#include "file"' on a line of its own
+		if (c != '#')
+			break;
+		size_t pos = source.find_first_not_of(" \t", offset + 1);
+		if (pos == std::string_view::npos || source.compare(pos, 7, "include") != 0)
+			break;
+		pos = source.find_first_not_of(" \t", pos + 7);
+		if (pos == std::string_view::npos || source[pos] != '\"')
+			break;
+		const size_t file_name_end = source.find_first_of("\"\n", pos + 1);
+		if (file_name_end == std::string_view::npos || source[file_name_end] != '\"')
+			break;
+		pos = source.find_first_not_of(" \t\r", file_name_end + 1);
+		if (pos == std::string_view::npos || source[pos] != '\n')
+			break;
+
+		const size_t line_start = source.rfind('\n', offset) + 1; // Wraps around to zero on the first line
+		header_prefix.append(std::count(source.begin() + header_prefix_end, source.begin() + line_start, '\n'), '\n');
+		header_prefix += source.substr(line_start, file_name_end + 1 - line_start);
+		header_prefix += '\n';
+
+		offset = header_prefix_end = pos + 1;
+	}
+
+	return header_prefix_end;
+}
+
+static void write_snapshot_value(std::string &data, uint64_t value)
+{
+	data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+static void write_snapshot_value(std::string &data, std::string_view value)
+{
+	write_snapshot_value(data, static_cast<uint64_t>(value.size()));
+	data.append(value);
+}
+static bool read_snapshot_value(std::string_view &data, uint64_t &value)
+{
+	if (data.size() < sizeof(value))
+		return false;
+	std::memcpy(&value, data.data(), sizeof(value));
+	data.remove_prefix(sizeof(value));
+	return true;
+}
+static bool read_snapshot_value(std::string_view &data, std::string &value)
+{
+	uint64_t size = 0;
+	if (!read_snapshot_value(data, size) || size > data.size())
+		return false;
+	value.assign(data.data(), static_cast<size_t>(size));
+	data.remove_prefix(static_cast<size_t>(size));
+	return true;
+}
+
+static bool is_identical_macro(const reshadefx::preprocessor::macro &definition, const reshadefx::preprocessor::macro &other_definition)
+{
+	return
+		definition.replacement_list == other_definition.replacement_list &&
+		definition.parameters == other_definition.parameters &&
+		definition.is_predefined == other_definition.is_predefined &&
+		definition.is_variadic == other_definition.is_variadic &&
+		definition.is_function_like == other_definition.is_function_like;
+}
+
 template <char ESCAPE_CHAR = '\\'>
 static std::string escape_string(std::string s)
 {
@@ -107,6 +263,158 @@ static std::string escape_string(std::string s)
 	return '\"' + s + '\"';
 }
 
+static bool is_identifier_char(char c)
+{
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+static bool is_operator_char(char c)
+{
+	switch (c)
+	{
+	case '!': case '#': case '%': case '&': case '*': case '+': case '-': case '.': case '/': case ':': case '<': case '=': case '>': case '\\': case '^': case '|':
+		return true;
+	default:
+		return false;
+	}
+}
+static bool is_numeric_literal(reshadefx::tokenid id)
+{
+	return id == reshadefx::tokenid::int_literal || id == reshadefx::tokenid::uint_literal || id == reshadefx::tokenid::float_literal || id == reshadefx::tokenid::double_literal;
+}
+
+/// <summary>
+/// Appends raw token data to a string and the token to a sequence that matches what lexing that string would produce.
+/// If the token would not be lexed the same way in the resulting string (e.g. because it merges with the preceding token), the token sequence is marked as invalid, so that the string has to be lexed again instead.
+/// </summary>
+template <typename TOKEN>
+static void append_token(std::string &text, std::vector<reshadefx::preprocessor::prelexed_token> &tokens, bool &is_prelexed, const TOKEN &tok, std::string_view raw_data)
+{
+	using reshadefx::tokenid;
+
+	const size_t offset = text.size();
+	text += raw_data;
+
+	if (!is_prelexed || raw_data.empty())
+		return;
+
+	// Line breaks (which affect location tracking and directive detection), unknown characters and unterminated string literals are left to the lexer
+	if (tok == tokenid::unknown || tok == tokenid::end_of_line || raw_data.find_first_of("\r\n") != std::string_view::npos ||
+		(tok == tokenid::string_literal && (raw_data.size() < 2 || raw_data.back() != '\"')))
+	{
+		is_prelexed = false;
+		return;
+	}
+
+	if (!tokens.empty())
+	{
+		reshadefx::preprocessor::prelexed_token &prev_tok = tokens.back();
+
+		if (prev_tok == tokenid::space && tok == tokenid::space)
+		{
+			// Consecutive whitespace is lexed as a single token
+			prev_tok.length += raw_data.size();
+			return;
+		}
+
+		if (prev_tok != tokenid::space && prev_tok != tokenid::string_literal && tok != tokenid::space)
+		{
+			const char prev_char = text[offset - 1];
+			const char next_char = raw_data[0];
+
+			if (is_identifier_char(prev_char) && is_identifier_char(next_char))
+			{
+				// An identifier followed by more identifier characters (e.g. as a result of the ## operator) is lexed as a single longer identifier
+				if (prev_tok == tokenid::identifier && std::all_of(raw_data.begin(), raw_data.end(), is_identifier_char))
+				{
+					prev_tok.length += raw_data.size();
+					return;
+				}
+
+				is_prelexed = false;
+				return;
+			}
+
+			if ((is_operator_char(prev_char) && is_operator_char(next_char)) ||
+				(prev_char == '.' && next_char >= '0' && next_char <= '9') ||
+				(is_numeric_literal(prev_tok) && (next_char == '.' || next_char == '+' || next_char == '-')))
+			{
+				is_prelexed = false;
+				return;
+			}
+		}
+	}
+
+	reshadefx::preprocessor::prelexed_token &new_tok = tokens.emplace_back();
+	new_tok.id = tok.id;
+	new_tok.offset = offset;
+	new_tok.length = raw_data.size();
+	new_tok.literal_as_double = tok.literal_as_double;
+}
+
+/// <summary>
+/// Lexes the replacement list of a macro definition, so that it does not need to be lexed again on every expansion.
+/// Text that is not reproduced exactly by its tokens is kept as a single <see cref="tokenid::unknown"/> token, which causes expansions to fall back to lexing the result.
+/// </summary>
+static std::vector<reshadefx::preprocessor::prelexed_token> lex_replacement_list(const std::string &replacement_list)
+{
+	std::vector<reshadefx::preprocessor::prelexed_token> tokens;
+
+	for (size_t offset = 0; offset < replacement_list.size();)
+	{
+		if (replacement_list[offset] == macro_replacement_start)
+		{
+			// Special replacement sequences consist of three characters (start, type and parameter index)
+			reshadefx::preprocessor::prelexed_token &tok = tokens.emplace_back();
+			tok.id = reshadefx::tokenid::unknown;
+			tok.offset = offset;
+			tok.length = 3;
+			tok.literal_as_double = 0;
+
+			offset += 3;
+			continue;
+		}
+
+		const size_t segment_end = std::min(replacement_list.find(static_cast<char>(macro_replacement_start), offset), replacement_list.size());
+		const size_t first_segment_token = tokens.size();
+
+		// Lex with the same settings as 'push', but start in the middle of a line, since a replacement list is never at the beginning of one
+		reshadefx::lexer lexer(
+			replacement_list.substr(offset, segment_end - offset),
+			true  /* ignore_comments */,
+			false /* ignore_whitespace */,
+			false /* ignore_pp_directives */,
+			false /* ignore_line_directives */,
+			true  /* ignore_keywords */,
+			false /* escape_string_literals */,
+			reshadefx::location(1, 2));
+
+		size_t segment_offset = 0;
+		for (reshadefx::token tok; (tok = lexer.lex()) != reshadefx::tokenid::end_of_file && tok.offset == segment_offset; segment_offset += tok.length)
+		{
+			reshadefx::preprocessor::prelexed_token &new_tok = tokens.emplace_back();
+			new_tok.id = tok.id;
+			new_tok.offset = offset + tok.offset;
+			new_tok.length = tok.length;
+			new_tok.literal_as_double = tok.literal_as_double;
+		}
+
+		if (segment_offset != segment_end - offset)
+		{
+			tokens.resize(first_segment_token);
+
+			reshadefx::preprocessor::prelexed_token &tok = tokens.emplace_back();
+			tok.id = reshadefx::tokenid::unknown;
+			tok.offset = offset;
+			tok.length = segment_end - offset;
+			tok.literal_as_double = 0;
+		}
+
+		offset = segment_end;
+	}
+
+	return tokens;
+}
+
 reshadefx::preprocessor::preprocessor()
 {
 }
@@ -126,13 +434,7 @@ bool reshadefx::preprocessor::add_macro_definition(const std::string &name, cons
 	if (insert.second)
 		return true;
 	// Allow redefinition of identical macros
-	const macro &existing_definition = insert.first->second;
-	return
-		existing_definition.replacement_list == definition.replacement_list &&
-		existing_definition.parameters == definition.parameters &&
-		existing_definition.is_predefined == definition.is_predefined &&
-		existing_definition.is_variadic == definition.is_variadic &&
-		existing_definition.is_function_like == definition.is_function_like;
+	return is_identical_macro(insert.first->second, definition);
 }
 
 bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
@@ -141,6 +443,40 @@ bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
 	if (!read_file(path, source_code))
 		return false;
 
+	// Skip the header prefix of this file if it was parsed already (see 'append_header_prefix')
+	if (!_header_prefix.empty())
+	{
+		std::string header_prefix;
+		const size_t header_prefix_end = find_header_prefix(source_code, header_prefix);
+
+		// Replace it with whitespace, but keep line breaks, so that line numbers stay the same
+		if (header_prefix == _header_prefix)
+		{
+			std::replace_if(source_code.begin(), source_code.begin() + header_prefix_end, [](char c) { return c != '\n'; }, ' ');
+
+			// The header prefix was parsed under a name that does not depend on this file, so replace it with the name of this file in everything produced from it
+			// This also continues the output in this file without a new "#line" directive, since the header prefix was parsed with the same locations as the file has
+			const std::string path_string = path.u8string();
+			for (std::string *const text : { &_output, &_errors })
+				for (size_t offset = 0; (offset = text->find(_header_prefix_source, offset)) != std::string::npos; offset += path_string.size())
+					text->replace(offset, _header_prefix_source.size(), path_string);
+			if (_output_location.source == _header_prefix_source)
+			{
+				_output_location.source = path_string;
+			}
+			else if (_output_location.source != path_string)
+			{
+				// The header prefix ended in an included file, so switch back to this file the same way 'consume' does when returning from an include to the line following it
+				const uint32_t next_line = static_cast<uint32_t>(std::count(_header_prefix.begin(), _header_prefix.end(), '\n')) + 1;
+				_output += "#line " + std::to_string(next_line) + " \"" + path_string + "\"\n";
+				_output_location.line = next_line - 1;
+				_output_location.source = path_string;
+			}
+		}
+
+		_header_prefix.clear();
+	}
+
 	return append_string(std::move(source_code), path);
 }
 bool reshadefx::preprocessor::append_string(std::string source_code, const std::filesystem::path &path)
@@ -161,14 +497,265 @@ bool reshadefx::preprocessor::append_string(std::string source_code, const std::
 	return _errors.find(": preprocessor error: ", errors_offset) == std::string::npos;
 }
 
+std::string reshadefx::preprocessor::read_header_prefix(const std::filesystem::path &path)
+{
+	std::string header_prefix;
+	if (const std::shared_ptr<const std::string> source_code = read_file_shared(path))
+		find_header_prefix(*source_code, header_prefix);
+	return header_prefix;
+}
+bool reshadefx::preprocessor::append_header_prefix(const std::string &header_prefix, const std::filesystem::path &path)
+{
+	if (header_prefix.empty())
+		return true;
+
+	// Name this string after a file next to the one the header prefix belongs to, so that relative includes are resolved the same way, without making the output depend on the name of that file
+	_header_prefix_source = (path.parent_path() / "<header prefix>").u8string();
+
+	if (!append_string(header_prefix, std::filesystem::u8path(_header_prefix_source)))
+		return false;
+
+	// The file continues where the header prefix ends (see 'append_file'), so remove the line break added after the end of the input again, to avoid an additional empty line in the output
+	assert(!_output.empty() && _output.back() == '\n');
+	_output.pop_back();
+
+	_header_prefix += header_prefix;
+	return true;
+}
+
+std::string reshadefx::preprocessor::save_snapshot() const
+{
+	assert(_input_stack.empty());
+
+	std::string data;
+	write_snapshot_value(data, s_snapshot_version);
+	write_snapshot_value(data, _header_prefix);
+	write_snapshot_value(data, _header_prefix_source);
+
+	write_snapshot_value(data, _include_paths.size());
+	for (const std::filesystem::path &include_path : _include_paths)
+		write_snapshot_value(data, include_path.u8string());
+
+	// Store the files the includes of the header prefix resolved to, to be able to detect when they would resolve differently
+	write_snapshot_value(data, _header_prefix_includes.size());
+	for (const std::pair<std::string, std::string> &include : _header_prefix_includes)
+	{
+		write_snapshot_value(data, include.first);
+		write_snapshot_value(data, include.second);
+	}
+
+	write_snapshot_value(data, _macros.size());
+	for (const std::pair<const std::string, macro> &macro_entry : _macros)
+	{
+		write_snapshot_value(data, macro_entry.first);
+		write_snapshot_value(data, macro_entry.second.replacement_list);
+		write_snapshot_value(data, macro_entry.second.parameters.size());
+		for (const std::string &parameter : macro_entry.second.parameters)
+			write_snapshot_value(data, parameter);
+		write_snapshot_value(data, (macro_entry.second.is_predefined ? 0x1 : 0) | (macro_entry.second.is_variadic ? 0x2 : 0) | (macro_entry.second.is_function_like ? 0x4 : 0));
+	}
+
+	write_snapshot_value(data, _used_macros.size());
+	for (const std::string &name : _used_macros)
+		write_snapshot_value(data, name);
+
+	write_snapshot_value(data, _include_guards.size());
+	for (const std::pair<const std::string, std::string> &include_guard : _include_guards)
+	{
+		write_snapshot_value(data, include_guard.first);
+		write_snapshot_value(data, include_guard.second);
+	}
+
+	// Store size and hash of all included files, to be able to detect changes to them
+	write_snapshot_value(data, _file_cache.size());
+	for (const std::pair<const std::string, std::shared_ptr<const std::string>> &cache_entry : _file_cache)
+	{
+		write_snapshot_value(data, cache_entry.first);
+		write_snapshot_value(data, cache_entry.second->size());
+		write_snapshot_value(data, std::hash<std::string_view>()(*cache_entry.second));
+	}
+
+	write_snapshot_value(data, _missing_files.size());
+	for (const std::string &path : _missing_files)
+		write_snapshot_value(data, path);
+
+	write_snapshot_value(data, _output);
+	write_snapshot_value(data, _errors);
+	write_snapshot_value(data, _output_location.source);
+	write_snapshot_value(data, _output_location.line);
+
+	return data;
+}
+bool reshadefx::preprocessor::load_snapshot(const std::string &snapshot, const std::string &header_prefix, const std::filesystem::path &path)
+{
+	// Can only resume from a snapshot before any input was parsed
+	if (!_input_stack.empty() || !_output.empty())
+		return false;
+
+	std::string_view data = snapshot;
+	uint64_t version = 0, count = 0;
+
+	std::string snapshot_header_prefix, snapshot_header_prefix_source;
+	if (!read_snapshot_value(data, version) || version != s_snapshot_version ||
+		!read_snapshot_value(data, snapshot_header_prefix) || snapshot_header_prefix != header_prefix)
+		return false;
+
+	// Relative includes are resolved against the directory of the file the header prefix belongs to, which is also referenced in the output
+	if (!read_snapshot_value(data, snapshot_header_prefix_source) ||
+		(!snapshot_header_prefix.empty() && snapshot_header_prefix_source != (path.parent_path() / "<header prefix>").u8string()))
+		return false;
+
+	// Included files may be resolved differently with other include paths
+	if (!read_snapshot_value(data, count) || count != _include_paths.size())
+		return false;
+	for (const std::filesystem::path &include_path : _include_paths)
+	{
+		if (std::string include_path_string; !read_snapshot_value(data, include_path_string) || include_path_string != include_path.u8string())
+			return false;
+	}
+
+	// A new file may have been added that an include of the header prefix now resolves to instead
+	std::vector<std::pair<std::string, std::string>> header_prefix_includes;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::string file_name, file_path;
+		if (!read_snapshot_value(data, file_name) || !read_snapshot_value(data, file_path) ||
+			resolve_include(snapshot_header_prefix_source, std::filesystem::u8path(file_name), false).u8string() != file_path)
+			return false;
+		header_prefix_includes.emplace_back(std::move(file_name), std::move(file_path));
+	}
+
+	// All macros defined before the snapshot was saved have to be defined the same way now
+	std::unordered_map<std::string, macro> macros;
+	size_t num_predefined_macros = 0;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::string name;
+		macro definition;
+		uint64_t num_parameters = 0, flags = 0;
+		if (!read_snapshot_value(data, name) || !read_snapshot_value(data, definition.replacement_list) || !read_snapshot_value(data, num_parameters))
+			return false;
+		for (uint64_t k = 0; k < num_parameters; ++k)
+		{
+			if (!read_snapshot_value(data, definition.parameters.emplace_back()))
+				return false;
+		}
+		if (!read_snapshot_value(data, flags))
+			return false;
+		definition.is_predefined = (flags & 0x1) != 0;
+		definition.is_variadic = (flags & 0x2) != 0;
+		definition.is_function_like = (flags & 0x4) != 0;
+
+		if (definition.is_predefined)
+		{
+			if (const auto it = _macros.find(name);
+				it == _macros.end() || !is_identical_macro(it->second, definition))
+				return false;
+			num_predefined_macros++;
+		}
+
+		macros.emplace(std::move(name), std::move(definition));
+	}
+	if (num_predefined_macros != _macros.size())
+		return false;
+
+	std::unordered_set<std::string> used_macros;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (std::string name; !read_snapshot_value(data, name))
+			return false;
+		else
+			used_macros.insert(std::move(name));
+	}
+
+	std::unordered_map<std::string, std::string> include_guards;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::string path, guard_macro;
+		if (!read_snapshot_value(data, path) || !read_snapshot_value(data, guard_macro))
+			return false;
+		include_guards.emplace(std::move(path), std::move(guard_macro));
+	}
+
+	std::unordered_map<std::string, std::shared_ptr<const std::string>> file_cache;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::string path;
+		uint64_t file_size = 0, file_hash = 0;
+		if (!read_snapshot_value(data, path) || !read_snapshot_value(data, file_size) || !read_snapshot_value(data, file_hash))
+			return false;
+
+		// Reject the snapshot if any of the included files changed since it was saved
+		std::shared_ptr<const std::string> file_data = read_file_shared(std::filesystem::u8path(path));
+		if (file_data == nullptr || file_data->size() != file_size || std::hash<std::string_view>()(*file_data) != file_hash)
+			return false;
+
+		file_cache.emplace(std::move(path), std::move(file_data));
+	}
+
+	std::unordered_set<std::string> missing_files;
+	if (!read_snapshot_value(data, count))
+		return false;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::string path;
+		if (!read_snapshot_value(data, path))
+			return false;
+
+		// Reject the snapshot if any of the files that were looked up but did not exist were created since it was saved
+		if (std::error_code ec; std::filesystem::exists(std::filesystem::u8path(path), ec))
+			return false;
+
+		missing_files.insert(std::move(path));
+	}
+
+	std::string output, errors, output_source;
+	uint64_t output_line = 0;
+	if (!read_snapshot_value(data, output) || !read_snapshot_value(data, errors) || !read_snapshot_value(data, output_source) || !read_snapshot_value(data, output_line) || !data.empty())
+		return false;
+
+	_macros = std::move(macros);
+	_used_macros = std::move(used_macros);
+	_include_guards = std::move(include_guards);
+	_file_cache = std::move(file_cache);
+	_missing_files.insert(missing_files.begin(), missing_files.end());
+	_output = std::move(output);
+	_errors = std::move(errors);
+	_output_location.source = std::move(output_source);
+	_output_location.line = static_cast<uint32_t>(output_line);
+	_header_prefix = std::move(snapshot_header_prefix);
+	_header_prefix_source = std::move(snapshot_header_prefix_source);
+	_header_prefix_includes = std::move(header_prefix_includes);
+
+	return true;
+}
+
 std::vector<std::filesystem::path> reshadefx::preprocessor::included_files() const
 {
 	std::vector<std::filesystem::path> files;
 	files.reserve(_file_cache.size());
-	for (const std::pair<std::string, std::string> &cache_entry : _file_cache)
+	for (const std::pair<const std::string, std::shared_ptr<const std::string>> &cache_entry : _file_cache)
 		files.push_back(std::filesystem::u8path(cache_entry.first));
 	return files;
 }
+std::vector<std::filesystem::path> reshadefx::preprocessor::missing_files() const
+{
+	std::vector<std::filesystem::path> files;
+	files.reserve(_missing_files.size());
+	for (const std::string &path : _missing_files)
+		files.push_back(std::filesystem::u8path(path));
+	return files;
+}
 std::vector<std::pair<std::string, std::string>> reshadefx::preprocessor::used_macro_definitions() const
 {
 	std::vector<std::pair<std::string, std::string>> definitions;
@@ -201,6 +788,10 @@ void reshadefx::preprocessor::warning(const location &location, const std::strin
 }
 
 void reshadefx::preprocessor::push(std::string input, const std::string &name)
+{
+	push(std::make_shared<const std::string>(std::move(input)), name);
+}
+void reshadefx::preprocessor::push(std::shared_ptr<const std::string> input, const std::string &name)
 {
 	location start_location = !name.empty() ?
 		// Start at the beginning of the file when pushing a new file
@@ -209,6 +800,7 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 		_token.location;
 
 	input_level level = { name };
+	level.input = input;
 	level.lexer.reset(new lexer(
 		std::move(input),
 		true  /* ignore_comments */,
@@ -231,6 +823,40 @@ void reshadefx::preprocessor::push(std::string input, const std::string &name)
 	// Advance into the input stack to update next token
 	consume();
 }
+void reshadefx::preprocessor::push(std::shared_ptr<const std::string> input, std::vector<prelexed_token> tokens)
+{
+	// Start with last known token location, same as when pushing an unnamed string
+	location start_location = _token.location;
+
+	size_t first_token_index = 0;
+	if (start_location.column <= 1)
+	{
+		// The lexer skips whitespace at the beginning of a line and would parse a following '#' as a preprocessor directive, so do the same
+		for (; first_token_index < tokens.size() && tokens[first_token_index] == tokenid::space; ++first_token_index)
+			start_location.column += static_cast<uint32_t>(tokens[first_token_index].length);
+
+		if (first_token_index < tokens.size() && tokens[first_token_index] == tokenid::hash)
+			return push(std::move(input));
+	}
+
+	input_level level = {};
+	level.input = std::move(input);
+	level.tokens = std::move(tokens);
+	level.next_token_index = first_token_index;
+	level.next_token_location = start_location;
+	level.next_token.id = tokenid::unknown;
+	level.next_token.location = start_location; // This is used in 'consume' to initialize the output location
+
+	// Inherit hidden macros from parent
+	if (!_input_stack.empty())
+		level.hidden_macros = _input_stack.back().hidden_macros;
+
+	_input_stack.push_back(std::move(level));
+	_next_input_index = _input_stack.size() - 1;
+
+	// Advance into the input stack to update next token
+	consume();
+}
 
 bool reshadefx::preprocessor::peek(tokenid tokid) const
 {
@@ -266,10 +892,45 @@ void reshadefx::preprocessor::consume()
 
 	// Set current token
 	_token = std::move(input.next_token);
-	_current_token_raw_data = input.lexer->input_string().substr(_token.offset, _token.length);
+	_current_token_raw_data = std::string_view(*input.input).substr(_token.offset, _token.length);
 
 	// Get the next token
-	input.next_token = input.lexer->lex();
+	if (input.lexer != nullptr)
+	{
+		input.next_token = input.lexer->lex();
+	}
+	else
+	{
+		// Input was lexed already, so only need to update location and string view of the next token
+		token &next_token = input.next_token;
+		next_token.location = input.next_token_location;
+
+		if (input.next_token_index < input.tokens.size())
+		{
+			const prelexed_token &tok = input.tokens[input.next_token_index++];
+			next_token.id = tok.id;
+			next_token.offset = tok.offset;
+			next_token.length = tok.length;
+			next_token.literal_as_double = tok.literal_as_double;
+
+			if (tok == tokenid::identifier)
+				next_token.literal_as_string = std::string_view(*input.input).substr(tok.offset, tok.length);
+			else if (tok == tokenid::string_literal)
+				next_token.literal_as_string = std::string_view(*input.input).substr(tok.offset + 1, tok.length - 2);
+			else
+				next_token.literal_as_string = {};
+
+			input.next_token_location.column += static_cast<uint32_t>(tok.length);
+		}
+		else
+		{
+			next_token.id = tokenid::end_of_file;
+			next_token.offset = input.input->size();
+			next_token.length = 1;
+			next_token.literal_as_double = 0;
+			next_token.literal_as_string = {};
+		}
+	}
 
 	// Verify string literals (since the lexer cannot throw errors itself)
 	if (_token == tokenid::string_literal && _current_token_raw_data.back() != '\"')
@@ -286,11 +947,18 @@ void reshadefx::preprocessor::consume()
 		if (_next_input_index == 0)
 		{
 			// End of input has been reached, so cannot pop further and this is the last token
+			// Keep the lexer alive though, since the current token still references its input string
+			_last_input_lexer = std::move(_input_stack.back().lexer);
 			_input_stack.pop_back();
 			return;
 		}
 		else
 		{
+			// Remember files whose entire contents are wrapped in an include guard, so that including them again can be skipped without lexing them
+			if (const input_level &input = _input_stack[_next_input_index];
+				input.guard_state == include_guard_state::after_guard)
+				_include_guards.emplace(input.name, input.guard_macro);
+
 			_next_input_index -= 1;
 		}
 	}
@@ -337,7 +1005,7 @@ bool reshadefx::preprocessor::expect(tokenid tokid)
 		}
 		else
 		{
-			const std::string token_string = _input_stack[_next_input_index].lexer->input_string().substr(actual_token.offset, actual_token.length);
+			const std::string token_string = _input_stack[_next_input_index].input->substr(actual_token.offset, actual_token.length);
 			error(actual_token.location, "syntax error: unexpected token '" + token_string + '\'');
 		}
 
@@ -360,6 +1028,15 @@ void reshadefx::preprocessor::parse()
 
 		const bool skip = !_if_stack.empty() && _if_stack.back().skipping;
 
+		// Any token besides the include guard and whitespace means the file is not guarded as a whole
+		if (_current_input_index < _input_stack.size() && _token != tokenid::space && _token != tokenid::end_of_line)
+		{
+			if (input_level &input = _input_stack[_current_input_index];
+				(input.guard_state == include_guard_state::before_guard && _token != tokenid::hash_ifndef) ||
+				(input.guard_state == include_guard_state::after_guard))
+				input.guard_state = include_guard_state::none;
+		}
+
 		switch (_token)
 		{
 		case tokenid::hash_if:
@@ -434,7 +1111,7 @@ void reshadefx::preprocessor::parse()
 		case tokenid::hash_unknown:
 			// Standalone "#" is valid and should be ignored
 			if (_token.length != 0)
-				error(_token.location, "unrecognized preprocessing directive '" + _token.literal_as_string + '\'');
+				error(_token.location, "unrecognized preprocessing directive '" + std::string(_token.literal_as_string) + '\'');
 			if (!expect(tokenid::end_of_line))
 				consume_until(tokenid::end_of_line);
 			continue;
@@ -476,7 +1153,7 @@ void reshadefx::preprocessor::parse_def()
 	const location location = std::move(_token.location);
 
 	macro definition;
-	const std::string macro_name = std::move(_token.literal_as_string);
+	const std::string macro_name(_token.literal_as_string);
 
 	// Only create function-like macro if the parenthesis follows the macro name without any whitespace between
 	if (accept(tokenid::parenthesis_open, false))
@@ -485,7 +1162,7 @@ void reshadefx::preprocessor::parse_def()
 
 		while (accept(tokenid::identifier))
 		{
-			definition.parameters.push_back(_token.literal_as_string);
+			definition.parameters.emplace_back(_token.literal_as_string);
 
 			if (!accept(tokenid::comma))
 				break;
@@ -510,7 +1187,7 @@ void reshadefx::preprocessor::parse_undef()
 	if (_token.literal_as_string == "defined")
 		return warning(_token.location, "macro name 'defined' is reserved");
 
-	_macros.erase(_token.literal_as_string);
+	_macros.erase(std::string(_token.literal_as_string));
 }
 
 void reshadefx::preprocessor::parse_if()
@@ -551,13 +1228,15 @@ void reshadefx::preprocessor::parse_ifdef()
 	}
 	else
 	{
-		level.value = is_defined(_token.literal_as_string);
+		const std::string macro_name(_token.literal_as_string);
+
+		level.value = is_defined(macro_name);
 		level.skipping = !level.value;
 
 		// Only add to used macro list if this #ifdef is active and the macro was not defined before
-		if (const auto macro_it = _macros.find(_token.literal_as_string);
+		if (const auto macro_it = _macros.find(macro_name);
 			macro_it == _macros.end() || macro_it->second.is_predefined)
-			_used_macros.emplace(_token.literal_as_string);
+			_used_macros.emplace(macro_name);
 	}
 
 	_if_stack.push_back(std::move(level));
@@ -579,13 +1258,24 @@ void reshadefx::preprocessor::parse_ifndef()
 	}
 	else
 	{
-		level.value = !is_defined(_token.literal_as_string);
+		const std::string macro_name(_token.literal_as_string);
+
+		level.value = !is_defined(macro_name);
 		level.skipping = !level.value;
 
 		// Only add to used macro list if this #ifndef is active and the macro was not defined before
-		if (const auto macro_it = _macros.find(_token.literal_as_string);
+		if (const auto macro_it = _macros.find(macro_name);
 			macro_it == _macros.end() || macro_it->second.is_predefined)
-			_used_macros.emplace(_token.literal_as_string);
+			_used_macros.emplace(macro_name);
+
+		// An #ifndef that is the first directive in a file may be an include guard
+		if (input_level &input = _input_stack[level.input_index];
+			input.guard_state == include_guard_state::before_guard)
+		{
+			input.guard_state = include_guard_state::inside_guard;
+			input.guard_macro = macro_name;
+			input.guard_if_index = _if_stack.size();
+		}
 	}
 
 	_if_stack.push_back(std::move(level));
@@ -599,6 +1289,14 @@ void reshadefx::preprocessor::parse_elif()
 	if (level.pp_token == tokenid::hash_else)
 		return error(_token.location, "#elif is not allowed after #else");
 
+	// An include guard cannot have an alternative branch
+	if (_current_input_index < _input_stack.size())
+	{
+		if (input_level &input = _input_stack[_current_input_index];
+			input.guard_state == include_guard_state::inside_guard && input.guard_if_index == _if_stack.size() - 1)
+			input.guard_state = include_guard_state::none;
+	}
+
 	// Update 'pp_token' before evaluating expression, so that it points at the beginning # token
 	level.pp_token = _token;
 	level.input_index = _current_input_index;
@@ -627,6 +1325,14 @@ void reshadefx::preprocessor::parse_else()
 	if (level.pp_token == tokenid::hash_else)
 		return error(_token.location, "#else is not allowed after #else");
 
+	// An include guard cannot have an alternative branch
+	if (_current_input_index < _input_stack.size())
+	{
+		if (input_level &input = _input_stack[_current_input_index];
+			input.guard_state == include_guard_state::inside_guard && input.guard_if_index == _if_stack.size() - 1)
+			input.guard_state = include_guard_state::none;
+	}
+
 	level.pp_token = _token;
 	level.input_index = _current_input_index;
 
@@ -650,6 +1356,13 @@ void reshadefx::preprocessor::parse_endif()
 		return error(_token.location, "missing #if for #endif");
 
 	_if_stack.pop_back();
+
+	if (_current_input_index < _input_stack.size())
+	{
+		if (input_level &input = _input_stack[_current_input_index];
+			input.guard_state == include_guard_state::inside_guard && input.guard_if_index == _if_stack.size())
+			input.guard_state = include_guard_state::after_guard;
+	}
 }
 
 void reshadefx::preprocessor::parse_error()
@@ -659,7 +1372,7 @@ void reshadefx::preprocessor::parse_error()
 	if (!expect(tokenid::string_literal))
 		return;
 
-	error(keyword_location, _token.literal_as_string);
+	error(keyword_location, std::string(_token.literal_as_string));
 }
 void reshadefx::preprocessor::parse_warning()
 {
@@ -668,7 +1381,7 @@ void reshadefx::preprocessor::parse_warning()
 	if (!expect(tokenid::string_literal))
 		return;
 
-	warning(keyword_location, _token.literal_as_string);
+	warning(keyword_location, std::string(_token.literal_as_string));
 }
 
 void reshadefx::preprocessor::parse_pragma()
@@ -678,7 +1391,7 @@ void reshadefx::preprocessor::parse_pragma()
 	if (!expect(tokenid::identifier))
 		return;
 
-	std::string pragma = std::move(_token.literal_as_string);
+	std::string pragma(_token.literal_as_string);
 
 	while (!peek(tokenid::end_of_line) && !peek(tokenid::end_of_file))
 	{
@@ -696,12 +1409,8 @@ void reshadefx::preprocessor::parse_pragma()
 
 	if (pragma == "once")
 	{
-		// Clear file contents, so that future include statements simply push an empty string instead of these file contents again
-		if (const auto file_it = _file_cache.find(_output_location.source);
-			file_it != _file_cache.end())
-		{
-			file_it->second.clear();
-		}
+		// Add an include guard without a macro, so that future include statements skip this file entirely
+		_include_guards[_output_location.source].clear();
 		return;
 	}
 
@@ -729,18 +1438,15 @@ void reshadefx::preprocessor::parse_include()
 		return;
 	}
 
-	std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
-	std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
-	file_path.replace_filename(file_name);
-
-	std::error_code ec;
-	if (!std::filesystem::exists(file_path, ec))
-		for (const std::filesystem::path &include_path : _include_paths)
-			if (std::filesystem::exists(file_path = include_path / file_name, ec))
-				break;
-
+	const std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
+	// A file that cannot be found fails preprocessing, so there is nothing that would need to be invalidated when it is created later on
+	const std::filesystem::path file_path = resolve_include(_output_location.source, file_name, false);
 	const std::string file_path_string = file_path.u8string();
 
+	// Remember what the includes of a header prefix resolved to, so that a snapshot of it can be validated (see 'load_snapshot')
+	if (!_header_prefix_source.empty() && _output_location.source == _header_prefix_source)
+		_header_prefix_includes.emplace_back(file_name.u8string(), file_path_string);
+
 	// Detect recursive include and abort to avoid infinite loop
 	if (std::find_if(_input_stack.begin(), _input_stack.end(),
 			[&file_path_string](const input_level &level) {
@@ -748,7 +1454,16 @@ void reshadefx::preprocessor::parse_include()
 			}) != _input_stack.end())
 		return error(_token.location, "recursive #include");
 
-	std::string input;
+	// Skip files that were included before and are wrapped in an include guard that is still defined or contain '#pragma once'
+	if (const auto guard_it = _include_guards.find(file_path_string);
+		guard_it != _include_guards.end() && (guard_it->second.empty() || is_defined(guard_it->second)))
+	{
+		if (!expect(tokenid::end_of_line))
+			consume_until(tokenid::end_of_line);
+		return;
+	}
+
+	std::shared_ptr<const std::string> input;
 
 	if (const auto file_it = _file_cache.find(file_path_string);
 		file_it != _file_cache.end())
@@ -757,7 +1472,8 @@ void reshadefx::preprocessor::parse_include()
 	}
 	else
 	{
-		if (!read_file(file_path, input))
+		if (input = read_file_shared(file_path);
+			input == nullptr)
 			return error(keyword_location, "could not open included file '" + file_name.u8string() + '\'');
 
 		_file_cache.emplace(file_path_string, input);
@@ -772,6 +1488,38 @@ void reshadefx::preprocessor::parse_include()
 		_input_stack.pop_back();
 
 	push(std::move(input), file_path_string);
+
+	// Start include guard detection for this file (unless it was empty and popped right away again)
+	if (_next_input_index == _input_stack.size() - 1)
+		_input_stack.back().guard_state = include_guard_state::before_guard;
+}
+
+std::filesystem::path reshadefx::preprocessor::resolve_include(const std::string &source, const std::filesystem::path &file_name, bool record_if_not_found)
+{
+	// Look next to the including file first, then in the include paths in order
+	std::filesystem::path file_path = std::filesystem::u8path(source);
+	file_path.replace_filename(file_name);
+
+	// Only candidates that would take precedence over the file that is eventually found can change the result when they are created, so keep track of them until it is clear which that is
+	std::vector<std::string> missing_candidates;
+
+	std::error_code ec;
+	for (auto include_path_it = _include_paths.begin(); !std::filesystem::exists(file_path, ec); ++include_path_it)
+	{
+		missing_candidates.push_back(file_path.u8string());
+
+		if (include_path_it == _include_paths.end())
+		{
+			if (record_if_not_found)
+				_missing_files.insert(missing_candidates.begin(), missing_candidates.end());
+			return file_path;
+		}
+
+		file_path = *include_path_it / file_name;
+	}
+
+	_missing_files.insert(missing_candidates.begin(), missing_candidates.end());
+	return file_path;
 }
 
 bool reshadefx::preprocessor::evaluate_expression()
@@ -926,19 +1674,12 @@ bool reshadefx::preprocessor::evaluate_expression()
 				if (!expect(tokenid::string_literal))
 					return false;
 
-				std::filesystem::path file_name = std::filesystem::u8path(_token.literal_as_string);
-				std::filesystem::path file_path = std::filesystem::u8path(_output_location.source);
-				file_path.replace_filename(file_name);
+				const std::filesystem::path file_path = resolve_include(_output_location.source, std::filesystem::u8path(_token.literal_as_string), true);
 
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
 
 				std::error_code ec;
-				if (!std::filesystem::exists(file_path, ec))
-					for (const std::filesystem::path &include_path : _include_paths)
-						if (std::filesystem::exists(file_path = include_path / file_name, ec))
-							break;
-
 				rpn[rpn_index++] = { std::filesystem::exists(file_path, ec) ? 1 : 0, false };
 				continue;
 			}
@@ -949,7 +1690,7 @@ bool reshadefx::preprocessor::evaluate_expression()
 				if (!expect(tokenid::identifier))
 					return false;
 
-				const std::string macro_name = std::move(_token.literal_as_string);
+				const std::string macro_name(_token.literal_as_string);
 
 				if (has_parentheses && !expect(tokenid::parenthesis_close))
 					return false;
@@ -1143,14 +1884,16 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 		return true;
 	}
 
-	const auto macro_it = _macros.find(_token.literal_as_string);
+	const std::string macro_name(_token.literal_as_string);
+
+	const auto macro_it = _macros.find(macro_name);
 	if (macro_it == _macros.end())
 		return false;
 
 	if (!_input_stack.empty())
 	{
 		const std::unordered_set<std::string> &hidden_macros = _input_stack[_current_input_index].hidden_macros;
-		if (hidden_macros.find(_token.literal_as_string) != hidden_macros.end())
+		if (hidden_macros.find(macro_name) != hidden_macros.end())
 			return false;
 	}
 
@@ -1158,7 +1901,7 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 	if (_recursion_count++ >= 256)
 		return error(macro_location, "macro recursion too high"), false;
 
-	std::vector<std::string> arguments;
+	std::vector<macro_argument> arguments;
 	if (macro_it->second.is_function_like)
 	{
 		if (!accept(tokenid::parenthesis_open))
@@ -1167,7 +1910,7 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 		while (true)
 		{
 			int parentheses_level = 0;
-			std::string argument;
+			macro_argument argument;
 
 			// Ignore whitespace preceding the argument
 			accept(tokenid::space);
@@ -1192,14 +1935,19 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 
 				// Collapse all whitespace down to a single space
 				if (_token == tokenid::space)
-					argument += ' ';
+					append_token(argument.text, argument.tokens, argument.is_prelexed, _token, " ");
 				else
-					argument += _current_token_raw_data;
+					append_token(argument.text, argument.tokens, argument.is_prelexed, _token, _current_token_raw_data);
 			}
 
 			// Trim whitespace following the argument
-			if (argument.size() && argument.back() == ' ')
-				argument.pop_back();
+			if (argument.text.size() && argument.text.back() == ' ')
+			{
+				argument.text.pop_back();
+
+				if (argument.is_prelexed && --argument.tokens.back().length == 0)
+					argument.tokens.pop_back();
+			}
 
 			arguments.push_back(std::move(argument));
 
@@ -1208,6 +1956,10 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 		}
 	}
 
+	// Lex the replacement list on first use, so that expansions can operate on its tokens directly from then on
+	if (macro_it->second.replacement_tokens.empty())
+		macro_it->second.replacement_tokens = lex_replacement_list(macro_it->second.replacement_list);
+
 	expand_macro(macro_it->first, macro_it->second, arguments);
 
 	return true;
@@ -1225,7 +1977,7 @@ bool reshadefx::preprocessor::is_defined(const std::string &name) const
 		name == "__FILE_NAME_HASH__";
 }
 
-void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &definition, const std::vector<std::string> &arguments)
+void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &definition, const std::vector<macro_argument> &arguments)
 {
 	if (definition.replacement_list.empty())
 		return;
@@ -1236,38 +1988,70 @@ void reshadefx::preprocessor::expand_macro(const std::string &name, const macro
 	if (arguments.size() > definition.parameters.size() && !definition.is_variadic)
 		return warning(_token.location, "too many arguments for function-like macro invocation '" + name + "'");
 
+	// Build the token sequence of the expansion alongside its text, so that it does not need to be lexed again (unless that is not possible, see 'append_token')
 	std::string input;
 	input.reserve(definition.replacement_list.size());
+	std::vector<prelexed_token> input_tokens;
+	input_tokens.reserve(definition.replacement_tokens.size());
+	bool is_prelexed = true;
+
+	prelexed_token string_literal_token = {};
+	string_literal_token.id = tokenid::string_literal;
 
-	for (size_t offset = 0; offset < definition.replacement_list.size(); ++offset)
+	for (const prelexed_token &replacement_token : definition.replacement_tokens)
 	{
-		if (definition.replacement_list[offset] != macro_replacement_start)
+		const size_t offset = replacement_token.offset;
+
+		if (replacement_token != tokenid::unknown || definition.replacement_list[offset] != macro_replacement_start)
 		{
-			input += definition.replacement_list[offset];
+			append_token(input, input_tokens, is_prelexed, replacement_token, std::string_view(definition.replacement_list).substr(offset, replacement_token.length));
 			continue;
 		}
 
 		// This is a special replacement sequence
-		const char type = definition.replacement_list[++offset];
-		const char index = definition.replacement_list[++offset];
+		const char type = definition.replacement_list[offset + 1];
+		const char index = definition.replacement_list[offset + 2];
 		if (static_cast<size_t>(index) >= arguments.size())
 		{
 			if (definition.is_variadic)
 			{
 				// The concatenation operator has a special meaning when placed between a comma and a variable argument, deleting the preceding comma
 				if (type == macro_replacement_concat && input.back() == ',')
+				{
 					input.pop_back();
+
+					if (is_prelexed)
+						input_tokens.pop_back();
+				}
 				if (type == macro_replacement_stringize)
-					input += "\"\"";
+					append_token(input, input_tokens, is_prelexed, string_literal_token, "\"\"");
 			}
 			continue;
 		}
 
+		const macro_argument &argument = arguments[index];
+
 		switch (type)
 		{
 		case macro_replacement_argument:
 			// Argument prescan
-			push(arguments[index] + static_cast<char>(macro_replacement_argument));
+			if (argument.is_prelexed)
+			{
+				std::vector<prelexed_token> argument_tokens;
+				argument_tokens.reserve(argument.tokens.size() + 1);
+				argument_tokens.insert(argument_tokens.end(), argument.tokens.begin(), argument.tokens.end());
+				prelexed_token &end_token = argument_tokens.emplace_back();
+				end_token.id = tokenid::unknown;
+				end_token.offset = argument.text.size();
+				end_token.length = 1;
+				end_token.literal_as_double = 0;
+
+				push(std::make_shared<const std::string>(argument.text + static_cast<char>(macro_replacement_argument)), std::move(argument_tokens));
+			}
+			else
+			{
+				push(argument.text + static_cast<char>(macro_replacement_argument));
+			}
 			while (true)
 			{
 				// Consume all tokens of the argument (until the end marker is reached)
@@ -1278,21 +2062,42 @@ void reshadefx::preprocessor::expand_macro(const std::string &name, const macro
 				if (_token == tokenid::identifier && evaluate_identifier_as_macro())
 					continue;
 
-				input += _current_token_raw_data;
+				append_token(input, input_tokens, is_prelexed, _token, _current_token_raw_data);
 			}
 			assert(_current_token_raw_data[0] == macro_replacement_argument);
 			break;
 		case macro_replacement_concat:
-			input += arguments[index];
+			if (argument.is_prelexed)
+			{
+				for (const prelexed_token &argument_token : argument.tokens)
+					append_token(input, input_tokens, is_prelexed, argument_token, std::string_view(argument.text).substr(argument_token.offset, argument_token.length));
+			}
+			else
+			{
+				input += argument.text;
+				is_prelexed = false;
+			}
 			break;
 		case macro_replacement_stringize:
 			// Adds backslashes to escape quotes
-			input += escape_string<'\"'>(arguments[index]);
+			// The lexer does not handle escaped quotes in preprocessor string literals, so only a string without any quotes is lexed as a single token
+			if (argument.text.find('\"') == std::string::npos)
+			{
+				append_token(input, input_tokens, is_prelexed, string_literal_token, escape_string<'\"'>(argument.text));
+			}
+			else
+			{
+				input += escape_string<'\"'>(argument.text);
+				is_prelexed = false;
+			}
 			break;
 		}
 	}
 
-	push(std::move(input));
+	if (is_prelexed)
+		push(std::make_shared<const std::string>(std::move(input)), std::move(input_tokens));
+	else
+		push(std::move(input));
 
 	// Avoid expanding macros again that are referencing themselves
 	_input_stack[_current_input_index].hidden_macros.insert(name);
@@ -6,7 +6,7 @@
 #pragma once
 
 #include "effect_token.hpp"
-#include <memory> // std::unique_ptr
+#include <memory> // std::shared_ptr, std::unique_ptr
 #include <filesystem>
 #include <unordered_map>
 #include <unordered_set>
@@ -19,6 +19,24 @@ namespace reshadefx
 	class preprocessor
 	{
 	public:
+		/// <summary>
+		/// A token of a pre-lexed replacement list or macro argument. Unlike <see cref="token"/> this does not store a location or string view (those are filled in when the token is consumed), which keeps it trivially copyable.
+		/// </summary>
+		struct prelexed_token
+		{
+			tokenid id;
+			size_t offset, length;
+			union
+			{
+				int literal_as_int;
+				unsigned int literal_as_uint;
+				float literal_as_float;
+				double literal_as_double;
+			};
+
+			operator tokenid() const { return id; }
+		};
+
 		struct macro
 		{
 			std::string replacement_list;
@@ -26,6 +44,10 @@ namespace reshadefx
 			bool is_predefined = false;
 			bool is_variadic = false;
 			bool is_function_like = false;
+			/// <summary>
+			/// Tokens of the replacement list, lexed once when the macro is first expanded. Special replacement sequences are represented by <see cref="tokenid::unknown"/> tokens.
+			/// </summary>
+			std::vector<prelexed_token> replacement_tokens;
 		};
 
 		// Define constructor explicitly because lexer class is not included here
@@ -70,6 +92,35 @@ namespace reshadefx
 		/// <returns><see langword="true"/> if parsing was successful, <see langword="false"/> otherwise.</returns>
 		bool append_string(std::string source_code, const std::filesystem::path &path = std::filesystem::path());
 
+		/// <summary>
+		/// Gets the header prefix of the specified file, which consists of the '#include' directives at its beginning (preceded by nothing but whitespace and comments).
+		/// </summary>
+		/// <param name="path">Path to the file to read.</param>
+		/// <returns>The '#include' directives on the same lines as in the file (with all other lines left empty), or an empty string if the file does not start with any.</returns>
+		static std::string read_header_prefix(const std::filesystem::path &path);
+		/// <summary>
+		/// Parses a header prefix (see <see cref="read_header_prefix"/>) and appends it to the output. A following call to <see cref="append_file"/> with a file that starts with the same header prefix then skips over it.
+		/// Saving a snapshot in between allows to reuse the result for all files that start with the same includes.
+		/// </summary>
+		/// <param name="header_prefix">Header prefix to parse.</param>
+		/// <param name="path">Path to the file the header prefix belongs to, which is used to resolve relative includes.</param>
+		/// <returns><see langword="true"/> if parsing was successful, <see langword="false"/> otherwise.</returns>
+		bool append_header_prefix(const std::string &header_prefix, const std::filesystem::path &path);
+
+		/// <summary>
+		/// Saves the macro definitions, output and list of included files produced so far into a precompiled header snapshot.
+		/// </summary>
+		std::string save_snapshot() const;
+		/// <summary>
+		/// Resumes from a precompiled header snapshot instead of parsing the same input again.
+		/// This has to be called before appending any input, after adding the same macro definitions and include paths as when the snapshot was saved.
+		/// </summary>
+		/// <param name="snapshot">Snapshot data returned by <see cref="save_snapshot"/>.</param>
+		/// <param name="header_prefix">Header prefix the snapshot has to be saved after (see <see cref="append_header_prefix"/>).</param>
+		/// <param name="path">Path to the file the header prefix belongs to, which has to be in the same directory as the one the snapshot was saved for.</param>
+		/// <returns><see langword="true"/> if the snapshot was restored, <see langword="false"/> if it is invalid, does not match, any of the included files changed or any of the files that were looked up but missing were created since it was saved, or an include of the header prefix now resolves to a different file.</returns>
+		bool load_snapshot(const std::string &snapshot, const std::string &header_prefix = std::string(), const std::filesystem::path &path = std::filesystem::path());
+
 		/// <summary>
 		/// Gets the list of error messages.
 		/// </summary>
@@ -83,6 +134,11 @@ namespace reshadefx
 		/// Gets a list of paths to all the included files.
 		/// </summary>
 		std::vector<std::filesystem::path> included_files() const;
+		/// <summary>
+		/// Gets a list of paths that were looked up for '#include' directives or 'exists' checks and did not exist, but would have been used instead of the file that was found (or instead of none being found for 'exists' checks).
+		/// The output may change when any of these files are created later on.
+		/// </summary>
+		std::vector<std::filesystem::path> missing_files() const;
 
 		/// <summary>
 		/// Gets a list of all defines that were used in #ifdef and #ifndef lines.
@@ -90,6 +146,12 @@ namespace reshadefx
 		std::vector<std::pair<std::string, std::string>> used_macro_definitions() const;
 
 	private:
+		struct macro_argument
+		{
+			std::string text;
+			std::vector<prelexed_token> tokens;
+			bool is_prelexed = true;
+		};
 		struct if_level
 		{
 			bool value;
@@ -97,18 +159,34 @@ namespace reshadefx
 			token pp_token;
 			size_t input_index;
 		};
+		enum class include_guard_state
+		{
+			none,
+			before_guard,
+			inside_guard,
+			after_guard,
+		};
 		struct input_level
 		{
 			std::string name;
 			std::unique_ptr<class lexer> lexer;
+			std::shared_ptr<const std::string> input;
+			std::vector<prelexed_token> tokens;
+			size_t next_token_index = 0;
+			location next_token_location;
 			token next_token;
 			std::unordered_set<std::string> hidden_macros;
+			include_guard_state guard_state = include_guard_state::none;
+			std::string guard_macro;
+			size_t guard_if_index = 0;
 		};
 
 		void error(const location &location, const std::string &message);
 		void warning(const location &location, const std::string &message);
 
 		void push(std::string input, const std::string &name = std::string());
+		void push(std::shared_ptr<const std::string> input, const std::string &name = std::string());
+		void push(std::shared_ptr<const std::string> input, std::vector<prelexed_token> tokens);
 
 		bool peek(tokenid tokid) const;
 		void consume();
@@ -130,20 +208,23 @@ namespace reshadefx
 		void parse_pragma();
 		void parse_include();
 
+		std::filesystem::path resolve_include(const std::string &source, const std::filesystem::path &file_name, bool record_if_not_found);
+
 		bool evaluate_expression();
 		bool evaluate_identifier_as_macro();
 
 		bool is_defined(const std::string &name) const;
-		void expand_macro(const std::string &name, const macro &definition, const std::vector<std::string> &arguments);
+		void expand_macro(const std::string &name, const macro &definition, const std::vector<macro_argument> &arguments);
 		void create_macro_replacement_list(macro &definition);
 
 		std::string _output, _errors;
 
 		std::vector<input_level> _input_stack;
+		std::unique_ptr<class lexer> _last_input_lexer;
 		size_t _next_input_index = 0;
 		size_t _current_input_index = 0;
 		reshadefx::token _token;
-		std::string _current_token_raw_data;
+		std::string_view _current_token_raw_data;
 		reshadefx::location _output_location;
 
 		unsigned short _recursion_count = 0;
@@ -153,6 +234,11 @@ namespace reshadefx
 		std::vector<if_level> _if_stack;
 
 		std::vector<std::filesystem::path> _include_paths;
-		std::unordered_map<std::string, std::string> _file_cache;
+		std::unordered_map<std::string, std::shared_ptr<const std::string>> _file_cache;
+		std::unordered_map<std::string, std::string> _include_guards;
+		std::unordered_set<std::string> _missing_files;
+		std::string _header_prefix;
+		std::string _header_prefix_source;
+		std::vector<std::pair<std::string, std::string>> _header_prefix_includes;
 	};
 }
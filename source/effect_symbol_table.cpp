@@ -4,10 +4,13 @@
  */
 
 #include "effect_symbol_table.hpp"
+#include <cmath> // std::abs, std::sqrt, std::pow, std::ldexp, std::isfinite
 #include <cassert>
 #include <malloc.h> // alloca
-#include <algorithm> // std::upper_bound, std::sort
+#include <algorithm> // std::all_of, std::min, std::max, std::upper_bound, std::sort
 #include <functional> // std::greater
+#include <string_view>
+#include <unordered_map>
 
 enum class intrinsic_id
 {
@@ -141,6 +144,33 @@ static const intrinsic s_intrinsics[] =
 #undef float3
 #undef float4
 
+/// <summary>
+/// Gets the range of overloads in <see cref="s_intrinsics"/> with the specified name.
+/// </summary>
+static std::pair<const intrinsic *, const intrinsic *> find_intrinsic_overloads(const std::string &name)
+{
+	// Overloads of the same intrinsic are defined next to each other, so index them by name once
+	static const std::unordered_map<std::string_view, std::pair<const intrinsic *, const intrinsic *>> s_intrinsic_overloads = []() {
+		std::unordered_map<std::string_view, std::pair<const intrinsic *, const intrinsic *>> overloads;
+		for (const intrinsic *it = std::begin(s_intrinsics); it != std::end(s_intrinsics);)
+		{
+			const intrinsic *const overloads_begin = it;
+			while (++it != std::end(s_intrinsics) && it->name == overloads_begin->name)
+				continue;
+
+			assert(overloads.find(overloads_begin->name) == overloads.end()); // Overloads of an intrinsic may not be split across multiple ranges
+			overloads.emplace(overloads_begin->name, std::make_pair(overloads_begin, it));
+		}
+		return overloads;
+	}();
+
+	if (const auto it = s_intrinsic_overloads.find(name);
+		it != s_intrinsic_overloads.end())
+		return it->second;
+	else
+		return {};
+}
+
 unsigned int reshadefx::type::rank(const type &src, const type &dst)
 {
 	if (src.is_array() != dst.is_array() || (src.array_length != dst.array_length && src.is_bounded_array() && dst.is_bounded_array()))
@@ -202,9 +232,9 @@ void reshadefx::symbol_table::leave_scope()
 {
 	assert(_current_scope.level > 0);
 
-	for (auto &symbol : _symbol_stack)
+	while (!_scope_symbols.empty() && _scope_symbols.back().first >= _current_scope.level)
 	{
-		std::vector<scoped_symbol> &scope_list = symbol.second;
+		std::vector<scoped_symbol> &scope_list = *_scope_symbols.back().second;
 
 		for (auto scope_it = scope_list.begin(); scope_it != scope_list.end();)
 		{
@@ -218,6 +248,8 @@ void reshadefx::symbol_table::leave_scope()
 				++scope_it;
 			}
 		}
+
+		_scope_symbols.pop_back();
 	}
 
 	_current_scope.level--;
@@ -271,7 +303,12 @@ bool reshadefx::symbol_table::insert_symbol(const std::string &name, const symbo
 	else
 	{
 		// This is a local symbol so it's sufficient to update the symbol stack with just the current scope
-		insert_sorted(_symbol_stack[name], scoped_symbol { symbol, _current_scope });
+		std::vector<scoped_symbol> &scope_list = _symbol_stack[name];
+		insert_sorted(scope_list, scoped_symbol { symbol, _current_scope });
+
+		// Remember to remove it again when leaving this scope (symbols in namespace scope are kept)
+		if (_current_scope.level > _current_scope.namespace_level)
+			_scope_symbols.emplace_back(_current_scope.level, &scope_list);
 	}
 
 	return true;
@@ -310,7 +347,7 @@ reshadefx::scoped_symbol reshadefx::symbol_table::find_symbol(const std::string
 	return result;
 }
 
-static int compare_functions(const std::vector<reshadefx::expression> &arguments, const reshadefx::function *function1, const reshadefx::function *function2)
+static int compare_functions(const std::pmr::vector<reshadefx::expression> &arguments, const reshadefx::function *function1, const reshadefx::function *function2)
 {
 	const size_t num_arguments = arguments.size();
 
@@ -359,7 +396,7 @@ static int compare_functions(const std::vector<reshadefx::expression> &arguments
 	return 0; // Both functions are equally viable
 }
 
-bool reshadefx::symbol_table::resolve_function_call(const std::string &name, const std::vector<expression> &arguments, const scope &scope, symbol &out_data, bool &is_ambiguous) const
+bool reshadefx::symbol_table::resolve_function_call(const std::string &name, const std::pmr::vector<expression> &arguments, const scope &scope, symbol &out_data, bool &is_ambiguous) const
 {
 	out_data.op = symbol_type::function;
 
@@ -426,9 +463,13 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 	// Try matching against intrinsic functions if no matching user-defined function was found up to this point
 	if (num_overloads == 0)
 	{
-		for (const intrinsic &intrinsic : s_intrinsics)
+		const auto [overloads_begin, overloads_end] = find_intrinsic_overloads(name);
+
+		for (const intrinsic *it = overloads_begin; it != overloads_end; ++it)
 		{
-			if (intrinsic.name != name || intrinsic.parameter_list.size() != arguments.size())
+			const intrinsic &intrinsic = *it;
+
+			if (intrinsic.parameter_list.size() != arguments.size())
 				continue;
 
 			// A new possibly-matching intrinsic function was found, compare it against the current result
@@ -454,3 +495,26 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 
 	return num_overloads == 1;
 }
+
+bool reshadefx::symbol_table::evaluate_constant_intrinsic_call(uint32_t intrinsic, const type &res_type, const std::pmr::vector<expression> &args, constant &result)
+{
+	assert(std::all_of(args.begin(), args.end(), [](const expression &arg) { return arg.is_constant && arg.constant.array_data.empty(); }));
+
+	result = {};
+
+	switch (static_cast<intrinsic_id>(intrinsic))
+	{
+#define IMPLEMENT_INTRINSIC_FOLD(name, i, code) case intrinsic_id::name##i: code break;
+	#include "effect_symbol_table_intrinsics.inl"
+	default:
+		return false;
+	}
+
+	// Leave calls that produce infinity or NaN (e.g. 'rcp(0.0)' or 'log(0.0)') to be evaluated at runtime, since such constants cannot be represented in generated code consistently
+	if (res_type.is_floating_point())
+		for (unsigned int c = 0; c < res_type.components(); ++c)
+			if (!std::isfinite(result.as_float[c]))
+				return false;
+
+	return true;
+}
@@ -93,11 +93,23 @@ namespace reshadefx
 		/// <summary>
 		/// Searches for the best function or intrinsic overload matching the argument list.
 		/// </summary>
-		bool resolve_function_call(const std::string &name, const std::vector<expression> &args, const scope &scope, symbol &data, bool &ambiguous) const;
+		bool resolve_function_call(const std::string &name, const std::pmr::vector<expression> &args, const scope &scope, symbol &data, bool &ambiguous) const;
+
+		/// <summary>
+		/// Evaluates a call to an intrinsic at compile time if it is a pure math function.
+		/// </summary>
+		/// <param name="intrinsic">Id of the intrinsic overload returned by <see cref="resolve_function_call"/>.</param>
+		/// <param name="res_type">Return type of the intrinsic overload.</param>
+		/// <param name="args">Constant arguments, already converted to the parameter types of the overload.</param>
+		/// <param name="result">Constant that receives the result of the call.</param>
+		/// <returns><see langword="true"/> if the call was folded, <see langword="false"/> if it has to be evaluated at runtime (because the intrinsic is not a pure math function or the result is not finite).</returns>
+		static bool evaluate_constant_intrinsic_call(uint32_t intrinsic, const type &res_type, const std::pmr::vector<expression> &args, constant &result);
 
 	private:
 		scope _current_scope;
 		// Lookup table from name to matching symbols
 		std::unordered_map<std::string, std::vector<scoped_symbol>> _symbol_stack;
+		// Symbol lists local symbols were inserted into (together with the scope level they were inserted at), so that leaving a scope only has to visit those
+		std::vector<std::pair<uint32_t, std::vector<scoped_symbol> *>> _scope_symbols;
 	};
 }
@@ -15,6 +15,9 @@
 #if defined(__INTELLISENSE__) || !defined(IMPLEMENT_INTRINSIC_SPIRV)
 #define IMPLEMENT_INTRINSIC_SPIRV(name, i, code)
 #endif
+#if defined(__INTELLISENSE__) || !defined(IMPLEMENT_INTRINSIC_FOLD)
+#define IMPLEMENT_INTRINSIC_FOLD(name, i, code)
+#endif
 
 // ret abs(x)
 DEFINE_INTRINSIC(abs, 0, int, int)
@@ -51,6 +54,14 @@ IMPLEMENT_INTRINSIC_SPIRV(abs, 1, {
 		.add(spv::GLSLstd450FAbs)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(abs, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_int[c] = std::abs(args[0].constant.as_int[c]);
+	})
+IMPLEMENT_INTRINSIC_FOLD(abs, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::abs(args[0].constant.as_float[c]);
+	})
 
 // ret all(x)
 DEFINE_INTRINSIC(all, 0, bool, bool)
@@ -77,6 +88,14 @@ IMPLEMENT_INTRINSIC_SPIRV(all, 1, {
 	add_instruction(spv::OpAll, convert_type(res_type))
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(all, 0, {
+	result.as_uint[0] = args[0].constant.as_uint[0];
+	})
+IMPLEMENT_INTRINSIC_FOLD(all, 1, {
+	result.as_uint[0] = 1;
+	for (unsigned int c = 0; c < args[0].type.components(); ++c)
+		result.as_uint[0] &= args[0].constant.as_uint[c] != 0;
+	})
 
 // ret any(x)
 DEFINE_INTRINSIC(any, 0, bool, bool)
@@ -103,6 +122,14 @@ IMPLEMENT_INTRINSIC_SPIRV(any, 1, {
 	add_instruction(spv::OpAny, convert_type(res_type))
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(any, 0, {
+	result.as_uint[0] = args[0].constant.as_uint[0];
+	})
+IMPLEMENT_INTRINSIC_FOLD(any, 1, {
+	result.as_uint[0] = 0;
+	for (unsigned int c = 0; c < args[0].type.components(); ++c)
+		result.as_uint[0] |= args[0].constant.as_uint[c] != 0;
+	})
 
 // ret asin(x)
 DEFINE_INTRINSIC(asin, 0, float, float)
@@ -122,6 +149,10 @@ IMPLEMENT_INTRINSIC_SPIRV(asin, 0, {
 		.add(spv::GLSLstd450Asin)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(asin, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::asin(args[0].constant.as_float[c]);
+	})
 
 // ret acos(x)
 DEFINE_INTRINSIC(acos, 0, float, float)
@@ -141,6 +172,10 @@ IMPLEMENT_INTRINSIC_SPIRV(acos, 0, {
 		.add(spv::GLSLstd450Acos)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(acos, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::acos(args[0].constant.as_float[c]);
+	})
 
 // ret atan(x)
 DEFINE_INTRINSIC(atan, 0, float, float)
@@ -160,6 +195,10 @@ IMPLEMENT_INTRINSIC_SPIRV(atan, 0, {
 		.add(spv::GLSLstd450Atan)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(atan, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::atan(args[0].constant.as_float[c]);
+	})
 
 // ret atan2(x, y)
 DEFINE_INTRINSIC(atan2, 0, float, float, float)
@@ -180,6 +219,10 @@ IMPLEMENT_INTRINSIC_SPIRV(atan2, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(atan2, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::atan2(args[0].constant.as_float[c], args[1].constant.as_float[c]);
+	})
 
 // ret sin(x)
 DEFINE_INTRINSIC(sin, 0, float, float)
@@ -199,6 +242,10 @@ IMPLEMENT_INTRINSIC_SPIRV(sin, 0, {
 		.add(spv::GLSLstd450Sin)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(sin, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::sin(args[0].constant.as_float[c]);
+	})
 
 // ret sinh(x)
 DEFINE_INTRINSIC(sinh, 0, float, float)
@@ -218,6 +265,10 @@ IMPLEMENT_INTRINSIC_SPIRV(sinh, 0, {
 		.add(spv::GLSLstd450Sinh)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(sinh, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::sinh(args[0].constant.as_float[c]);
+	})
 
 // ret cos(x)
 DEFINE_INTRINSIC(cos, 0, float, float)
@@ -237,6 +288,10 @@ IMPLEMENT_INTRINSIC_SPIRV(cos, 0, {
 		.add(spv::GLSLstd450Cos)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(cos, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::cos(args[0].constant.as_float[c]);
+	})
 
 // ret cosh(x)
 DEFINE_INTRINSIC(cosh, 0, float, float)
@@ -256,6 +311,10 @@ IMPLEMENT_INTRINSIC_SPIRV(cosh, 0, {
 		.add(spv::GLSLstd450Cosh)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(cosh, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::cosh(args[0].constant.as_float[c]);
+	})
 
 // ret tan(x)
 DEFINE_INTRINSIC(tan, 0, float, float)
@@ -275,6 +334,10 @@ IMPLEMENT_INTRINSIC_SPIRV(tan, 0, {
 		.add(spv::GLSLstd450Tan)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(tan, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::tan(args[0].constant.as_float[c]);
+	})
 
 // ret tanh(x)
 DEFINE_INTRINSIC(tanh, 0, float, float)
@@ -294,6 +357,10 @@ IMPLEMENT_INTRINSIC_SPIRV(tanh, 0, {
 		.add(spv::GLSLstd450Tanh)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(tanh, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::tanh(args[0].constant.as_float[c]);
+	})
 
 // sincos(x, out s, out c)
 DEFINE_INTRINSIC(sincos, 0, void, float, out_float, out_float)
@@ -345,6 +412,10 @@ IMPLEMENT_INTRINSIC_SPIRV(asint, 0, {
 	add_instruction(spv::OpBitcast, convert_type(res_type))
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(asint, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_uint[c] = args[0].constant.as_uint[c];
+	})
 
 // ret asuint(x)
 DEFINE_INTRINSIC(asuint, 0, uint, float)
@@ -365,6 +436,10 @@ IMPLEMENT_INTRINSIC_SPIRV(asuint, 0, {
 	add_instruction(spv::OpBitcast, convert_type(res_type))
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(asuint, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_uint[c] = args[0].constant.as_uint[c];
+	})
 
 // ret asfloat(x)
 DEFINE_INTRINSIC(asfloat, 0, float, int)
@@ -403,6 +478,14 @@ IMPLEMENT_INTRINSIC_SPIRV(asfloat, 1, {
 	add_instruction(spv::OpBitcast, convert_type(res_type))
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(asfloat, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_uint[c] = args[0].constant.as_uint[c];
+	})
+IMPLEMENT_INTRINSIC_FOLD(asfloat, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_uint[c] = args[0].constant.as_uint[c];
+	})
 
 // ret f16tof32(x)
 DEFINE_INTRINSIC(f16tof32, 0, float, uint)
@@ -644,6 +727,10 @@ IMPLEMENT_INTRINSIC_SPIRV(ceil, 0, {
 		.add(spv::GLSLstd450Ceil)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(ceil, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::ceil(args[0].constant.as_float[c]);
+	})
 
 // ret floor(x)
 DEFINE_INTRINSIC(floor, 0, float, float)
@@ -666,6 +753,10 @@ IMPLEMENT_INTRINSIC_SPIRV(floor, 0, {
 		.add(spv::GLSLstd450Floor)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(floor, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::floor(args[0].constant.as_float[c]);
+	})
 
 // ret clamp(x, min, max)
 DEFINE_INTRINSIC(clamp, 0, int, int, int, int)
@@ -725,6 +816,18 @@ IMPLEMENT_INTRINSIC_SPIRV(clamp, 2, {
 		.add(args[1].base)
 		.add(args[2].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(clamp, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_int[c] = std::min(std::max(args[0].constant.as_int[c], args[1].constant.as_int[c]), args[2].constant.as_int[c]);
+	})
+IMPLEMENT_INTRINSIC_FOLD(clamp, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_uint[c] = std::min(std::max(args[0].constant.as_uint[c], args[1].constant.as_uint[c]), args[2].constant.as_uint[c]);
+	})
+IMPLEMENT_INTRINSIC_FOLD(clamp, 2, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::min(std::max(args[0].constant.as_float[c], args[1].constant.as_float[c]), args[2].constant.as_float[c]);
+	})
 
 // ret saturate(x)
 DEFINE_INTRINSIC(saturate, 0, float, float)
@@ -749,6 +852,10 @@ IMPLEMENT_INTRINSIC_SPIRV(saturate, 0, {
 		.add(constant_zero)
 		.add(constant_one);
 	})
+IMPLEMENT_INTRINSIC_FOLD(saturate, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::min(std::max(args[0].constant.as_float[c], 0.0f), 1.0f);
+	})
 
 // ret mad(mvalue, avalue, bvalue)
 DEFINE_INTRINSIC(mad, 0, float, float, float, float)
@@ -773,6 +880,10 @@ IMPLEMENT_INTRINSIC_SPIRV(mad, 0, {
 		.add(args[1].base)
 		.add(args[2].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(mad, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] * args[1].constant.as_float[c] + args[2].constant.as_float[c];
+	})
 
 // ret rcp(x)
 DEFINE_INTRINSIC(rcp, 0, float, float)
@@ -796,6 +907,10 @@ IMPLEMENT_INTRINSIC_SPIRV(rcp, 0, {
 		.add(constant_one)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(rcp, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = 1.0f / args[0].constant.as_float[c];
+	})
 
 // ret pow(x, y)
 DEFINE_INTRINSIC(pow, 0, float, float, float)
@@ -816,6 +931,10 @@ IMPLEMENT_INTRINSIC_SPIRV(pow, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(pow, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::pow(args[0].constant.as_float[c], args[1].constant.as_float[c]);
+	})
 
 // ret exp(x)
 DEFINE_INTRINSIC(exp, 0, float, float)
@@ -835,6 +954,10 @@ IMPLEMENT_INTRINSIC_SPIRV(exp, 0, {
 		.add(spv::GLSLstd450Exp)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(exp, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::exp(args[0].constant.as_float[c]);
+	})
 
 // ret exp2(x)
 DEFINE_INTRINSIC(exp2, 0, float, float)
@@ -854,6 +977,10 @@ IMPLEMENT_INTRINSIC_SPIRV(exp2, 0, {
 		.add(spv::GLSLstd450Exp2)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(exp2, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::exp2(args[0].constant.as_float[c]);
+	})
 
 // ret log(x)
 DEFINE_INTRINSIC(log, 0, float, float)
@@ -873,6 +1000,10 @@ IMPLEMENT_INTRINSIC_SPIRV(log, 0, {
 		.add(spv::GLSLstd450Log)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(log, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::log(args[0].constant.as_float[c]);
+	})
 
 // ret log2(x)
 DEFINE_INTRINSIC(log2, 0, float, float)
@@ -892,6 +1023,10 @@ IMPLEMENT_INTRINSIC_SPIRV(log2, 0, {
 		.add(spv::GLSLstd450Log2)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(log2, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::log2(args[0].constant.as_float[c]);
+	})
 
 // ret log10(x)
 DEFINE_INTRINSIC(log10, 0, float, float)
@@ -917,6 +1052,10 @@ IMPLEMENT_INTRINSIC_SPIRV(log10, 0, {
 	add_instruction(spv::OpFDiv, convert_type(res_type))
 		.add(log2)
 		.add(log10); })
+IMPLEMENT_INTRINSIC_FOLD(log10, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::log10(args[0].constant.as_float[c]);
+	})
 
 // ret sign(x)
 DEFINE_INTRINSIC(sign, 0, int, int)
@@ -953,6 +1092,14 @@ IMPLEMENT_INTRINSIC_SPIRV(sign, 1, {
 		.add(spv::GLSLstd450FSign)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(sign, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_int[c] = (args[0].constant.as_int[c] > 0) - (args[0].constant.as_int[c] < 0);
+	})
+IMPLEMENT_INTRINSIC_FOLD(sign, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = static_cast<float>((args[0].constant.as_float[c] > 0.0f) - (args[0].constant.as_float[c] < 0.0f));
+	})
 
 // ret sqrt(x)
 DEFINE_INTRINSIC(sqrt, 0, float, float)
@@ -972,6 +1119,10 @@ IMPLEMENT_INTRINSIC_SPIRV(sqrt, 0, {
 		.add(spv::GLSLstd450Sqrt)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(sqrt, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::sqrt(args[0].constant.as_float[c]);
+	})
 
 // ret rsqrt(x)
 DEFINE_INTRINSIC(rsqrt, 0, float, float)
@@ -991,6 +1142,10 @@ IMPLEMENT_INTRINSIC_SPIRV(rsqrt, 0, {
 		.add(spv::GLSLstd450InverseSqrt)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(rsqrt, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = 1.0f / std::sqrt(args[0].constant.as_float[c]);
+	})
 
 // ret lerp(x, y, s)
 DEFINE_INTRINSIC(lerp, 0, float, float, float, float)
@@ -1012,6 +1167,10 @@ IMPLEMENT_INTRINSIC_SPIRV(lerp, 0, {
 		.add(args[1].base)
 		.add(args[2].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(lerp, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] + args[2].constant.as_float[c] * (args[1].constant.as_float[c] - args[0].constant.as_float[c]);
+	})
 
 // ret step(y, x)
 DEFINE_INTRINSIC(step, 0, float, float, float)
@@ -1032,6 +1191,10 @@ IMPLEMENT_INTRINSIC_SPIRV(step, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(step, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[1].constant.as_float[c] >= args[0].constant.as_float[c] ? 1.0f : 0.0f;
+	})
 
 // ret smoothstep(min, max, x)
 DEFINE_INTRINSIC(smoothstep, 0, float, float, float, float)
@@ -1053,6 +1216,13 @@ IMPLEMENT_INTRINSIC_SPIRV(smoothstep, 0, {
 		.add(args[1].base)
 		.add(args[2].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(smoothstep, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+	{
+		const float t = std::min(std::max((args[2].constant.as_float[c] - args[0].constant.as_float[c]) / (args[1].constant.as_float[c] - args[0].constant.as_float[c]), 0.0f), 1.0f);
+		result.as_float[c] = t * t * (3.0f - 2.0f * t);
+	}
+	})
 
 // ret frac(x)
 DEFINE_INTRINSIC(frac, 0, float, float)
@@ -1072,6 +1242,10 @@ IMPLEMENT_INTRINSIC_SPIRV(frac, 0, {
 		.add(spv::GLSLstd450Fract)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(frac, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] - std::floor(args[0].constant.as_float[c]);
+	})
 
 // ret ldexp(x, exp)
 DEFINE_INTRINSIC(ldexp, 0, float, float, int)
@@ -1092,6 +1266,10 @@ IMPLEMENT_INTRINSIC_SPIRV(ldexp, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(ldexp, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::ldexp(args[0].constant.as_float[c], args[1].constant.as_int[c]);
+	})
 
 // ret modf(x, out ip)
 DEFINE_INTRINSIC(modf, 0, float, float, out_float)
@@ -1151,6 +1329,10 @@ IMPLEMENT_INTRINSIC_SPIRV(trunc, 0, {
 		.add(spv::GLSLstd450Trunc)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(trunc, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::trunc(args[0].constant.as_float[c]);
+	})
 
 // ret round(x)
 DEFINE_INTRINSIC(round, 0, float, float)
@@ -1208,6 +1390,14 @@ IMPLEMENT_INTRINSIC_SPIRV(min, 1, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(min, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_int[c] = std::min(args[0].constant.as_int[c], args[1].constant.as_int[c]);
+	})
+IMPLEMENT_INTRINSIC_FOLD(min, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::min(args[0].constant.as_float[c], args[1].constant.as_float[c]);
+	})
 
 // ret max(x, y)
 DEFINE_INTRINSIC(max, 0, int, int, int)
@@ -1246,6 +1436,14 @@ IMPLEMENT_INTRINSIC_SPIRV(max, 1, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(max, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_int[c] = std::max(args[0].constant.as_int[c], args[1].constant.as_int[c]);
+	})
+IMPLEMENT_INTRINSIC_FOLD(max, 1, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = std::max(args[0].constant.as_float[c], args[1].constant.as_float[c]);
+	})
 
 // ret degrees(x)
 DEFINE_INTRINSIC(degrees, 0, float, float)
@@ -1265,6 +1463,10 @@ IMPLEMENT_INTRINSIC_SPIRV(degrees, 0, {
 		.add(spv::GLSLstd450Degrees)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(degrees, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] * 57.29577951f;
+	})
 
 // ret radians(x)
 DEFINE_INTRINSIC(radians, 0, float, float)
@@ -1284,6 +1486,10 @@ IMPLEMENT_INTRINSIC_SPIRV(radians, 0, {
 		.add(spv::GLSLstd450Radians)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(radians, 0, {
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] * 0.01745329252f;
+	})
 
 // ret ddx(x)
 DEFINE_INTRINSIC(ddx, 0, float, float)
@@ -1437,6 +1643,14 @@ IMPLEMENT_INTRINSIC_SPIRV(dot, 1, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(dot, 0, {
+	result.as_float[0] = args[0].constant.as_float[0] * args[1].constant.as_float[0];
+	})
+IMPLEMENT_INTRINSIC_FOLD(dot, 1, {
+	result.as_float[0] = 0.0f;
+	for (unsigned int c = 0; c < args[0].type.components(); ++c)
+		result.as_float[0] += args[0].constant.as_float[c] * args[1].constant.as_float[c];
+	})
 
 // ret cross(x, y)
 DEFINE_INTRINSIC(cross, 0, float3, float3, float3)
@@ -1454,6 +1668,11 @@ IMPLEMENT_INTRINSIC_SPIRV(cross, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(cross, 0, {
+	result.as_float[0] = args[0].constant.as_float[1] * args[1].constant.as_float[2] - args[0].constant.as_float[2] * args[1].constant.as_float[1];
+	result.as_float[1] = args[0].constant.as_float[2] * args[1].constant.as_float[0] - args[0].constant.as_float[0] * args[1].constant.as_float[2];
+	result.as_float[2] = args[0].constant.as_float[0] * args[1].constant.as_float[1] - args[0].constant.as_float[1] * args[1].constant.as_float[0];
+	})
 
 // ret length(x)
 DEFINE_INTRINSIC(length, 0, float, float)
@@ -1473,6 +1692,12 @@ IMPLEMENT_INTRINSIC_SPIRV(length, 0, {
 		.add(spv::GLSLstd450Length)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(length, 0, {
+	result.as_float[0] = 0.0f;
+	for (unsigned int c = 0; c < args[0].type.components(); ++c)
+		result.as_float[0] += args[0].constant.as_float[c] * args[0].constant.as_float[c];
+	result.as_float[0] = std::sqrt(result.as_float[0]);
+	})
 
 // ret distance(x, y)
 DEFINE_INTRINSIC(distance, 0, float, float, float)
@@ -1493,6 +1718,12 @@ IMPLEMENT_INTRINSIC_SPIRV(distance, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(distance, 0, {
+	result.as_float[0] = 0.0f;
+	for (unsigned int c = 0; c < args[0].type.components(); ++c)
+		result.as_float[0] += (args[0].constant.as_float[c] - args[1].constant.as_float[c]) * (args[0].constant.as_float[c] - args[1].constant.as_float[c]);
+	result.as_float[0] = std::sqrt(result.as_float[0]);
+	})
 
 // ret normalize(x)
 DEFINE_INTRINSIC(normalize, 0, float2, float2)
@@ -1511,6 +1742,14 @@ IMPLEMENT_INTRINSIC_SPIRV(normalize, 0, {
 		.add(spv::GLSLstd450Normalize)
 		.add(args[0].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(normalize, 0, {
+	float length = 0.0f;
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		length += args[0].constant.as_float[c] * args[0].constant.as_float[c];
+	length = std::sqrt(length);
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] / length;
+	})
 
 // ret transpose(x)
 DEFINE_INTRINSIC(transpose, 0, float2x2, float2x2)
@@ -1570,6 +1809,13 @@ IMPLEMENT_INTRINSIC_SPIRV(reflect, 0, {
 		.add(args[0].base)
 		.add(args[1].base);
 	})
+IMPLEMENT_INTRINSIC_FOLD(reflect, 0, {
+	float d = 0.0f;
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		d += args[0].constant.as_float[c] * args[1].constant.as_float[c];
+	for (unsigned int c = 0; c < res_type.components(); ++c)
+		result.as_float[c] = args[0].constant.as_float[c] - 2.0f * d * args[1].constant.as_float[c];
+	})
 
 // ret refract(i, n, eta)
 DEFINE_INTRINSIC(refract, 0, float2, float2, float2, float)
@@ -4585,3 +4831,4 @@ IMPLEMENT_INTRINSIC_SPIRV(atomicCompareExchange, 1, {
 #undef IMPLEMENT_INTRINSIC_GLSL
 #undef IMPLEMENT_INTRINSIC_HLSL
 #undef IMPLEMENT_INTRINSIC_SPIRV
+#undef IMPLEMENT_INTRINSIC_FOLD
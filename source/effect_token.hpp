@@ -6,6 +6,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 
@@ -272,7 +273,10 @@ namespace reshadefx
 			float literal_as_float;
 			double literal_as_double;
 		};
-		std::string literal_as_string;
+		/// <summary>
+		/// View of the identifier or string literal value. This points into the input string of the lexer that produced this token (or into its table of escaped string literals), so it is only valid for as long as that lexer is alive.
+		/// </summary>
+		std::string_view literal_as_string;
 
 		operator tokenid() const { return id; }
 
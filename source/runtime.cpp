@@ -902,6 +902,7 @@ void reshade::runtime::load_config()
 	config_get("GENERAL", "NoDebugInfo", _no_debug_info);
 	config_get("GENERAL", "NoEffectCache", _no_effect_cache);
 	config_get("GENERAL", "NoReloadOnInit", _no_reload_on_init);
+	config_get("GENERAL", "PackUniforms", _pack_uniforms);
 
 	config_get("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config_get("GENERAL", "PerformanceMode", _performance_mode);
@@ -979,6 +980,7 @@ void reshade::runtime::save_config() const
 	config.set("GENERAL", "NoDebugInfo", _no_debug_info);
 	config.set("GENERAL", "NoEffectCache", _no_effect_cache);
 	config.set("GENERAL", "NoReloadOnInit", _no_reload_on_init);
+	config.set("GENERAL", "PackUniforms", _pack_uniforms);
 
 	config.set("GENERAL", "EffectSearchPaths", _effect_search_paths);
 	config.set("GENERAL", "PerformanceMode", _performance_mode);
@@ -1405,6 +1407,7 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	attributes += "color_format=" + std::to_string(static_cast<uint32_t>(_effect_permutations[permutation_index].color_format)) + ';';
 	attributes += "version=" + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + ';';
 	attributes += "performance_mode=" + std::string(_performance_mode ? "1" : "0") + ';';
+	attributes += "pack_uniforms=" + std::string(_pack_uniforms ? "1" : "0") + ';';
 	attributes += "vendor=" + std::to_string(_vendor_id) + ';';
 	attributes += "device=" + std::to_string(_device_id) + ';';
 
@@ -1469,24 +1472,57 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	attributes += std::to_string(std::filesystem::last_write_time(source_file, ec).time_since_epoch().count());
 	attributes += ';';
 
-	// The actual included files are not known at this point, so detect changes to any ".fxh" files in the search paths
+	// Included files may be resolved differently with other search paths
 	for (const std::filesystem::path &include_path : include_paths)
 	{
-		for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(include_path, std::filesystem::directory_options::skip_permission_denied, ec))
+		attributes += include_path.u8string();
+		attributes += ';';
+	}
+
+	effect &effect = _effects[effect_index];
+
+	// Only the files that were actually included the last time this effect was preprocessed need to be checked for changes, which are either still known or listed in a manifest in the effect cache
+	const std::string dependencies_cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(std::hash<std::string>()(attributes));
+	// Files the preprocessor looked for but did not find are tracked as well, since creating one of them can change the result (e.g. through '#if exists' or a header shadowing one from a later search path)
+	std::vector<std::filesystem::path> dependencies, missing_dependencies;
+	// Other permutations may include different files (e.g. depending on 'BUFFER_COLOR_SPACE'), so only the first one can use the lists that are kept with the effect, all others use their own manifest
+	if (permutation_index == 0 && source_file == effect.source_file && effect.preprocessed)
+	{
+		dependencies = effect.included_files;
+		missing_dependencies = effect.missing_files;
+	}
+	else if (std::string dependencies_data;
+		load_effect_cache(dependencies_cache_id, "deps", dependencies_data))
+	{
+		// The manifest lists the included files, followed by an empty line and the missing files
+		std::vector<std::filesystem::path> *list = &dependencies;
+		for (size_t offset = 0, next; (next = dependencies_data.find('\n', offset)) != std::string::npos; offset = next + 1)
 		{
-			if (entry.path().extension() == L".fxh")
-			{
-				attributes += entry.path().filename().u8string();
-				attributes += '?';
-				attributes += std::to_string(entry.last_write_time(ec).time_since_epoch().count());
-				attributes += ';';
-			}
+			if (next == offset)
+				list = &missing_dependencies;
+			else
+				list->push_back(std::filesystem::u8path(dependencies_data.substr(offset, next - offset)));
 		}
 	}
 
-	effect &effect = _effects[effect_index];
+	const auto hash_with_dependencies = [&attributes, &ec](const std::vector<std::filesystem::path> &included_files, const std::vector<std::filesystem::path> &missing_files) {
+		std::string dependency_attributes = attributes;
+		for (const std::filesystem::path &dependency : included_files)
+		{
+			dependency_attributes += dependency.u8string();
+			dependency_attributes += '?';
+			dependency_attributes += std::to_string(std::filesystem::last_write_time(dependency, ec).time_since_epoch().count());
+			dependency_attributes += ';';
+		}
+		for (const std::filesystem::path &dependency : missing_files)
+		{
+			dependency_attributes += dependency.u8string();
+			dependency_attributes += std::filesystem::exists(dependency, ec) ? "+;" : "-;";
+		}
+		return std::hash<std::string>()(dependency_attributes);
+	};
 
-	const size_t source_hash = std::hash<std::string>()(attributes);
+	size_t source_hash = hash_with_dependencies(dependencies, missing_dependencies);
 	if (permutation_index == 0 && (source_file != effect.source_file || source_hash != effect.source_hash))
 	{
 		if (effect.created)
@@ -1538,37 +1574,37 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 
 	if (!preprocessed && (preprocess_required || (source_cached = load_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source)) == false))
 	{
-		reshadefx::preprocessor pp;
-		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-		pp.add_macro_definition("__RESHADE_PERMUTATION__", permutation_index != 0 ? "1" : "0");
-		pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
-		pp.add_macro_definition("__VENDOR__", std::to_string(_vendor_id));
-		pp.add_macro_definition("__DEVICE__", std::to_string(_device_id));
-		pp.add_macro_definition("__RENDERER__", std::to_string(_renderer_id));
-		pp.add_macro_definition("__APPLICATION__", std::to_string( // Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
-			std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
-		pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_effect_permutations[permutation_index].width));
-		pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_effect_permutations[permutation_index].height));
-		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
-		pp.add_macro_definition("BUFFER_COLOR_SPACE", std::to_string(static_cast<uint32_t>(_effect_permutations[permutation_index].color_space)));
-		pp.add_macro_definition("BUFFER_COLOR_FORMAT", std::to_string(static_cast<uint32_t>(_effect_permutations[permutation_index].color_format)));
-		pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", std::to_string(api::format_bit_depth(_effect_permutations[permutation_index].color_format)));
-
-		for (const std::pair<std::string, std::string> &definition : preprocessor_definitions)
-		{
-			if (definition.first.empty())
-				continue; // Skip invalid definitions
+		const auto setup_preprocessor = [&](reshadefx::preprocessor &pp) {
+			pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+			pp.add_macro_definition("__RESHADE_PERMUTATION__", permutation_index != 0 ? "1" : "0");
+			pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
+			pp.add_macro_definition("__VENDOR__", std::to_string(_vendor_id));
+			pp.add_macro_definition("__DEVICE__", std::to_string(_device_id));
+			pp.add_macro_definition("__RENDERER__", std::to_string(_renderer_id));
+			pp.add_macro_definition("__APPLICATION__", std::to_string( // Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
+				std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
+			pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_effect_permutations[permutation_index].width));
+			pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_effect_permutations[permutation_index].height));
+			pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+			pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+			pp.add_macro_definition("BUFFER_COLOR_SPACE", std::to_string(static_cast<uint32_t>(_effect_permutations[permutation_index].color_space)));
+			pp.add_macro_definition("BUFFER_COLOR_FORMAT", std::to_string(static_cast<uint32_t>(_effect_permutations[permutation_index].color_format)));
+			pp.add_macro_definition("BUFFER_COLOR_BIT_DEPTH", std::to_string(api::format_bit_depth(_effect_permutations[permutation_index].color_format)));
+
+			for (const std::pair<std::string, std::string> &definition : preprocessor_definitions)
+			{
+				if (definition.first.empty())
+					continue; // Skip invalid definitions
 
-			pp.add_macro_definition(definition.first, definition.second.empty() ? "1" : definition.second);
-		}
-		preprocessor_definitions.clear(); // Clear before reusing for used preprocessor definitions below
+				pp.add_macro_definition(definition.first, definition.second.empty() ? "1" : definition.second);
+			}
 
-		for (const std::filesystem::path &include_path : include_paths)
-			pp.add_include_path(include_path);
+			for (const std::filesystem::path &include_path : include_paths)
+				pp.add_include_path(include_path);
+		};
 
 		// Add some conversion macros for compatibility with older versions of ReShade
-		pp.append_string(
+		const std::string compatibility_macros =
 			"#define tex2Doffset(s, coords, offset) tex2D(s, coords, offset)\n"
 			"#define tex2Dlodoffset(s, coords, offset) tex2Dlod(s, coords, offset)\n"
 			"#define tex2Dgather(s, t, c) tex2Dgather##c(s, t)\n"
@@ -1576,7 +1612,48 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			"#define tex2Dgather0 tex2DgatherR\n"
 			"#define tex2Dgather1 tex2DgatherG\n"
 			"#define tex2Dgather2 tex2DgatherB\n"
-			"#define tex2Dgather3 tex2DgatherA\n");
+			"#define tex2Dgather3 tex2DgatherA\n";
+
+		reshadefx::preprocessor pp;
+		setup_preprocessor(pp);
+
+		// Resume from a precompiled header snapshot of the includes at the beginning of the source file, since many effects start with the same ones (e.g. 'ReShade.fxh')
+		bool snapshot_loaded = false;
+		if (const std::string header_prefix = reshadefx::preprocessor::read_header_prefix(source_file);
+			!header_prefix.empty())
+		{
+			// Relative includes in the header prefix resolve differently in another directory, so snapshots cannot be shared between directories
+			std::string snapshot_attributes = source_file.parent_path().u8string() + ';' + header_prefix;
+			for (const std::filesystem::path &include_path : include_paths)
+				snapshot_attributes += include_path.u8string() + ';';
+			for (const std::pair<std::string, std::string> &definition : preprocessor_definitions)
+				snapshot_attributes += definition.first + '=' + definition.second + ';';
+			snapshot_attributes += std::to_string(permutation_index);
+
+			// The snapshot validates macro definitions and included files itself, so a stale one is simply recreated
+			const std::string snapshot_cache_id = "pch-" + std::to_string(_renderer_id) + '-' + std::to_string(std::hash<std::string>()(snapshot_attributes));
+
+			std::string snapshot;
+			snapshot_loaded = load_effect_cache(snapshot_cache_id, "pch", snapshot) && pp.load_snapshot(snapshot, header_prefix, source_file);
+			if (!snapshot_loaded)
+			{
+				reshadefx::preprocessor pch_pp;
+				setup_preprocessor(pch_pp);
+
+				if (pch_pp.append_string(compatibility_macros) && pch_pp.append_header_prefix(header_prefix, source_file))
+				{
+					snapshot = pch_pp.save_snapshot();
+					save_effect_cache(snapshot_cache_id, "pch", snapshot);
+
+					snapshot_loaded = pp.load_snapshot(snapshot, header_prefix, source_file);
+				}
+			}
+		}
+
+		preprocessor_definitions.clear(); // Clear before reusing for used preprocessor definitions below
+
+		if (!snapshot_loaded)
+			pp.append_string(compatibility_macros);
 
 		// Load and preprocess the source file
 		preprocessed = pp.append_file(source_file);
@@ -1604,6 +1681,24 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 				source = "// " + definition.first + '=' + definition.second + '\n' + source;
 			}
 
+			// Write manifest of the included and missing files and update the hash, since they may differ from the ones that were known before
+			dependencies = pp.included_files();
+			std::sort(dependencies.begin(), dependencies.end());
+			missing_dependencies = pp.missing_files();
+			std::sort(missing_dependencies.begin(), missing_dependencies.end());
+
+			std::string dependencies_data;
+			for (const std::filesystem::path &dependency : dependencies)
+				dependencies_data += dependency.u8string() + '\n';
+			dependencies_data += '\n';
+			for (const std::filesystem::path &dependency : missing_dependencies)
+				dependencies_data += dependency.u8string() + '\n';
+			save_effect_cache(dependencies_cache_id, "deps", dependencies_data);
+
+			source_hash = hash_with_dependencies(dependencies, missing_dependencies);
+			if (permutation_index == 0)
+				effect.source_hash = source_hash;
+
 			source_cached = save_effect_cache(source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash), "i", source);
 		}
 
@@ -1615,6 +1710,8 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			// Keep track of included files
 			effect.included_files = pp.included_files();
 			std::sort(effect.included_files.begin(), effect.included_files.end()); // Sort file names alphabetically
+			effect.missing_files = pp.missing_files();
+			std::sort(effect.missing_files.begin(), effect.missing_files.end());
 
 			effect.preprocessed = preprocessed;
 		}
@@ -1643,6 +1740,10 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 			}
 
 			std::sort(effect.definitions.begin(), effect.definitions.end());
+
+			// Keep track of included files, as listed in the manifest
+			effect.included_files = std::move(dependencies);
+			effect.missing_files = std::move(missing_dependencies);
 		}
 	}
 
@@ -1661,12 +1762,13 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 		else
 			shader_model = 51; // D3D12
 
+		// Pack uniform variables to reduce the amount of data uploaded every frame (the effect cache is keyed on this option too)
 		if ((_renderer_id & 0xF0000) == 0)
-			codegen.reset(reshadefx::create_codegen_dxbc(shader_model, !_no_debug_info, _performance_mode, _performance_mode ? 3 : 1));
+			codegen.reset(reshadefx::create_codegen_dxbc(shader_model, !_no_debug_info, _performance_mode, _performance_mode ? 3 : 1, _pack_uniforms));
 		else if (_renderer_id < 0x20000)
-			codegen.reset(reshadefx::create_codegen_glsl(false, !_no_debug_info, _performance_mode, false, true));
+			codegen.reset(reshadefx::create_codegen_glsl(false, !_no_debug_info, _performance_mode, false, true, _pack_uniforms));
 		else // Vulkan uses SPIR-V input
-			codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false));
+			codegen.reset(reshadefx::create_codegen_spirv(true, !_no_debug_info, _performance_mode, false, false, _performance_mode ? 3 : 0, _pack_uniforms));
 
 		reshadefx::parser parser;
 
@@ -1866,7 +1968,8 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 	{
 		if (permutation.cso.empty())
 		{
-			// Compile shader modules
+			const size_t num_entry_points = permutation.module.entry_points.size();
+
 			for (const std::pair<std::string, reshadefx::shader_type> &entry_point : permutation.module.entry_points)
 			{
 				if (entry_point.second == reshadefx::shader_type::compute && !_device->check_capability(api::device_caps::compute_shader))
@@ -1876,26 +1979,80 @@ bool reshade::runtime::load_effect(const std::filesystem::path &source_file, con
 					break;
 				}
 
-				std::string &cso = permutation.cso[entry_point.first];
-				std::string &assembly = permutation.assembly[entry_point.first];
+				// Insert all entries up front, so that the maps are not modified while the worker threads below write into them
+				permutation.cso[entry_point.first];
+				permutation.assembly[entry_point.first];
+			}
 
-				const std::string cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash) + '-' + entry_point.first;
+			// Compile shader modules
+			// The module is immutable after parsing, so entry points can be assembled concurrently (which matters most on D3D, where every one of them goes through the HLSL compiler)
+			if (compiled && num_entry_points != 0)
+			{
+				std::vector<std::string> entry_point_errors(num_entry_points);
+				std::vector<char> entry_point_compiled(num_entry_points, 1);
 
-				if (load_effect_cache(cache_id, "cso", cso) &&
-					load_effect_cache(cache_id, "asm", assembly))
-				{
-					continue;
-				}
-				else
-				{
-					if (!codegen->assemble_code_for_entry_point(entry_point.first, cso, assembly, errors))
+				const auto compile_entry_point = [&](size_t i) {
+					const std::string &entry_point_name = permutation.module.entry_points[i].first;
+
+					std::string &cso = permutation.cso.at(entry_point_name);
+					std::string &assembly = permutation.assembly.at(entry_point_name);
+
+					const std::string cache_id = source_file.stem().u8string() + '-' + std::to_string(_renderer_id) + '-' + std::to_string(source_hash) + '-' + entry_point_name;
+
+					if (load_effect_cache(cache_id, "cso", cso) &&
+						load_effect_cache(cache_id, "asm", assembly))
+						return;
+
+					if (!codegen->assemble_code_for_entry_point(entry_point_name, cso, assembly, entry_point_errors[i]))
 					{
-						compiled = false;
-						break;
+						entry_point_compiled[i] = 0;
+						return;
 					}
 
 					save_effect_cache(cache_id, "cso", cso);
 					save_effect_cache(cache_id, "asm", assembly);
+				};
+
+				// Effects are already loaded on multiple threads in parallel (see 'load_effects'), so only spread the entry points over additional threads when this is the only effect being loaded (e.g. after a single effect was modified), to avoid oversubscribing the processor
+				// That launches threads on every such call, but happens rarely enough for the launch overhead to not matter compared to compilation
+				size_t num_splits = 1;
+				if (const size_t remaining_effects = _reload_remaining_effects;
+					remaining_effects <= 1 || remaining_effects == std::numeric_limits<size_t>::max())
+				{
+					num_splits = std::min(num_entry_points, static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)));
+#ifndef _WIN64
+					// Limit number of threads in 32-bit due to the limited amount of address space being available there and compilation being memory hungry
+					num_splits = std::min(num_splits, static_cast<size_t>(4));
+#endif
+				}
+
+				// Entry points can differ a lot in cost, so have the threads pick them up one by one instead of assigning fixed batches
+				std::atomic<size_t> next_entry_point = 0;
+
+				const auto compile_entry_points = [&]() {
+					// Abort compiling when initialization state changes (indicating that 'on_reset' was called in the meantime)
+					for (size_t i = next_entry_point++; i < num_entry_points && _is_initialized; i = next_entry_point++)
+						compile_entry_point(i);
+				};
+
+				std::vector<std::thread> worker_threads;
+				worker_threads.reserve(num_splits - 1);
+				for (size_t n = 1; n < num_splits; ++n)
+					worker_threads.emplace_back(compile_entry_points);
+				compile_entry_points();
+				for (std::thread &thread : worker_threads)
+					thread.join();
+
+				// Entry points may have been skipped after an abort
+				if (!_is_initialized)
+					compiled = false;
+
+				// Report errors in entry point order, regardless of which order they were assembled in
+				for (size_t i = 0; i < num_entry_points; ++i)
+				{
+					errors += entry_point_errors[i];
+					if (!entry_point_compiled[i])
+						compiled = false;
 				}
 			}
 		}
@@ -2194,6 +2351,69 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 		log::message(log::level::error, "Failed to create query heap for effect file '%s'!", effect.source_file.u8string().c_str());
 	}
 
+	// Subsequent graphics passes in a technique can share a texture descriptor table if their bindings do not conflict, in which case it only needs to be bound once
+	size_t texture_table_count = 0;
+	std::vector<size_t> texture_table_indices(total_pass_count);
+	{
+		const auto texture_name = [&permutation](const reshadefx::texture_binding &binding) -> const std::string & {
+			return permutation.module.samplers[binding.index].texture_name;
+		};
+
+		std::vector<const reshadefx::texture_binding *> table_bindings;
+		std::vector<const std::string *> table_render_target_names;
+
+		for (size_t tech_index = 0, pass_index_in_effect = 0; tech_index < _techniques.size(); ++tech_index)
+		{
+			const technique &tech = _techniques[tech_index];
+
+			if (tech.effect_index != effect_index)
+				continue;
+
+			const technique::pass *prev_pass = nullptr;
+
+			for (const technique::pass &pass : tech.permutations[permutation_index].passes)
+			{
+				bool share_table = prev_pass != nullptr && prev_pass->cs_entry_point.empty() && pass.cs_entry_point.empty();
+
+				for (size_t i = 0; share_table && i < pass.texture_bindings.size(); ++i)
+				{
+					const reshadefx::texture_binding &binding = pass.texture_bindings[i];
+
+					if (const reshadefx::texture_binding *const existing_binding = table_bindings[binding.entry_point_binding];
+						existing_binding != nullptr && (sampler_with_resource_view ? existing_binding->index != binding.index : (existing_binding->srgb != binding.srgb || texture_name(*existing_binding) != texture_name(binding))))
+						share_table = false;
+
+					// Textures bound in a shared table must never be written to by any of the passes using it
+					for (const std::string *render_target_name : table_render_target_names)
+						if (*render_target_name == texture_name(binding))
+							share_table = false;
+				}
+
+				for (int i = 0; share_table && i < 8 && !pass.render_target_names[i].empty(); ++i)
+				{
+					for (const reshadefx::texture_binding *existing_binding : table_bindings)
+						if (existing_binding != nullptr && texture_name(*existing_binding) == pass.render_target_names[i])
+							share_table = false;
+				}
+
+				if (!share_table)
+				{
+					table_bindings.assign(srv_range.count, nullptr);
+					table_render_target_names.clear();
+					++texture_table_count;
+				}
+
+				for (const reshadefx::texture_binding &binding : pass.texture_bindings)
+					table_bindings[binding.entry_point_binding] = &binding;
+				for (int i = 0; i < 8 && !pass.render_target_names[i].empty(); ++i)
+					table_render_target_names.push_back(&pass.render_target_names[i]);
+
+				texture_table_indices[pass_index_in_effect++] = texture_table_count - 1;
+				prev_pass = &pass;
+			}
+		}
+	}
+
 	std::vector<api::descriptor_table_update> descriptor_writes;
 	descriptor_writes.reserve(
 		static_cast<size_t>(cb_range.count) +
@@ -2201,12 +2421,12 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 		static_cast<size_t>(srv_range.count) +
 		static_cast<size_t>(uav_range.count));
 
-	std::vector<api::descriptor_table> shader_resource_view_tables(total_pass_count);
+	std::vector<api::descriptor_table> shader_resource_view_tables(texture_table_count);
 	std::vector<api::descriptor_table> unordered_access_view_tables(total_pass_count);
 
 	uint16_t sampler_list = 0;
 	std::vector<api::sampler_with_resource_view> sampler_descriptors;
-	sampler_descriptors.resize(std::max(sampler_range.count, srv_range.count) * total_pass_count);
+	sampler_descriptors.resize(std::max(sampler_range.count, srv_range.count) * texture_table_count);
 
 	// Create pipeline layout for this effect
 	{
@@ -2281,7 +2501,7 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 
 	if (sampler_range.count != 0)
 	{
-		if (!_device->allocate_descriptor_tables(static_cast<uint32_t>(sampler_with_resource_view ? total_pass_count : 1), permutation.layout, 1, sampler_with_resource_view ? shader_resource_view_tables.data() : &permutation.sampler_table))
+		if (!_device->allocate_descriptor_tables(static_cast<uint32_t>(sampler_with_resource_view ? texture_table_count : 1), permutation.layout, 1, sampler_with_resource_view ? shader_resource_view_tables.data() : &permutation.sampler_table))
 		{
 			log::message(log::level::error, "Failed to create sampler descriptor table for effect file '%s'!", effect.source_file.u8string().c_str());
 			return false;
@@ -2289,7 +2509,7 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 	}
 	if (srv_range.count != 0 && !sampler_with_resource_view)
 	{
-		if (!_device->allocate_descriptor_tables(static_cast<uint32_t>(total_pass_count), permutation.layout, 2, shader_resource_view_tables.data()))
+		if (!_device->allocate_descriptor_tables(static_cast<uint32_t>(texture_table_count), permutation.layout, 2, shader_resource_view_tables.data()))
 		{
 			log::message(log::level::error, "Failed to create texture descriptor table for effect file '%s'!", effect.source_file.u8string().c_str());
 			return false;
@@ -2324,7 +2544,7 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 		for (size_t pass_index = 0; pass_index < tech.permutations[permutation_index].passes.size(); ++pass_index, ++pass_index_in_effect)
 		{
 			technique::pass &pass = tech.permutations[permutation_index].passes[pass_index];
-			pass.texture_table = shader_resource_view_tables[pass_index_in_effect];
+			pass.texture_table = shader_resource_view_tables[texture_table_indices[pass_index_in_effect]];
 			pass.storage_table = unordered_access_view_tables[pass_index_in_effect];
 
 			std::vector<api::pipeline_subobject> subobjects;
@@ -2562,7 +2782,9 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 					sampler_list |= (1 << binding.entry_point_binding);
 				}
 
-				api::sampler &sampler = sampler_descriptors[pass_index_in_effect * sampler_range.count + binding.entry_point_binding].sampler;
+				api::sampler &sampler = sampler_descriptors[texture_table_indices[pass_index_in_effect] * sampler_range.count + binding.entry_point_binding].sampler;
+				if (sampler != 0)
+					continue; // Already initialized by a previous pass sharing the same descriptor table
 
 				const reshadefx::sampler &sampler_info = permutation.module.samplers[binding.index];
 
@@ -2617,14 +2839,16 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 					});
 				assert(sampler_texture != _textures.cend());
 
-				api::resource_view &srv = sampler_descriptors[pass_index_in_effect * srv_range.count + binding.entry_point_binding].view;
+				api::resource_view &srv = sampler_descriptors[texture_table_indices[pass_index_in_effect] * srv_range.count + binding.entry_point_binding].view;
+				if (srv != 0)
+					continue; // Already initialized by a previous pass sharing the same descriptor table
 
 				if (sampler_with_resource_view)
 				{
 					// The sampler and descriptor table update for this 'sampler_with_resource_view' descriptor were already initialized above
 					assert(
 						srv_range.count == sampler_range.count &&
-						sampler_descriptors[pass_index_in_effect * srv_range.count + binding.entry_point_binding].sampler != 0);
+						sampler_descriptors[texture_table_indices[pass_index_in_effect] * srv_range.count + binding.entry_point_binding].sampler != 0);
 				}
 				else
 				{
@@ -2650,7 +2874,7 @@ bool reshade::runtime::create_effect(size_t effect_index, size_t permutation_ind
 						sampler_texture->semantic,
 						pass.texture_table,
 						binding.entry_point_binding,
-						sampler_with_resource_view ? sampler_descriptors[pass_index_in_effect * srv_range.count + binding.entry_point_binding].sampler : api::sampler { 0 },
+						sampler_with_resource_view ? sampler_descriptors[texture_table_indices[pass_index_in_effect] * srv_range.count + binding.entry_point_binding].sampler : api::sampler { 0 },
 						binding.srgb
 					});
 				}
@@ -2715,12 +2939,17 @@ void reshade::runtime::destroy_effect(size_t effect_index, bool unload)
 
 		for (technique::permutation &permutation : tech.permutations)
 		{
+			api::descriptor_table prev_texture_table = {};
+
 			for (technique::pass &pass : permutation.passes)
 			{
 				_device->destroy_pipeline(pass.pipeline);
 				pass.pipeline = {};
 
-				_device->free_descriptor_table(pass.texture_table);
+				// Subsequent passes may share the same texture descriptor table (see 'create_effect'), so only free it once
+				if (pass.texture_table != prev_texture_table)
+					_device->free_descriptor_table(pass.texture_table);
+				prev_texture_table = pass.texture_table;
 				pass.texture_table = {};
 				_device->free_descriptor_table(pass.storage_table);
 				pass.storage_table = {};
@@ -4015,6 +4244,10 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 	bool is_effect_stencil_cleared = false;
 	bool needs_implicit_back_buffer_copy = true; // First pass always needs the back buffer updated
 
+	// Graphics bindings stay valid between subsequent graphics passes, until a compute pass or the call to 'generate_mipmaps' below invalidates them
+	bool graphics_bindings_valid = false;
+	api::descriptor_table current_texture_table = {};
+
 	for (size_t pass_index = 0; pass_index < tech.permutations[permutation_index].passes.size(); ++pass_index)
 	{
 		if (needs_implicit_back_buffer_copy)
@@ -4047,6 +4280,8 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 			// Compute shaders do not write to the back buffer, so no update necessary
 			needs_implicit_back_buffer_copy = false;
 
+			graphics_bindings_valid = false;
+
 			cmd_list->bind_pipeline(api::pipeline_stage::all_compute, pass.pipeline);
 
 			temp_mem<api::resource_usage> state_old, state_new;
@@ -4118,15 +4353,25 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 
 			cmd_list->begin_render_pass(render_target_count, render_target, depth_stencil.view != 0 ? &depth_stencil : nullptr);
 
-			// Reset bindings on every pass (since they get invalidated by the call to 'generate_mipmaps' below)
-			if (effect.cb != 0)
-				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, permutation.layout, 0, permutation.cb_table);
-			if (permutation.sampler_table != 0)
-				assert(!sampler_with_resource_view),
-				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, permutation.layout, 1, permutation.sampler_table);
+			// Reset bindings only when they were invalidated since the last graphics pass (e.g. by the call to 'generate_mipmaps' below)
+			if (!graphics_bindings_valid)
+			{
+				if (effect.cb != 0)
+					cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, permutation.layout, 0, permutation.cb_table);
+				if (permutation.sampler_table != 0)
+					assert(!sampler_with_resource_view),
+					cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, permutation.layout, 1, permutation.sampler_table);
+
+				graphics_bindings_valid = true;
+				current_texture_table = {};
+			}
 			// Setup shader resources after binding render targets, to ensure any OM bindings by the application are unset at this point (e.g. a depth buffer that was bound to the OM and is now bound as shader resource)
-			if (!pass.texture_bindings.empty())
+			// Passes sharing a texture descriptor table never write to any of the textures in it (see 'create_effect'), so it is still valid if it was bound by a previous pass
+			if (!pass.texture_bindings.empty() && pass.texture_table != current_texture_table)
+			{
 				cmd_list->bind_descriptor_table(api::shader_stage::all_graphics, permutation.layout, sampler_with_resource_view ? 1 : 2, pass.texture_table);
+				current_texture_table = pass.texture_table;
+			}
 
 			const api::viewport viewport = {
 				0.0f, 0.0f,
@@ -4197,7 +4442,10 @@ void reshade::runtime::render_technique(technique &tech, api::command_list *cmd_
 
 		// Generate mipmaps for modified resources
 		for (const api::resource_view modified_texture : pass.generate_mipmap_views)
+		{
 			cmd_list->generate_mipmaps(modified_texture);
+			graphics_bindings_valid = false;
+		}
 
 #ifndef NDEBUG
 		cmd_list->end_debug_event();
@@ -281,6 +281,7 @@ namespace reshade
 		bool _no_debug_info = true;
 		bool _no_effect_cache = false;
 		bool _no_reload_on_init = false;
+		bool _pack_uniforms = true;
 		bool _performance_mode = false;
 		bool _effect_load_skipping = false;
 		unsigned int _reload_key_data[4] = {};
@@ -221,6 +221,7 @@ namespace reshade
 		std::string errors;
 
 		std::vector<std::filesystem::path> included_files;
+		std::vector<std::filesystem::path> missing_files;
 		std::vector<std::pair<std::string, std::string>> definitions;
 
 		std::vector<uniform> uniforms;
@@ -0,0 +1,608 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "effect_lexer.hpp"
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_preprocessor.hpp"
+#include <algorithm> // std::max, std::min
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory> // std::unique_ptr
+
+static void print_usage(const char *path)
+{
+	printf(R"(usage: %s [options] <benchmark> [<filename>...]
+
+Runs a throughput benchmark of the effect compiler. Each benchmark works on a generated input by default, or on the given effect files instead, where that applies.
+
+Benchmarks:
+  classify                  Classify every identifier of the input as keyword or name, and every preprocessor directive.
+  constant-table            Compile an effect with a large constant lookup table array to SPIR-V.
+  guarded-includes          Preprocess a generated tree of nested headers that are protected by include guards or '#pragma once' and included many times.
+  lex                       Lex the input both the way the preprocessor does (keeping whitespace and directives) and the way the parser does.
+  many-locals               Compile an effect with about 10000 local variables to HLSL and GLSL.
+  math-parse                Parse an effect that is dominated by calls to intrinsic math functions.
+  nested-blocks             Parse a function with thousands of nested blocks that each declare a couple of local variables.
+  scan                      Lex input dominated by long comment blocks, whitespace runs and identifiers, which are skipped over in bulk.
+
+Options:
+  -h, --help                Print this help.
+  -n <count>                Number of iterations to run. The fastest one is reported. Default is 20.
+  -D <id>=<text>            Define a preprocessor macro.
+  -I <path>                 Add directory to include search path.
+	)", path);
+}
+
+struct bench_options
+{
+	unsigned int iterations = 20;
+	std::vector<std::pair<std::string, std::string>> macro_definitions;
+	std::vector<std::filesystem::path> include_paths;
+	std::vector<std::filesystem::path> source_files;
+};
+
+/// <summary>
+/// Calls <paramref name="func"/> the specified number of times and returns the duration of the fastest call in seconds.
+/// </summary>
+template <typename F>
+static double measure(unsigned int iterations, F &&func)
+{
+	double best_time = std::numeric_limits<double>::max();
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		const auto start_time = std::chrono::high_resolution_clock::now();
+		func();
+		const auto end_time = std::chrono::high_resolution_clock::now();
+		best_time = std::min(best_time, std::chrono::duration<double>(end_time - start_time).count());
+	}
+	return best_time;
+}
+
+static void print_result(const char *name, double time, size_t bytes, size_t items, const char *item_name)
+{
+	if (item_name != nullptr)
+		printf("%-28s %10.3f ms %10.1f MB/s %10.2f M%s/s\n", name, time * 1000.0, bytes / time / 1e6, items / time / 1e6, item_name);
+	else
+		printf("%-28s %10.3f ms %10.1f MB/s\n", name, time * 1000.0, bytes / time / 1e6);
+}
+
+/// <summary>
+/// Generates effect code with the given number of functions, that mixes declarations, comments, literals and arithmetic the way typical effects do.
+/// </summary>
+static std::string generate_effect_source(unsigned int num_functions)
+{
+	std::string source =
+		"// Generated benchmark effect\n"
+		"uniform float Intensity < ui_type = \"slider\"; ui_min = 0.0; ui_max = 1.0; > = 0.5;\n"
+		"texture BackBufferTex : COLOR;\n"
+		"sampler BackBuffer { Texture = BackBufferTex; };\n\n";
+
+	for (unsigned int i = 0; i < num_functions; ++i)
+	{
+		const std::string index = std::to_string(i);
+
+		source += "/* Computes term " + index + " of the benchmark series.\n   Multi-line comments are skipped by the lexer. */\n";
+		source += "float4 Function" + index + "(float4 color : COLOR, float2 texcoord : TEXCOORD) : SV_Target\n{\n";
+		source += "\tconst float scale = " + index + ".5f * Intensity; // Scale factor\n";
+		source += "\tfloat3 value = tex2D(BackBuffer, texcoord * 0x" + std::to_string(i % 10) + "F).rgb;\n";
+		source += "\tif (value.x >= 0.25 && value.y != 1e-3 || !(value.z <= 2u))\n\t\tvalue = saturate(value * scale + float3(1.0, 2.0, 3.0));\n";
+		source += "\tfor (int k = 0; k < 4; ++k)\n\t\tvalue += lerp(color.rgb, value, k / 4.0);\n";
+		source += "\treturn float4(value, dot(value, float3(0.2126, 0.7152, 0.0722)));\n}\n\n";
+	}
+
+	return source;
+}
+
+static std::string read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// <summary>
+/// Returns the raw input sources of a benchmark, which are either the specified files or a single generated effect.
+/// </summary>
+static std::vector<std::string> load_sources(const bench_options &options, unsigned int num_generated_functions)
+{
+	std::vector<std::string> sources;
+	if (options.source_files.empty())
+		sources.push_back(generate_effect_source(num_generated_functions));
+	else
+		for (const std::filesystem::path &source_file : options.source_files)
+			sources.push_back(read_file(source_file));
+	return sources;
+}
+
+static bool bench_classify(const bench_options &options)
+{
+	std::vector<std::string> sources;
+	if (options.source_files.empty())
+	{
+		// Mix of keywords, intrinsic and user names and directives that is classified one identifier at a time
+		static const char *const words[] = {
+			"float4", "return", "color", "if", "texcoord", "sampler", "BackBuffer", "uniform", "static", "const", "saturate", "in", "out",
+			"inout", "for", "Intensity", "while", "struct", "lerp", "namespace", "true", "false", "pass", "int3", "value", "bool2", "float4x4",
+			"technique", "VertexShader", "PixelShader", "RenderTarget", "discard", "min16float3", "unorm", "linear", "centroid", "tex2Dfetch" };
+		static const char *const directives[] = {
+			"#define", "#undef", "#if", "#ifdef", "#ifndef", "#elif", "#else", "#endif", "#include", "#pragma", "#error", "#warning" };
+
+		std::string source;
+		for (size_t i = 0; i < 500000; ++i)
+		{
+			source += words[(i * 7) % std::size(words)];
+			source += (i % 12) == 11 ? '\n' : ' ';
+			if ((i % 120) == 119)
+				source += std::string(directives[(i / 120) % std::size(directives)]) + " NAME\n";
+		}
+		sources.push_back(std::move(source));
+	}
+	else
+	{
+		sources = load_sources(options, 0);
+	}
+
+	size_t total_bytes = 0, num_identifiers = 0;
+	for (const std::string &source : sources)
+	{
+		total_bytes += source.size();
+
+		reshadefx::lexer lexer(source, true, true, false, false, true);
+		for (reshadefx::token tok; (tok = lexer.lex()).id != reshadefx::tokenid::end_of_file;)
+			num_identifiers += tok.id == reshadefx::tokenid::identifier;
+	}
+
+	// Lexing with keyword classification disabled gives the baseline to subtract, to isolate the time spent on classification
+	double times[2] = {};
+	for (int classify = 0; classify < 2; ++classify)
+	{
+		times[classify] = measure(options.iterations, [&]() {
+			for (const std::string &source : sources)
+			{
+				reshadefx::lexer lexer(source, true, true, false, false, classify == 0);
+				while (lexer.lex().id != reshadefx::tokenid::end_of_file)
+					continue;
+			}
+		});
+	}
+
+	print_result("lex without classification", times[0], total_bytes, num_identifiers, "identifiers");
+	print_result("lex with classification", times[1], total_bytes, num_identifiers, "identifiers");
+	printf("%-28s %10.2f ns per identifier\n", "classification", std::max(0.0, times[1] - times[0]) * 1e9 / std::max<size_t>(1, num_identifiers));
+
+	return true;
+}
+
+static void add_macro_definitions_and_include_paths(reshadefx::preprocessor &pp, const bench_options &options)
+{
+	for (const std::pair<std::string, std::string> &definition : options.macro_definitions)
+		pp.add_macro_definition(definition.first, definition.second);
+	for (const std::filesystem::path &include_path : options.include_paths)
+		pp.add_include_path(include_path);
+
+	pp.add_macro_definition("BUFFER_WIDTH", "800");
+	pp.add_macro_definition("BUFFER_HEIGHT", "600");
+	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+}
+
+static bool bench_guarded_includes(const bench_options &options)
+{
+	bench_options pp_options = options;
+
+	std::filesystem::path header_directory;
+	if (pp_options.source_files.empty())
+	{
+		std::error_code ec;
+		header_directory = std::filesystem::temp_directory_path(ec) / "reshadefx_bench_includes";
+		std::filesystem::create_directories(header_directory, ec);
+		if (ec)
+		{
+			std::cerr << "error: failed to create directory " << header_directory << std::endl;
+			return false;
+		}
+
+		// Every header includes all headers before it, so the tree is deep and each header is included many times over
+		// Half of the headers use a classic include guard, the other half '#pragma once'
+		const unsigned int num_headers = 64;
+		for (unsigned int i = 0; i < num_headers; ++i)
+		{
+			const std::string index = std::to_string(i);
+
+			std::string source;
+			if (i % 2)
+				source += "#pragma once\n";
+			else
+				source += "#ifndef HEADER_" + index + "_FXH\n#define HEADER_" + index + "_FXH\n\n";
+
+			for (unsigned int k = i; k-- > 0 && k + 8 >= i;)
+				source += "#include \"Header" + std::to_string(k) + ".fxh\"\n";
+
+			source += "\n#define HEADER_" + index + "_SCALE " + index + ".0\n";
+			source += "static const float Header" + index + "Constant = HEADER_" + index + "_SCALE * 0.5;\n";
+			for (unsigned int k = 0; k < 4; ++k)
+				source += "float4 Header" + index + "Function" + std::to_string(k) + "(float4 color)\n{\n\t// Scale the input color\n\treturn color * Header" + index + "Constant + " + std::to_string(k) + ".0;\n}\n";
+			if (i % 2 == 0)
+				source += "\n#endif\n";
+
+			std::ofstream(header_directory / ("Header" + index + ".fxh"), std::ios::binary) << source;
+		}
+
+		std::string main_source;
+		for (unsigned int i = 0; i < num_headers; ++i)
+			main_source += "#include \"Header" + std::to_string(i) + ".fxh\"\n";
+		std::ofstream(header_directory / "Main.fx", std::ios::binary) << main_source;
+
+		pp_options.include_paths.push_back(header_directory);
+		pp_options.source_files.push_back(header_directory / "Main.fx");
+	}
+
+	size_t output_size = 0;
+	bool success = true;
+	std::string errors;
+	const double time = measure(options.iterations, [&]() {
+		output_size = 0;
+		success = true;
+		errors.clear();
+		for (const std::filesystem::path &source_file : pp_options.source_files)
+		{
+			reshadefx::preprocessor pp;
+			add_macro_definitions_and_include_paths(pp, pp_options);
+			success &= pp.append_file(source_file);
+			output_size += pp.output().size();
+			errors += pp.errors();
+		}
+	});
+
+	std::cerr << errors;
+
+	if (!header_directory.empty())
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(header_directory, ec);
+	}
+
+	print_result("preprocess (output)", time, output_size, 0, nullptr);
+
+	return success;
+}
+
+/// <summary>
+/// Preprocesses the specified files, or the generated source code if there are none.
+/// </summary>
+static bool preprocess_sources(const bench_options &options, const std::string &generated_source, std::vector<std::string> &sources)
+{
+	if (options.source_files.empty())
+	{
+		reshadefx::preprocessor pp;
+		add_macro_definitions_and_include_paths(pp, options);
+		if (!pp.append_string(generated_source, "generated.fx"))
+			return std::cerr << pp.errors(), false;
+		sources.push_back(pp.output());
+		return true;
+	}
+
+	for (const std::filesystem::path &source_file : options.source_files)
+	{
+		reshadefx::preprocessor pp;
+		add_macro_definitions_and_include_paths(pp, options);
+		if (!pp.append_file(source_file))
+			return std::cerr << pp.errors(), false;
+		sources.push_back(pp.output());
+	}
+	return true;
+}
+
+/// <summary>
+/// Measures parsing of the specified preprocessed sources with a back-end created by <paramref name="create_backend"/>, optionally followed by finalizing the generated code.
+/// </summary>
+template <typename F>
+static bool measure_compile(const char *name, const bench_options &options, const std::vector<std::string> &sources, bool finalize, F &&create_backend)
+{
+	size_t total_bytes = 0;
+	for (const std::string &source : sources)
+		total_bytes += source.size();
+
+	bool success = true;
+	std::string errors;
+	const double time = measure(options.iterations, [&]() {
+		success = true;
+		errors.clear();
+		for (const std::string &source : sources)
+		{
+			const std::unique_ptr<reshadefx::codegen> backend(create_backend());
+			reshadefx::parser parser;
+			success &= parser.parse(source, backend.get());
+			errors += parser.errors();
+
+			if (finalize)
+				backend->finalize_code();
+		}
+	});
+
+	std::cerr << errors;
+
+	print_result(name, time, total_bytes, 0, nullptr);
+
+	return success;
+}
+
+static bool bench_constant_table(const bench_options &options)
+{
+	// Every element is a distinct vector constant made of partly shared scalar constants, the way baked lookup tables (e.g. for noise or color grading) are
+	const unsigned int num_elements = 8192;
+
+	std::string generated_source = "static const float4 LookupTable[" + std::to_string(num_elements) + "] = {\n";
+	for (unsigned int i = 0; i < num_elements; ++i)
+		generated_source += "\tfloat4(" + std::to_string(i % 251) + ".0, " + std::to_string(i % 61) + ".5, " + std::to_string(i) + ".25, " + std::to_string(i / 7) + ".0),\n";
+	generated_source += "};\n"
+		"void VS(uint id : SV_VertexID, out float4 pos : SV_Position)\n{\n\tpos = float4(id, 0.0, 0.0, 1.0);\n}\n"
+		"float4 PS(float4 pos : SV_Position) : SV_Target\n{\n"
+		"\treturn LookupTable[uint(pos.x) % " + std::to_string(num_elements) + "];\n}\n"
+		"technique ConstantTable { pass { VertexShader = VS; PixelShader = PS; } }\n";
+
+	std::vector<std::string> sources;
+	if (!preprocess_sources(options, generated_source, sources))
+		return false;
+
+	return measure_compile("compile (spirv)", options, sources, true, []() { return reshadefx::create_codegen_spirv(true, false, false); });
+}
+
+static bool bench_many_locals(const bench_options &options)
+{
+	// Every local is a named value the back-ends have to find a unique name for
+	const unsigned int num_locals = 10000;
+
+	std::string generated_source =
+		"void VS(uint id : SV_VertexID, out float4 pos : SV_Position)\n{\n\tpos = float4(id, 0.0, 0.0, 1.0);\n}\n"
+		"float4 PS(float4 pos : SV_Position) : SV_Target\n{\n\tfloat value0 = pos.x;\n";
+	for (unsigned int i = 1; i < num_locals; ++i)
+		generated_source += "\tfloat value" + std::to_string(i) + " = value" + std::to_string(i - 1) + " * pos.y + " + std::to_string(i % 100) + ".0;\n";
+	generated_source += "\treturn value" + std::to_string(num_locals - 1) + ";\n}\n"
+		"technique ManyLocals { pass { VertexShader = VS; PixelShader = PS; } }\n";
+
+	std::vector<std::string> sources;
+	if (!preprocess_sources(options, generated_source, sources))
+		return false;
+
+	return
+		measure_compile("compile (hlsl)", options, sources, true, []() { return reshadefx::create_codegen_hlsl(50, false, false); }) &&
+		measure_compile("compile (glsl)", options, sources, true, []() { return reshadefx::create_codegen_glsl(false, false, false); });
+}
+
+static bool bench_math_parse(const bench_options &options)
+{
+	// Every statement calls a couple of intrinsics on non-constant arguments, so that they cannot be folded
+	static const char *const calls[] = {
+		"sin(a.x) * cos(b.y)", "pow(abs(a.x), 2.2)", "dot(normalize(a.xyz), b.xyz)", "length(cross(a.xyz, b.xyz))", "lerp(a.w, b.w, saturate(c))",
+		"clamp(exp(a.y), 0.0, 1.0)", "max(log(abs(b.x) + 1.0), min(a.z, c))", "sqrt(abs(a.x)) + rsqrt(abs(b.y) + 1.0)", "frac(a.y) + floor(b.z)",
+		"smoothstep(0.0, 1.0, step(a.x, b.x))", "mul(float3x3(a.xyz, b.xyz, a.zyx), b.xyz).x", "atan2(a.y, b.x) + asin(saturate(c))", "(a.x % 3.0) + sign(b.y)",
+		"reflect(a.xyz, normalize(b.xyz)).y", "distance(a.xy, b.xy)", "ddx(a.x) + ddy(b.y)", "round(a.w) + trunc(b.w)", "degrees(radians(a.x))" };
+
+	std::string generated_source = "uniform float Time;\n";
+	for (unsigned int i = 0; i < 400; ++i)
+	{
+		generated_source += "float Math" + std::to_string(i) + "(float4 a, float4 b, float c)\n{\n\tfloat r = 0.0;\n";
+		for (unsigned int k = 0; k < 16; ++k)
+			generated_source += std::string("\tr += ") + calls[(i + k * 5) % std::size(calls)] + ";\n";
+		generated_source += "\treturn r;\n}\n";
+	}
+	generated_source += "float4 PS(float4 pos : SV_Position, float2 uv : TEXCOORD) : SV_Target\n{\n\tfloat4 a = float4(uv, Time, 1.0), b = pos;\n\tfloat r = 0.0;\n";
+	for (unsigned int i = 0; i < 400; ++i)
+		generated_source += "\tr += Math" + std::to_string(i) + "(a, b, r);\n";
+	generated_source += "\treturn r;\n}\n";
+
+	std::vector<std::string> sources;
+	if (!preprocess_sources(options, generated_source, sources))
+		return false;
+
+	return measure_compile("parse (spirv)", options, sources, false, []() { return reshadefx::create_codegen_spirv(true, false, false); });
+}
+
+static bool bench_nested_blocks(const bench_options &options)
+{
+	// Nest blocks a few dozen levels deep, many times over, so that there are thousands of scopes with a growing number of symbols around
+	const unsigned int num_groups = 200, depth = 32;
+
+	std::string generated_source = "float4 PS(float4 pos : SV_Position) : SV_Target\n{\n\tfloat r = 0.0;\n";
+	for (unsigned int group = 0; group < num_groups; ++group)
+	{
+		for (unsigned int level = 0; level < depth; ++level)
+		{
+			const std::string name = std::to_string(group) + '_' + std::to_string(level);
+			generated_source += std::string(level + 1, '\t') + "{\n";
+			generated_source += std::string(level + 2, '\t') + "float a" + name + " = pos.x + r, b" + name + " = a" + name + " * 2.0;\n";
+			generated_source += std::string(level + 2, '\t') + "int c" + name + " = int(b" + name + ");\n";
+		}
+		for (unsigned int level = depth; level-- > 0;)
+		{
+			const std::string name = std::to_string(group) + '_' + std::to_string(level);
+			generated_source += std::string(level + 2, '\t') + "r += b" + name + " + c" + name + ";\n";
+			generated_source += std::string(level + 1, '\t') + "}\n";
+		}
+	}
+	generated_source += "\treturn r;\n}\n";
+
+	std::vector<std::string> sources;
+	if (!preprocess_sources(options, generated_source, sources))
+		return false;
+
+	return measure_compile("parse (spirv)", options, sources, false, []() { return reshadefx::create_codegen_spirv(true, false, false); });
+}
+
+static bool bench_lex(const bench_options &options)
+{
+	const std::vector<std::string> sources = load_sources(options, 2000);
+
+	size_t total_bytes = 0;
+	for (const std::string &source : sources)
+		total_bytes += source.size();
+
+	// Same lexer settings the preprocessor uses
+	size_t num_tokens = 0;
+	const double pp_time = measure(options.iterations, [&]() {
+		num_tokens = 0;
+		for (const std::string &source : sources)
+		{
+			reshadefx::lexer lexer(
+				source,
+				true  /* ignore_comments */,
+				false /* ignore_whitespace */,
+				false /* ignore_pp_directives */,
+				false /* ignore_line_directives */,
+				true  /* ignore_keywords */,
+				false /* escape_string_literals */);
+			while (lexer.lex().id != reshadefx::tokenid::end_of_file)
+				num_tokens++;
+		}
+	});
+	print_result("lex (preprocessor mode)", pp_time, total_bytes, num_tokens, "tokens");
+
+	// Same lexer settings the parser uses
+	const double parser_time = measure(options.iterations, [&]() {
+		num_tokens = 0;
+		for (const std::string &source : sources)
+		{
+			reshadefx::lexer lexer(source);
+			while (lexer.lex().id != reshadefx::tokenid::end_of_file)
+				num_tokens++;
+		}
+	});
+	print_result("lex (parser mode)", parser_time, total_bytes, num_tokens, "tokens");
+
+	return true;
+}
+
+static bool bench_scan(const bench_options &options)
+{
+	std::vector<std::string> sources;
+	if (options.source_files.empty())
+	{
+		// Shader packs typically start every file with a long license header and indent deeply
+		std::string source;
+		for (unsigned int i = 0; i < 2000; ++i)
+		{
+			source += "/*\n";
+			for (unsigned int k = 0; k < 20; ++k)
+				source += " * Permission is hereby granted, free of charge, to any person obtaining a copy of this software.\n";
+			source += " */\n";
+			source += "// " + std::string(100, '=') + "\n";
+			source += std::string(32, '\t') + "float4 AVeryLongDescriptiveIdentifierName_" + std::to_string(i) + " = LongFunctionNameForSomeComputation_" + std::to_string(i) + "(ArgumentNumberOne, ArgumentNumberTwo);" + std::string(40, ' ') + "\n\n";
+		}
+		sources.push_back(std::move(source));
+	}
+	else
+	{
+		sources = load_sources(options, 0);
+	}
+
+	size_t total_bytes = 0;
+	for (const std::string &source : sources)
+		total_bytes += source.size();
+
+	for (int parser_mode = 0; parser_mode < 2; ++parser_mode)
+	{
+		size_t num_tokens = 0;
+		unsigned int num_lines = 0;
+		const double time = measure(options.iterations, [&]() {
+			num_tokens = 0;
+			num_lines = 0;
+			for (const std::string &source : sources)
+			{
+				reshadefx::lexer lexer(source, true, parser_mode != 0, parser_mode != 0, false, parser_mode == 0, parser_mode != 0);
+				reshadefx::token tok;
+				while ((tok = lexer.lex()).id != reshadefx::tokenid::end_of_file)
+					num_tokens++;
+				num_lines += tok.location.line;
+			}
+		});
+		print_result(parser_mode ? "scan (parser mode)" : "scan (preprocessor mode)", time, total_bytes, num_tokens, "tokens");
+		printf("%-28s %10u lines\n", "", num_lines);
+	}
+
+	return true;
+}
+
+static const struct
+{
+	const char *name;
+	bool(*func)(const bench_options &options);
+} s_benchmarks[] = {
+	{ "classify", bench_classify },
+	{ "constant-table", bench_constant_table },
+	{ "guarded-includes", bench_guarded_includes },
+	{ "lex", bench_lex },
+	{ "many-locals", bench_many_locals },
+	{ "math-parse", bench_math_parse },
+	{ "nested-blocks", bench_nested_blocks },
+	{ "scan", bench_scan },
+};
+
+int main(int argc, char *argv[])
+{
+	bench_options options;
+	const char *benchmark_name = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+
+		if (arg[0] == '-')
+		{
+			if (0 == std::strcmp(arg, "-h") || 0 == std::strcmp(arg, "--help"))
+			{
+				print_usage(argv[0]);
+				return 0;
+			}
+			else if (0 == std::strcmp(arg, "-n") && i + 1 < argc)
+			{
+				options.iterations = static_cast<unsigned int>(std::max(1, std::atoi(argv[++i])));
+			}
+			else if (0 == std::strcmp(arg, "-D") && i + 1 < argc)
+			{
+				char *name = argv[++i];
+				char *value = std::strchr(name, '=');
+				if (value) *value++ = '\0';
+				options.macro_definitions.emplace_back(name, value ? value : "1");
+			}
+			else if (0 == std::strcmp(arg, "-I") && i + 1 < argc)
+			{
+				options.include_paths.emplace_back(argv[++i]);
+			}
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (benchmark_name == nullptr)
+		{
+			benchmark_name = arg;
+		}
+		else
+		{
+			options.source_files.push_back(arg);
+		}
+	}
+
+	if (benchmark_name == nullptr)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	for (const auto &benchmark : s_benchmarks)
+	{
+		if (0 == std::strcmp(benchmark_name, benchmark.name))
+			return benchmark.func(options) ? 0 : 1;
+	}
+
+	std::cerr << "error: unknown benchmark '" << benchmark_name << "'" << std::endl;
+	return 1;
+}
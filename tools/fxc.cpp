@@ -7,13 +7,21 @@
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
 #include "version.h"
+#include <algorithm> // std::max, std::min, std::sort
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <thread>
 
 static void print_usage(const char *path)
 {
 	printf(R"(usage: %s [options] <filename>
+       %s [options] <filename | directory>...
+
+Specifying more than one file or a directory (of which all .fx files are used) compiles in batch mode: Every file is compiled with every requested back-end on a pool of threads and the time spent in each stage is printed per file, instead of any code.
 
 Options:
   -h, --help                Print this help.
@@ -22,43 +30,194 @@ Options:
   -D <id>=<text>            Define a preprocessor macro.
   -I <path>                 Add directory to include search path.
   -P <path>                 Pre-process to file. If <path> is "-", then result is written to standard output instead.
+  -E <name>                 Assemble code for the given entry point only. If <name> is "*", then code is assembled for every entry point.
+  -j <count>                Number of threads to assemble entry points on when "-E *" is used, or to compile files on in batch mode. Default is the number of hardware threads.
 
-  -Fo <file>                Output SPIR-V binary to the given file.
+  -Fo <file>                Output SPIR-V binary to the given file. With "-E *", one file is written per entry point, with the entry point name appended to <file>.
   -Fe <file>                Output warnings and errors to the given file.
+  -Fp <file>                Use precompiled header snapshot of the includes at the beginning of the source file. It is created if the file does not exist or is out of date.
 
   --glsl                    Print GLSL code for the previously specified entry point.
   --hlsl                    Print HLSL code for the previously specified entry point.
+  --spirv                   Generate SPIR-V code. This is the default, so is only needed in batch mode to compile with it in addition to '--glsl' or '--hlsl'.
+  --json <file>             Write the timings collected in batch mode as JSON to the given file. If <file> is "-", then they are written to standard output instead.
   --shader-model <value>    HLSL shader model version. Can be 30, 40, 41, 50, ...
 
   --width <value>           Value of the 'BUFFER_WIDTH' preprocessor macro.
   --height <value>          Value of the 'BUFFER_HEIGHT' preprocessor macro.
   --invert-y                Insert code to invert the Y component of the output position in vertex shaders (only applies to SPIR-V).
   --spec-constants          Convert uniform variables to specialization constants.
+  --pack-uniforms           Reorder uniform variables to waste as little space on padding as possible, instead of laying them out in declaration order.
   --vulkan-semantics        Generate GLSL/SPIR-V code under Vulkan semantics, instead of OpenGL semantics.
 
+  -Od                       Disable optimizations.
+  -O0 | -O1 | -O2 | -O3     Optimization level (only applies to SPIR-V). Default is 0.
+  --optimize-ssa            Remove common subexpressions, copies and unused values before generating code (applies to all back-ends).
   -Zi                       Enable debug information.
-	)", path);
+	)", path, path);
+}
+
+static bool assemble_all_entry_points(const reshadefx::codegen &backend, unsigned int num_threads, std::vector<std::string> &codes, std::string &errors)
+{
+	const std::vector<std::pair<std::string, reshadefx::shader_type>> &entry_points = backend.module().entry_points;
+
+	codes.resize(entry_points.size());
+	std::vector<std::string> entry_point_errors(entry_points.size());
+	std::vector<char> entry_point_assembled(entry_points.size(), 1);
+
+	// Assembling only reads from the module, so every entry point can be assembled on a different thread
+	std::atomic<size_t> next_entry_point = 0;
+	const auto assemble_entry_points = [&]() {
+		for (size_t i = next_entry_point++; i < entry_points.size(); i = next_entry_point++)
+		{
+			std::string assembly;
+			if (!backend.assemble_code_for_entry_point(entry_points[i].first, codes[i], assembly, entry_point_errors[i]))
+				entry_point_assembled[i] = 0;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t n = 1; n < std::min(static_cast<size_t>(num_threads), entry_points.size()); ++n)
+		threads.emplace_back(assemble_entry_points);
+	assemble_entry_points();
+	for (std::thread &thread : threads)
+		thread.join();
+
+	bool success = true;
+	for (size_t i = 0; i < entry_points.size(); ++i)
+	{
+		errors += entry_point_errors[i];
+		if (!entry_point_assembled[i])
+		{
+			if (entry_point_errors[i].empty())
+				errors += "error: Failed to assemble code for entry point '" + entry_points[i].first + "'.\n";
+			success = false;
+		}
+	}
+
+	return success;
+}
+
+struct batch_result
+{
+	std::filesystem::path source_file;
+	const char *backend_name = nullptr;
+	bool success = false;
+	std::string errors;
+
+	// Time spent in each stage of compilation, in milliseconds
+	double preprocess_time = 0.0;
+	double parse_time = 0.0;
+	double codegen_time = 0.0;
+	double assemble_time = 0.0;
+};
+
+static std::string escape_json_string(const std::string &value)
+{
+	std::string escaped;
+	escaped.reserve(value.size());
+
+	for (const char c : value)
+	{
+		switch (c)
+		{
+		case '"':
+			escaped += "\\\"";
+			break;
+		case '\\':
+			escaped += "\\\\";
+			break;
+		case '\n':
+			escaped += "\\n";
+			break;
+		case '\r':
+			escaped += "\\r";
+			break;
+		case '\t':
+			escaped += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char code[7];
+				std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(c));
+				escaped += code;
+			}
+			else
+			{
+				escaped += c;
+			}
+			break;
+		}
+	}
+
+	return escaped;
+}
+
+static std::string format_batch_json(const std::vector<batch_result> &results, unsigned int num_threads, double total_time)
+{
+	const auto format_time = [](double value) {
+		char number[32];
+		std::snprintf(number, sizeof(number), "%.3f", value);
+		return std::string(number);
+	};
+
+	std::string json;
+	json += "{\n";
+	json += "  \"threads\": " + std::to_string(num_threads) + ",\n";
+	json += "  \"total_time_ms\": " + format_time(total_time) + ",\n";
+	json += "  \"results\": [";
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const batch_result &result = results[i];
+
+		json += (i == 0 ? "\n" : ",\n");
+		json += "    {\n";
+		json += "      \"file\": \"" + escape_json_string(result.source_file.u8string()) + "\",\n";
+		json += "      \"backend\": \"" + std::string(result.backend_name) + "\",\n";
+		json += "      \"success\": " + std::string(result.success ? "true" : "false") + ",\n";
+		json += "      \"preprocess_ms\": " + format_time(result.preprocess_time) + ",\n";
+		json += "      \"parse_ms\": " + format_time(result.parse_time) + ",\n";
+		json += "      \"codegen_ms\": " + format_time(result.codegen_time) + ",\n";
+		json += "      \"assemble_ms\": " + format_time(result.assemble_time) + ",\n";
+		json += "      \"total_ms\": " + format_time(result.preprocess_time + result.parse_time + result.codegen_time + result.assemble_time) + ",\n";
+		json += "      \"errors\": \"" + escape_json_string(result.errors) + "\"\n";
+		json += "    }";
+	}
+
+	json += "\n  ]\n}\n";
+
+	return json;
 }
 
 int main(int argc, char *argv[])
 {
-	const char *source_file = nullptr;
+	std::vector<std::filesystem::path> source_files;
+	bool batch_mode = false;
 	const char *preprocess_file = nullptr;
 	const char *error_file = nullptr;
 	const char *object_file = nullptr;
+	const char *snapshot_file = nullptr;
+	const char *entry_point_name = nullptr;
 	const char *buffer_width = "800";
 	const char *buffer_height = "600";
+	const char *json_file = nullptr;
 	bool print_glsl = false;
 	bool print_hlsl = false;
+	bool generate_spirv = false;
 	bool debug_info = false;
 	bool invert_y_axis = false;
 	bool spec_constants = false;
 	bool vulkan_semantics = false;
+	bool optimize_ssa = false;
+	bool pack_uniforms = false;
 	unsigned int shader_model = 50;
+	unsigned int num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	int optimization_level = 0;
 
-	reshadefx::preprocessor pp;
-	pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+	std::vector<std::pair<std::string, std::string>> macro_definitions;
+	std::vector<std::filesystem::path> include_paths;
 
 	// Parse command-line arguments
 	for (int i = 1; i < argc; ++i)
@@ -81,37 +240,55 @@ int main(int argc, char *argv[])
 				char *name = argv[++i];
 				char *value = std::strchr(name, '=');
 				if (value) *value++ = '\0';
-				pp.add_macro_definition(name, value ? value : "1");
+				macro_definitions.emplace_back(name, value ? value : "1");
 				continue;
 			}
 
 			if (0 == std::strcmp(arg, "-I"))
 			{
-				pp.add_include_path(argv[++i]);
+				include_paths.emplace_back(argv[++i]);
 				continue;
 			}
 
 			if (0 == std::strcmp(arg, "-Zi"))
 				debug_info = true;
+			else if (0 == std::strcmp(arg, "-Od"))
+				optimization_level = -1;
+			else if (arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3' && arg[3] == '\0')
+				optimization_level = arg[2] - '0';
 			else if (0 == std::strcmp(arg, "--glsl"))
 				print_glsl = true;
 			else if (0 == std::strcmp(arg, "--hlsl"))
 				print_hlsl = true;
+			else if (0 == std::strcmp(arg, "--spirv"))
+				generate_spirv = true;
 			else if (0 == std::strcmp(arg, "--invert-y"))
 				invert_y_axis = true;
 			else if (0 == std::strcmp(arg, "--spec-constants"))
 				spec_constants = true;
 			else if (0 == std::strcmp(arg, "--vulkan-semantics"))
 				vulkan_semantics = true;
+			else if (0 == std::strcmp(arg, "--optimize-ssa"))
+				optimize_ssa = true;
+			else if (0 == std::strcmp(arg, "--pack-uniforms"))
+				pack_uniforms = true;
 
 			if (i + 1 >= argc)
 				continue;
 			else if (0 == std::strcmp(arg, "-P"))
 				preprocess_file = argv[++i];
+			else if (0 == std::strcmp(arg, "-E"))
+				entry_point_name = argv[++i];
+			else if (0 == std::strcmp(arg, "-j"))
+				num_threads = std::max(static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10)), 1u);
 			else if (0 == std::strcmp(arg, "-Fe"))
 				error_file = argv[++i];
 			else if (0 == std::strcmp(arg, "-Fo"))
 				object_file = argv[++i];
+			else if (0 == std::strcmp(arg, "-Fp"))
+				snapshot_file = argv[++i];
+			else if (0 == std::strcmp(arg, "--json"))
+				json_file = argv[++i];
 			else if (0 == std::strcmp(arg, "--shader-model"))
 				shader_model = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
 			else if (0 == std::strcmp(arg, "--width"))
@@ -121,26 +298,217 @@ int main(int argc, char *argv[])
 		}
 		else
 		{
-			if (source_file != nullptr)
+			// Compiling more than one file switches to batch mode
+			if (!source_files.empty())
+				batch_mode = true;
+
+			if (std::error_code ec; std::filesystem::is_directory(arg, ec))
 			{
-				std::cout << "error: More than one input file specified" << std::endl;
-				return 1;
-			}
+				batch_mode = true;
 
-			source_file = arg;
+				std::vector<std::filesystem::path> directory_files;
+				for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(arg, ec))
+					if (entry.is_regular_file(ec) && entry.path().extension() == ".fx")
+						directory_files.push_back(entry.path());
+
+				// Sort files, since directory iteration order is unspecified
+				std::sort(directory_files.begin(), directory_files.end());
+				source_files.insert(source_files.end(), directory_files.begin(), directory_files.end());
+			}
+			else
+			{
+				source_files.emplace_back(arg);
+			}
 		}
 	}
 
-	if (source_file == nullptr || (print_glsl && print_hlsl) || (print_glsl && object_file) || (print_hlsl && object_file))
+	if (batch_mode ?
+			(preprocess_file != nullptr || entry_point_name != nullptr || object_file != nullptr || snapshot_file != nullptr) :
+			(source_files.empty() || generate_spirv || json_file != nullptr || (print_glsl && print_hlsl) || (print_glsl && object_file) || (print_hlsl && object_file)))
 	{
 		print_usage(argv[0]);
 		return 1;
 	}
 
-	pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
-	pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
-	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	const auto add_macro_definitions_and_include_paths = [&](reshadefx::preprocessor &pp) {
+		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+		pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+
+		for (const std::pair<std::string, std::string> &definition : macro_definitions)
+			pp.add_macro_definition(definition.first, definition.second);
+		for (const std::filesystem::path &include_path : include_paths)
+			pp.add_include_path(include_path);
+
+		pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
+		pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
+		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	};
+
+	if (batch_mode)
+	{
+		if (source_files.empty())
+		{
+			std::cout << "error: No effect files found" << std::endl;
+			return 1;
+		}
+
+		std::vector<const char *> backend_names;
+		if (generate_spirv || (!print_glsl && !print_hlsl))
+			backend_names.push_back("spirv");
+		if (print_glsl)
+			backend_names.push_back("glsl");
+		if (print_hlsl)
+			backend_names.push_back("hlsl");
+
+		std::vector<batch_result> results(source_files.size() * backend_names.size());
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			results[i].source_file = source_files[i / backend_names.size()];
+			results[i].backend_name = backend_names[i % backend_names.size()];
+		}
+
+		const auto compile = [&](batch_result &result) {
+			const auto measure = [](auto &&stage, double &time) {
+				const std::chrono::high_resolution_clock::time_point time_started = std::chrono::high_resolution_clock::now();
+				const bool success = stage();
+				time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - time_started).count();
+				return success;
+			};
+
+			reshadefx::preprocessor pp;
+			if (!measure([&]() { add_macro_definitions_and_include_paths(pp); return pp.append_file(result.source_file); }, result.preprocess_time))
+			{
+				result.errors = pp.errors();
+				return;
+			}
+
+			std::unique_ptr<reshadefx::codegen> backend;
+			if (0 == std::strcmp(result.backend_name, "glsl"))
+				backend.reset(reshadefx::create_codegen_glsl(vulkan_semantics, debug_info, spec_constants, false, false, pack_uniforms));
+			else if (0 == std::strcmp(result.backend_name, "hlsl"))
+				backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants, pack_uniforms));
+			else
+				backend.reset(reshadefx::create_codegen_spirv(vulkan_semantics, debug_info, spec_constants, false, invert_y_axis, optimization_level, pack_uniforms));
+
+			reshadefx::parser parser;
+			const bool parse_success = measure([&]() { return parser.parse(pp.output(), backend.get(), optimize_ssa); }, result.parse_time);
+
+			result.errors = pp.errors() + parser.errors();
+			if (!parse_success)
+				return;
+
+			std::string code;
+			measure([&]() { code = backend->finalize_code(); return true; }, result.codegen_time);
+
+			// Files are already compiled in parallel, so assemble entry points of a single file sequentially
+			std::vector<std::string> codes;
+			result.success = measure([&]() { return assemble_all_entry_points(*backend, 1, codes, result.errors); }, result.assemble_time);
+		};
+
+		const std::chrono::high_resolution_clock::time_point time_batch_started = std::chrono::high_resolution_clock::now();
+
+		std::atomic<size_t> next_result = 0;
+		const auto compile_files = [&]() {
+			for (size_t i = next_result++; i < results.size(); i = next_result++)
+				compile(results[i]);
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t n = 1; n < std::min(static_cast<size_t>(num_threads), results.size()); ++n)
+			threads.emplace_back(compile_files);
+		compile_files();
+		for (std::thread &thread : threads)
+			thread.join();
+
+		const double total_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - time_batch_started).count();
+
+		// Only print JSON to standard output if it was requested there, so that it can be parsed directly
+		const bool print_json = json_file != nullptr && std::strcmp(json_file, "-") == 0;
+
+		size_t num_failed = 0;
+		std::string errors;
+
+		if (!print_json)
+			printf("%-32s %-8s %12s %12s %12s %12s %12s\n", "file", "backend", "preprocess", "parse", "codegen", "assemble", "total");
+		for (const batch_result &result : results)
+		{
+			if (!result.success)
+				num_failed++;
+			if (!result.errors.empty())
+				errors += result.errors;
+
+			if (print_json)
+				continue;
+
+			printf("%-32s %-8s %9.3f ms %9.3f ms %9.3f ms %9.3f ms %9.3f ms%s\n",
+				result.source_file.filename().u8string().c_str(),
+				result.backend_name,
+				result.preprocess_time,
+				result.parse_time,
+				result.codegen_time,
+				result.assemble_time,
+				result.preprocess_time + result.parse_time + result.codegen_time + result.assemble_time,
+				result.success ? "" : "  FAILED");
+		}
+
+		const unsigned int num_threads_used = std::min(num_threads, static_cast<unsigned int>(results.size()));
+
+		if (!print_json)
+			printf("%zu of %zu compilations failed (%u threads, %.3f ms total)\n", num_failed, results.size(), num_threads_used, total_time);
+
+		if (!errors.empty())
+		{
+			if (error_file != nullptr)
+				std::ofstream(error_file) << errors;
+			else if (!print_json)
+				std::cout << errors << std::endl;
+		}
+
+		if (json_file != nullptr)
+		{
+			const std::string json = format_batch_json(results, num_threads_used, total_time);
+
+			if (print_json)
+				std::cout << json;
+			else
+				std::ofstream(json_file) << json;
+		}
+
+		std::cout.flush();
+
+		return num_failed != 0 ? 1 : 0;
+	}
+
+	const std::filesystem::path &source_file = source_files.front();
+
+	reshadefx::preprocessor pp;
+	add_macro_definitions_and_include_paths(pp);
+
+	if (snapshot_file != nullptr)
+	{
+		const std::string header_prefix = reshadefx::preprocessor::read_header_prefix(source_file);
+
+		std::string snapshot;
+		if (std::ifstream file(snapshot_file, std::ios::binary); file)
+			snapshot.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+		// Fall back to parsing the header prefix (and saving a new snapshot of it) if the existing snapshot is missing or does not match
+		if (snapshot.empty() || !pp.load_snapshot(snapshot, header_prefix, source_file))
+		{
+			// Use a separate preprocessor for this, so that errors in the header prefix are reported only once by parsing the file without it below
+			reshadefx::preprocessor pch_pp;
+			add_macro_definitions_and_include_paths(pch_pp);
+
+			if (!header_prefix.empty() && pch_pp.append_header_prefix(header_prefix, source_file))
+			{
+				snapshot = pch_pp.save_snapshot();
+				std::ofstream(snapshot_file, std::ios::binary).write(snapshot.data(), snapshot.size());
+
+				pp.load_snapshot(snapshot, header_prefix, source_file);
+			}
+		}
+	}
 
 	if (!pp.append_file(source_file))
 	{
@@ -162,14 +530,14 @@ int main(int argc, char *argv[])
 
 	std::unique_ptr<reshadefx::codegen> backend;
 	if (print_glsl)
-		backend.reset(reshadefx::create_codegen_glsl(vulkan_semantics, debug_info, spec_constants, invert_y_axis));
+		backend.reset(reshadefx::create_codegen_glsl(vulkan_semantics, debug_info, spec_constants, false, false, pack_uniforms));
 	else if (print_hlsl)
-		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants));
+		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, spec_constants, pack_uniforms));
 	else
-		backend.reset(reshadefx::create_codegen_spirv(vulkan_semantics, debug_info, spec_constants, invert_y_axis));
+		backend.reset(reshadefx::create_codegen_spirv(vulkan_semantics, debug_info, spec_constants, false, invert_y_axis, optimization_level, pack_uniforms));
 
 	reshadefx::parser parser;
-	if (!parser.parse(pp.output(), backend.get()))
+	if (!parser.parse(pp.output(), backend.get(), optimize_ssa))
 	{
 		if (error_file == nullptr)
 			std::cout << pp.errors() << parser.errors() << std::endl;
@@ -180,6 +548,56 @@ int main(int argc, char *argv[])
 
 	std::basic_string<char> code = backend->finalize_code();
 
+	if (entry_point_name != nullptr && std::strcmp(entry_point_name, "*") == 0)
+	{
+		std::vector<std::string> codes;
+		std::string errors;
+
+		if (!assemble_all_entry_points(*backend, num_threads, codes, errors))
+		{
+			if (error_file == nullptr)
+				std::cout << errors << std::endl;
+			else
+				std::ofstream(error_file) << errors;
+			return 1;
+		}
+
+		const std::vector<std::pair<std::string, reshadefx::shader_type>> &entry_points = backend->module().entry_points;
+
+		for (size_t i = 0; i < entry_points.size(); ++i)
+		{
+			if (print_glsl || print_hlsl)
+				std::cout << "// " << entry_points[i].first << '\n' << codes[i] << '\n';
+			else if (object_file != nullptr)
+				std::ofstream(object_file + ('.' + entry_points[i].first), std::ios::binary).write(codes[i].data(), codes[i].size());
+		}
+		std::cout.flush();
+
+		return 0;
+	}
+
+	if (entry_point_name != nullptr)
+	{
+		std::string assembly, errors;
+		code.clear();
+
+		if (!backend->assemble_code_for_entry_point(entry_point_name, code, assembly, errors))
+		{
+			if (errors.empty())
+			{
+				errors = "error: Failed to assemble code for entry point '" + std::string(entry_point_name) + "'. Available entry points are:";
+				for (const std::pair<std::string, reshadefx::shader_type> &entry_point : backend->module().entry_points)
+					errors += ' ' + entry_point.first;
+			}
+
+			if (error_file == nullptr)
+				std::cout << errors << std::endl;
+			else
+				std::ofstream(error_file) << errors;
+			return 1;
+		}
+	}
+
 	if (print_glsl || print_hlsl)
 	{
 		std::cout.write(code.data(), code.size()).flush();
@@ -0,0 +1,938 @@
+/*
+ * Copyright (C) 2014 Patrick Mours
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_preprocessor.hpp"
+#include "version.h"
+#include <cctype>
+#include <cstring>
+#include <algorithm> // std::find_if, std::max, std::min, std::sort
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <memory> // std::unique_ptr
+#include <spirv.hpp>
+
+static void print_usage(const char *path)
+{
+	printf(R"(usage: %s [options] <test> [<filename>...]
+
+Runs a test of the effect compiler. Each test works on a built-in set of effects by default, or on the given effect files instead, where that applies.
+
+Tests:
+  bindings                  Compile effects to SPIR-V, GLSL and HLSL and check the texture bindings generated for every pass: No slot is used twice, vertex and pixel shader bindings do not overwrite each other and textures keep their slot across passes where it is free.
+  optimizer                 Compile effects with and without the SSA optimizer to SPIR-V, GLSL and HLSL and check that both succeed, describe the same module, produce well-formed code for every entry point and declare the same entry point signatures, uniforms and resource bindings in it.
+  uniforms                  Compile effects with and without packed uniforms to SPIR-V, GLSL and HLSL and check that no uniforms overlap, arrays and matrices start on a 16-byte boundary and no other uniform crosses one.
+
+Options:
+  -h, --help                Print this help.
+  -D <id>=<text>            Define a preprocessor macro.
+  -I <path>                 Add directory to include search path.
+	)", path);
+}
+
+struct test_options
+{
+	std::vector<std::pair<std::string, std::string>> macro_definitions;
+	std::vector<std::filesystem::path> include_paths;
+	std::vector<std::filesystem::path> source_files;
+};
+
+struct test_effect
+{
+	const char *name;
+	const char *source;
+};
+
+static const test_effect s_test_effects[] = {
+	{ "PostProcess.fx", R"(
+uniform float Intensity < ui_type = "slider"; ui_min = 0.0; ui_max = 2.0; > = 1.0;
+uniform float3 Tint < ui_type = "color"; > = float3(1.0, 0.9, 0.8);
+uniform int Mode < ui_type = "combo"; ui_items = "Add\0Multiply\0Screen\0"; > = 0;
+uniform float Timer < source = "timer"; >;
+uniform bool Enabled = true;
+
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+texture DepthTex : DEPTH;
+sampler Depth { Texture = DepthTex; };
+
+static const float Weights[5] = { 0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216 };
+
+struct Material
+{
+	float3 albedo;
+	float roughness;
+};
+
+float Luminance(float3 color)
+{
+	return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+void Split(float4 value, out float3 color, out float alpha)
+{
+	color = value.rgb;
+	alpha = value.a;
+}
+
+float3 Blend(float3 a, float3 b)
+{
+	switch (Mode)
+	{
+	case 0:
+		return a + b;
+	case 1:
+		return a * b;
+	default:
+		return 1.0 - (1.0 - a) * (1.0 - b);
+	}
+}
+
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 BlurPS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float3 color = tex2D(BackBuffer, texcoord).rgb * Weights[0];
+	for (int i = 1; i < 5; ++i)
+	{
+		const float2 offset = float2(i * BUFFER_RCP_WIDTH, 0.0);
+		color += tex2D(BackBuffer, texcoord + offset).rgb * Weights[i];
+		color += tex2D(BackBuffer, texcoord - offset).rgb * Weights[i];
+	}
+	return float4(color, 1.0);
+}
+
+float4 MainPS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float3 color; float alpha;
+	Split(tex2D(BackBuffer, texcoord), color, alpha);
+
+	if (!Enabled)
+		return float4(color, alpha);
+
+	Material material;
+	material.albedo = color * Tint;
+	material.roughness = saturate(tex2Dlod(Depth, float4(texcoord, 0, 0)).x);
+
+	// Same subexpression computed multiple times, which the optimizer may remove
+	const float luma = Luminance(material.albedo) * Intensity;
+	const float luma_again = Luminance(material.albedo) * Intensity;
+
+	float3 result = Blend(material.albedo, luma.xxx);
+	int steps = 0;
+	while (steps < 8 && Luminance(result) < 0.5)
+	{
+		result *= 1.1;
+		if (result.r > 0.9)
+			break;
+		steps++;
+	}
+
+	[unroll] for (int k = 0; k < 3; ++k)
+		result[k] = lerp(result[k], luma_again, 0.1 * sin(Timer * 0.001 + k));
+
+	return float4(result, alpha);
+}
+
+technique PostProcess < ui_tooltip = "Test"; >
+{
+	pass Blur
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = BlurPS;
+	}
+	pass Main
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = MainPS;
+		SRGBWriteEnable = true;
+	}
+}
+)" },
+	{ "RenderTargets.fx", R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+
+texture HalfTex { Width = BUFFER_WIDTH / 2; Height = BUFFER_HEIGHT / 2; Format = RGBA16F; MipLevels = 4; };
+sampler Half { Texture = HalfTex; MinFilter = POINT; MagFilter = POINT; AddressU = CLAMP; };
+texture HistoryTex { Width = BUFFER_WIDTH / 2; Height = BUFFER_HEIGHT / 2; Format = R8; };
+sampler History { Texture = HistoryTex; };
+
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 DownsamplePS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float4 sum = 0.0;
+	[loop] for (int y = -1; y <= 1; ++y)
+		for (int x = -1; x <= 1; ++x)
+		{
+			if (x == 0 && y == 0)
+				continue;
+			sum += tex2D(BackBuffer, texcoord + float2(x * BUFFER_RCP_WIDTH, y * BUFFER_RCP_HEIGHT));
+		}
+	return sum / 8.0;
+}
+
+float4 CombinePS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	const float4 half_res = tex2D(Half, texcoord);
+	const float previous = tex2D(History, texcoord).x;
+
+	if (half_res.a < 0.01)
+		discard;
+
+	return tex2D(BackBuffer, texcoord) + half_res * (1.0 - previous);
+}
+
+void UpdateHistoryPS(float4 position : SV_Position, float2 texcoord : TEXCOORD, out float4 color : SV_Target0, out float history : SV_Target1)
+{
+	color = tex2Dlod(BackBuffer, float4(texcoord, 0, 0));
+	history = color.a;
+}
+
+technique RenderTargets
+{
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = DownsamplePS;
+		RenderTarget = HalfTex;
+		ClearRenderTargets = true;
+	}
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = CombinePS;
+	}
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = UpdateHistoryPS;
+		RenderTarget0 = HalfTex;
+		RenderTarget1 = HistoryTex;
+		BlendEnable1 = true;
+		SrcBlend1 = SRCALPHA;
+		DestBlend1 = INVSRCALPHA;
+	}
+}
+)" },
+	{ "Compute.fx", R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+
+texture HistogramTex { Width = 256; Height = 1; Format = R32F; };
+storage HistogramStorage { Texture = HistogramTex; };
+texture AverageTex { Width = 1; Height = 1; Format = R32F; };
+storage AverageStorage { Texture = AverageTex; };
+sampler Average { Texture = AverageTex; };
+
+groupshared uint Bins[256];
+
+void HistogramCS(uint3 id : SV_DispatchThreadID, uint3 tid : SV_GroupThreadID, uint index : SV_GroupIndex)
+{
+	Bins[index] = 0;
+	barrier();
+
+	const float3 color = tex2Dfetch(BackBuffer, id.xy).rgb;
+	const uint bin = uint(saturate(dot(color, float3(0.299, 0.587, 0.114))) * 255.0);
+	atomicAdd(Bins[bin], 1u);
+	barrier();
+
+	tex2Dstore(HistogramStorage, int2(index, 0), float4(Bins[index] / 256.0, 0, 0, 0));
+}
+
+void AverageCS(uint3 id : SV_DispatchThreadID)
+{
+	float sum = 0.0;
+	for (int i = 0; i < 256; ++i)
+		sum += tex2Dfetch(HistogramStorage, int2(i, 0)).x * i;
+	tex2Dstore(AverageStorage, int2(0, 0), sum / 256.0);
+}
+
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 ApplyPS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	return tex2D(BackBuffer, texcoord) / max(tex2D(Average, 0.5).x, 0.001);
+}
+
+technique Compute
+{
+	pass
+	{
+		ComputeShader = HistogramCS<256, 1>;
+		DispatchSizeX = BUFFER_WIDTH / 256;
+		DispatchSizeY = BUFFER_HEIGHT;
+	}
+	pass
+	{
+		ComputeShader = AverageCS<1, 1>;
+		DispatchSizeX = 1;
+		DispatchSizeY = 1;
+	}
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = ApplyPS;
+	}
+}
+)" },
+	{ "Bindings.fx", R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+texture DepthTex : DEPTH;
+sampler Depth { Texture = DepthTex; };
+
+texture TexA { Width = BUFFER_WIDTH; Height = BUFFER_HEIGHT; Format = RGBA16F; };
+sampler SamplerA { Texture = TexA; };
+texture TexB { Width = BUFFER_WIDTH; Height = BUFFER_HEIGHT; Format = RGBA16F; };
+sampler SamplerB { Texture = TexB; };
+texture TexC { Width = BUFFER_WIDTH; Height = BUFFER_HEIGHT; Format = RGBA16F; };
+sampler SamplerC { Texture = TexC; };
+
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD0)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+// Vertex shader that samples a texture itself, which fixes the binding of that texture in all pixel shaders used with it
+void DepthVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD0, out float depth : TEXCOORD1)
+{
+	PostProcessVS(id, position, texcoord);
+	depth = tex2Dlod(Depth, float4(0.5, 0.5, 0, 0)).x;
+}
+
+float4 BackBufferPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0) : SV_Target
+{
+	return tex2D(BackBuffer, texcoord);
+}
+float4 ABPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0) : SV_Target
+{
+	return tex2D(SamplerA, texcoord) + tex2D(SamplerB, texcoord);
+}
+float4 BPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0) : SV_Target
+{
+	return tex2D(SamplerB, texcoord);
+}
+float4 DepthAPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0, float depth : TEXCOORD1) : SV_Target
+{
+	return tex2D(SamplerA, texcoord) * depth * tex2D(Depth, texcoord).x;
+}
+float4 CPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0, float depth : TEXCOORD1) : SV_Target
+{
+	return tex2D(SamplerC, texcoord) + tex2D(BackBuffer, texcoord) * depth;
+}
+float4 ABDepthPS(float4 position : SV_Position, float2 texcoord : TEXCOORD0, float depth : TEXCOORD1) : SV_Target
+{
+	return (tex2D(SamplerA, texcoord) + tex2D(SamplerB, texcoord)) * depth;
+}
+
+technique Bindings
+{
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = BackBufferPS;
+		RenderTarget = TexA;
+	}
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = ABPS;
+		RenderTarget = TexC;
+	}
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = BPS;
+	}
+	pass
+	{
+		VertexShader = DepthVS;
+		PixelShader = DepthAPS;
+		RenderTarget = TexB;
+	}
+	pass
+	{
+		VertexShader = DepthVS;
+		PixelShader = CPS;
+	}
+}
+
+technique BindingsShared
+{
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = BPS;
+	}
+	pass
+	{
+		VertexShader = DepthVS;
+		PixelShader = ABDepthPS;
+	}
+}
+)" },
+	{ "Uniforms.fx", R"(
+// Arrays smaller than 16 bytes after scalars, which must still start on a 16-byte boundary
+uniform float Scale = 1.0;
+uniform float Weights[1];
+uniform float Bias;
+uniform float2 Pair[1];
+uniform float2 Offset;
+uniform float3 Tint;
+uniform int Count;
+uniform float4 Colors[2];
+uniform float Gamma;
+uniform float2x2 Rotation;
+
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+
+float4 UniformsPS(float4 position : SV_Position, float2 texcoord : TEXCOORD) : SV_Target
+{
+	float2 uv = mul(Rotation, texcoord + Offset) * Scale + Bias;
+	float3 color = Colors[Count % 2].rgb * Tint * Weights[0] + dot(Pair[0], uv);
+	return float4(pow(abs(color), Gamma), 1.0);
+}
+
+technique Uniforms
+{
+	pass
+	{
+		VertexShader = PostProcessVS;
+		PixelShader = UniformsPS;
+	}
+}
+)" },
+};
+
+/// <summary>
+/// Names of the samplers every pass of the built-in effects is expected to have a binding for, which catches vertex and pixel shader bindings overwriting each other.
+/// </summary>
+static const struct
+{
+	const char *effect_name;
+	const char *technique_name;
+	size_t pass_index;
+	const char *sampler_names[4];
+} s_expected_pass_samplers[] = {
+	{ "Bindings.fx", "Bindings", 0, { "BackBuffer" } },
+	{ "Bindings.fx", "Bindings", 1, { "SamplerA", "SamplerB" } },
+	{ "Bindings.fx", "Bindings", 2, { "SamplerB" } },
+	{ "Bindings.fx", "Bindings", 3, { "Depth", "SamplerA" } },
+	{ "Bindings.fx", "Bindings", 4, { "Depth", "SamplerC", "BackBuffer" } },
+	{ "Bindings.fx", "BindingsShared", 0, { "SamplerB" } },
+	{ "Bindings.fx", "BindingsShared", 1, { "Depth", "SamplerA", "SamplerB" } },
+};
+
+static void add_macro_definitions_and_include_paths(reshadefx::preprocessor &pp, const test_options &options)
+{
+	// Same predefined macros as fxc uses
+	pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+
+	for (const std::pair<std::string, std::string> &definition : options.macro_definitions)
+		pp.add_macro_definition(definition.first, definition.second);
+	for (const std::filesystem::path &include_path : options.include_paths)
+		pp.add_include_path(include_path);
+
+	pp.add_macro_definition("BUFFER_WIDTH", "800");
+	pp.add_macro_definition("BUFFER_HEIGHT", "600");
+	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+}
+
+/// <summary>
+/// Preprocesses the specified files, or the built-in effects if there are none, and returns pairs of names and preprocessed source code.
+/// </summary>
+static bool preprocess_test_effects(const test_options &options, std::vector<std::pair<std::string, std::string>> &effects)
+{
+	bool success = true;
+
+	if (options.source_files.empty())
+	{
+		for (const test_effect &effect : s_test_effects)
+		{
+			reshadefx::preprocessor pp;
+			add_macro_definitions_and_include_paths(pp, options);
+			if (pp.append_string(effect.source, effect.name))
+				effects.emplace_back(effect.name, pp.output());
+			else
+				success = false, std::cout << pp.errors();
+		}
+	}
+	else
+	{
+		for (const std::filesystem::path &source_file : options.source_files)
+		{
+			reshadefx::preprocessor pp;
+			add_macro_definitions_and_include_paths(pp, options);
+			if (pp.append_file(source_file))
+				effects.emplace_back(source_file.filename().u8string(), pp.output());
+			else
+				success = false, std::cout << pp.errors();
+		}
+	}
+
+	return success;
+}
+
+static int s_num_failures = 0;
+
+static void fail(const std::string &context, const std::string &message)
+{
+	std::cout << "FAILED: " << context << ": " << message << std::endl;
+	s_num_failures++;
+}
+
+static const char *const s_backend_names[] = { "spirv", "glsl", "hlsl" };
+
+static reshadefx::codegen *create_backend(const char *backend_name, bool pack_uniforms = false)
+{
+	if (0 == std::strcmp(backend_name, "glsl"))
+		return reshadefx::create_codegen_glsl(false, false, false, false, false, pack_uniforms);
+	if (0 == std::strcmp(backend_name, "hlsl"))
+		return reshadefx::create_codegen_hlsl(50, false, false, pack_uniforms);
+	return reshadefx::create_codegen_spirv(true, false, false, false, false, 0, pack_uniforms);
+}
+
+/// <summary>
+/// Checks that the specified SPIR-V module is well-formed and contains exactly one entry point.
+/// </summary>
+static bool validate_spirv(const std::string &binary, std::string &message)
+{
+	if (!reshadefx::validate_spirv_module(binary, message))
+		return false;
+
+	std::vector<uint32_t> words(binary.size() / 4);
+	std::memcpy(words.data(), binary.data(), binary.size());
+
+	size_t num_entry_points = 0;
+	for (size_t offset = 5; offset < words.size(); offset += words[offset] >> spv::WordCountShift)
+		if ((words[offset] & spv::OpCodeMask) == spv::OpEntryPoint)
+			num_entry_points++;
+
+	if (num_entry_points != 1)
+		return message = "expected exactly one entry point", false;
+
+	return true;
+}
+
+/// <summary>
+/// Checks that braces and parentheses in the specified GLSL or HLSL code are balanced and that it contains the entry point function.
+/// </summary>
+static bool validate_source_code(const std::string &code, const std::string &entry_point_name, std::string &message)
+{
+	int braces = 0, parentheses = 0;
+	for (const char c : code)
+	{
+		braces += (c == '{') - (c == '}');
+		parentheses += (c == '(') - (c == ')');
+		if (braces < 0 || parentheses < 0)
+			return message = "unbalanced braces or parentheses", false;
+	}
+	if (braces != 0 || parentheses != 0)
+		return message = "unbalanced braces or parentheses", false;
+
+	if (code.find(entry_point_name) == std::string::npos)
+		return message = "entry point function is missing", false;
+
+	return true;
+}
+
+/// <summary>
+/// Returns the specified GLSL or HLSL code with all function bodies removed, which leaves the declarations of uniforms, resources with their bindings and the function signatures.
+/// Names generated from SSA ids (e.g. "_42") are replaced with a placeholder, since the optimizer numbers values differently.
+/// </summary>
+static std::string extract_interface(const std::string &code)
+{
+	const auto is_identifier_char = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; };
+
+	std::string result;
+	result.reserve(code.size());
+
+	for (size_t i = 0; i < code.size(); ++i)
+	{
+		if (code[i] == '_' && (i == 0 || !is_identifier_char(code[i - 1])))
+		{
+			size_t end = i + 1;
+			while (end < code.size() && std::isdigit(static_cast<unsigned char>(code[end])))
+				end++;
+			if (end > i + 1 && (end == code.size() || !is_identifier_char(code[end])))
+			{
+				result += "_#";
+				i = end - 1;
+				continue;
+			}
+		}
+
+		if (code[i] == '{')
+		{
+			// A brace following the closing parenthesis of a parameter list (and optionally a return value semantic) starts a function body
+			size_t last = result.find_last_not_of(" \t\r\n");
+			if (last != std::string::npos && is_identifier_char(result[last]))
+			{
+				while (last != 0 && is_identifier_char(result[last]))
+					last--;
+				last = result.find_last_not_of(" \t\r\n", last);
+				if (last != std::string::npos && result[last] == ':')
+					last = result.find_last_not_of(" \t\r\n", last - 1);
+				else
+					last = std::string::npos;
+			}
+
+			if (last != std::string::npos && result[last] == ')')
+			{
+				for (int depth = 0; i < code.size(); ++i)
+					if (code[i] == '{')
+						depth++;
+					else if (code[i] == '}' && --depth == 0)
+						break;
+				result += ";";
+				continue;
+			}
+		}
+
+		result += code[i];
+	}
+
+	return result;
+}
+
+static std::string describe_module(const reshadefx::effect_module &module)
+{
+	std::string description;
+	for (const std::pair<std::string, reshadefx::shader_type> &entry_point : module.entry_points)
+		description += "entry point " + entry_point.first + ' ' + std::to_string(static_cast<int>(entry_point.second)) + '\n';
+	for (const reshadefx::texture &texture : module.textures)
+		description += "texture " + texture.unique_name + ' ' + texture.semantic + ' ' + std::to_string(texture.width) + 'x' + std::to_string(texture.height) + '\n';
+	for (const reshadefx::sampler &sampler : module.samplers)
+		description += "sampler " + sampler.unique_name + ' ' + sampler.texture_name + '\n';
+	for (const reshadefx::storage &storage : module.storages)
+		description += "storage " + storage.unique_name + ' ' + storage.texture_name + '\n';
+	for (const reshadefx::uniform &uniform : module.uniforms)
+		description += "uniform " + uniform.name + ' ' + std::to_string(uniform.offset) + ' ' + std::to_string(uniform.size) + '\n';
+	description += "uniform size " + std::to_string(module.total_uniform_size) + '\n';
+	for (const reshadefx::technique &technique : module.techniques)
+	{
+		description += "technique " + technique.name + '\n';
+		for (const reshadefx::pass &pass : technique.passes)
+			description += "pass " + pass.name + ' ' + pass.vs_entry_point + ' ' + pass.ps_entry_point + ' ' + pass.cs_entry_point + '\n';
+	}
+	return description;
+}
+
+static bool test_bindings(const test_options &options)
+{
+	std::vector<std::pair<std::string, std::string>> effects;
+	if (!preprocess_test_effects(options, effects))
+		return false;
+
+	for (const std::pair<std::string, std::string> &effect : effects)
+	{
+		for (const char *const backend_name : s_backend_names)
+		{
+			const std::string context = effect.first + " (" + backend_name + ')';
+
+			const std::unique_ptr<reshadefx::codegen> backend(create_backend(backend_name));
+
+			reshadefx::parser parser;
+			if (!parser.parse(effect.second, backend.get()))
+			{
+				fail(context, "parsing failed\n" + parser.errors());
+				continue;
+			}
+
+			const reshadefx::effect_module &module = backend->module();
+
+			// Slot each sampler was first bound to, in the order passes are listed in the effect
+			std::vector<uint32_t> first_bindings(module.samplers.size(), std::numeric_limits<uint32_t>::max());
+
+			for (const reshadefx::technique &tech : module.techniques)
+			{
+				for (size_t pass_index = 0; pass_index < tech.passes.size(); ++pass_index)
+				{
+					const reshadefx::pass &pass = tech.passes[pass_index];
+					const std::string pass_context = context + ' ' + tech.name + " pass " + std::to_string(pass_index);
+
+					const auto find_binding_at_slot = [&pass](uint32_t slot) {
+						return std::find_if(pass.texture_bindings.begin(), pass.texture_bindings.end(),
+							[slot](const reshadefx::texture_binding &binding) { return binding.entry_point_binding == slot; });
+					};
+
+					for (auto it = pass.texture_bindings.begin(); it != pass.texture_bindings.end(); ++it)
+					{
+						if (it->index >= module.samplers.size())
+						{
+							fail(pass_context, "binding references invalid sampler index " + std::to_string(it->index));
+							continue;
+						}
+
+						const std::string &sampler_name = module.samplers[it->index].name;
+
+						if (find_binding_at_slot(it->entry_point_binding) != it)
+							fail(pass_context, "slot " + std::to_string(it->entry_point_binding) + " is used more than once");
+
+						uint32_t &first_binding = first_bindings[it->index];
+						if (first_binding == std::numeric_limits<uint32_t>::max())
+							first_binding = it->entry_point_binding;
+						else if (first_binding != it->entry_point_binding && find_binding_at_slot(first_binding) == pass.texture_bindings.end())
+							fail(pass_context, "'" + sampler_name + "' moved from slot " + std::to_string(first_binding) + " to slot " + std::to_string(it->entry_point_binding) + " even though the former is free");
+					}
+
+					for (const auto &expected : s_expected_pass_samplers)
+					{
+						if (effect.first != expected.effect_name || tech.name != expected.technique_name || pass_index != expected.pass_index)
+							continue;
+
+						std::vector<std::string> expected_names, actual_names;
+						for (const char *const sampler_name : expected.sampler_names)
+							if (sampler_name != nullptr)
+								expected_names.push_back(sampler_name);
+						for (const reshadefx::texture_binding &binding : pass.texture_bindings)
+							if (binding.index < module.samplers.size())
+								actual_names.push_back(module.samplers[binding.index].name);
+
+						std::sort(expected_names.begin(), expected_names.end());
+						std::sort(actual_names.begin(), actual_names.end());
+
+						if (expected_names != actual_names)
+						{
+							std::string message = "bound samplers do not match expected ones:";
+							for (const std::string &sampler_name : actual_names)
+								message += ' ' + sampler_name;
+							fail(pass_context, message);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return s_num_failures == 0;
+}
+
+static bool test_optimizer(const test_options &options)
+{
+	std::vector<std::pair<std::string, std::string>> effects;
+	if (!preprocess_test_effects(options, effects))
+		return false;
+
+	for (const std::pair<std::string, std::string> &effect : effects)
+	{
+		for (const char *const backend_name : s_backend_names)
+		{
+			std::string module_descriptions[2];
+			std::vector<std::pair<std::string, std::string>> interfaces[2];
+
+			for (int optimize = 0; optimize < 2; ++optimize)
+			{
+				const std::string context = effect.first + " (" + backend_name + (optimize ? ", optimized)" : ")");
+
+				const std::unique_ptr<reshadefx::codegen> backend(create_backend(backend_name));
+
+				reshadefx::parser parser;
+				if (!parser.parse(effect.second, backend.get(), optimize != 0))
+				{
+					fail(context, "parsing failed\n" + parser.errors());
+					continue;
+				}
+
+				module_descriptions[optimize] = describe_module(backend->module());
+
+				for (const std::pair<std::string, reshadefx::shader_type> &entry_point : backend->module().entry_points)
+				{
+					std::string code, assembly, errors, message;
+					if (!backend->assemble_code_for_entry_point(entry_point.first, code, assembly, errors))
+					{
+						fail(context, entry_point.first + ": assembling failed\n" + errors);
+						continue;
+					}
+
+					if (0 == std::strcmp(backend_name, "spirv") ?
+							!validate_spirv(code, message) :
+							!validate_source_code(code, 0 == std::strcmp(backend_name, "glsl") ? "main" : entry_point.first, message))
+						fail(context, entry_point.first + ": " + message);
+
+					if (0 != std::strcmp(backend_name, "spirv"))
+						interfaces[optimize].emplace_back(entry_point.first, extract_interface(code));
+				}
+			}
+
+			if (module_descriptions[0] != module_descriptions[1])
+				fail(effect.first + " (" + backend_name + ')', "optimized module differs from unoptimized one\n" + module_descriptions[0] + "---\n" + module_descriptions[1]);
+
+			// The optimizer must not change the signatures of entry points or the declarations of uniforms and resources (including their bindings)
+			for (size_t i = 0; i < std::min(interfaces[0].size(), interfaces[1].size()); ++i)
+				if (interfaces[0][i] != interfaces[1][i])
+					fail(effect.first + " (" + backend_name + ')', interfaces[0][i].first + ": optimized code declares a different interface than unoptimized one\n" + interfaces[0][i].second + "---\n" + interfaces[1][i].second);
+		}
+	}
+
+	return s_num_failures == 0;
+}
+
+static bool test_uniforms(const test_options &options)
+{
+	std::vector<std::pair<std::string, std::string>> effects;
+	if (!preprocess_test_effects(options, effects))
+		return false;
+
+	for (const std::pair<std::string, std::string> &effect : effects)
+	{
+		for (const char *const backend_name : s_backend_names)
+		{
+			// GLSL and SPIR-V use the std140 layout, which aligns vectors to their size (three-component vectors to that of four-component ones)
+			const bool std140 = 0 != std::strcmp(backend_name, "hlsl");
+
+			for (int pack_uniforms = 0; pack_uniforms < 2; ++pack_uniforms)
+			{
+				const std::string context = effect.first + " (" + backend_name + (pack_uniforms ? ", packed)" : ")");
+
+				const std::unique_ptr<reshadefx::codegen> backend(create_backend(backend_name, pack_uniforms != 0));
+
+				reshadefx::parser parser;
+				if (!parser.parse(effect.second, backend.get()))
+				{
+					fail(context, "parsing failed\n" + parser.errors());
+					continue;
+				}
+
+				const reshadefx::effect_module &module = backend->module();
+
+				std::vector<const reshadefx::uniform *> uniforms;
+				for (const reshadefx::uniform &uniform : module.uniforms)
+					uniforms.push_back(&uniform);
+				std::sort(uniforms.begin(), uniforms.end(),
+					[](const reshadefx::uniform *lhs, const reshadefx::uniform *rhs) { return lhs->offset < rhs->offset; });
+
+				uint32_t end_offset = 0;
+				for (const reshadefx::uniform *const uniform : uniforms)
+				{
+					const std::string uniform_context = context + ' ' + uniform->name + " at offset " + std::to_string(uniform->offset);
+
+					if (uniform->offset < end_offset)
+						fail(uniform_context, "overlaps the previous uniform, which ends at offset " + std::to_string(end_offset));
+					end_offset = std::max(end_offset, uniform->offset + uniform->size);
+
+					if (uniform->type.is_array() || uniform->type.is_matrix())
+					{
+						if (uniform->offset % 16 != 0)
+							fail(uniform_context, "arrays and matrices have to start on a 16-byte boundary");
+					}
+					else
+					{
+						if ((uniform->offset % 16) + uniform->size > 16)
+							fail(uniform_context, "crosses a 16-byte boundary");
+						if (std140 && uniform->offset % ((uniform->type.rows == 3 ? 4 : uniform->type.rows) * 4) != 0)
+							fail(uniform_context, "is not aligned according to std140 rules");
+					}
+				}
+
+				if (module.total_uniform_size < end_offset)
+					fail(context, "total uniform size " + std::to_string(module.total_uniform_size) + " is smaller than the end of the last uniform at offset " + std::to_string(end_offset));
+			}
+		}
+	}
+
+	return s_num_failures == 0;
+}
+
+static const struct
+{
+	const char *name;
+	bool(*func)(const test_options &options);
+} s_tests[] = {
+	{ "bindings", test_bindings },
+	{ "optimizer", test_optimizer },
+	{ "uniforms", test_uniforms },
+};
+
+int main(int argc, char *argv[])
+{
+	test_options options;
+	const char *test_name = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+
+		if (arg[0] == '-')
+		{
+			if (0 == std::strcmp(arg, "-h") || 0 == std::strcmp(arg, "--help"))
+			{
+				print_usage(argv[0]);
+				return 0;
+			}
+			else if (0 == std::strcmp(arg, "-D") && i + 1 < argc)
+			{
+				char *name = argv[++i];
+				char *value = std::strchr(name, '=');
+				if (value) *value++ = '\0';
+				options.macro_definitions.emplace_back(name, value ? value : "1");
+			}
+			else if (0 == std::strcmp(arg, "-I") && i + 1 < argc)
+			{
+				options.include_paths.emplace_back(argv[++i]);
+			}
+			else
+			{
+				print_usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (test_name == nullptr)
+		{
+			test_name = arg;
+		}
+		else
+		{
+			options.source_files.push_back(arg);
+		}
+	}
+
+	if (test_name == nullptr)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	for (const auto &test : s_tests)
+	{
+		if (0 == std::strcmp(test_name, test.name))
+		{
+			const bool success = test.func(options);
+			std::cout << test.name << ": " << (success ? "passed" : "failed") << std::endl;
+			return success ? 0 : 1;
+		}
+	}
+
+	std::cerr << "error: unknown test '" << test_name << "'" << std::endl;
+	return 1;
+}